@@ -0,0 +1,50 @@
+# Scene sorting benchmark: 10000 sprites that all change
+# their z every frame, forcing the scene to reinsert each
+# of them. Run it headless so frames aren't throttled by
+# the frame rate limiter or vsync:
+#
+#   mkxp --headless=true --customScript=bench/sprite_z.rb
+#
+# Add --traceFile=trace.json for per-phase timings.
+
+SPRITES = 10_000
+WARMUP  = 30
+FRAMES  = 600
+
+bitmap = Bitmap.new(8, 8)
+bitmap.fill_rect(bitmap.rect, Color.new(255, 255, 255))
+
+# Same layout on every run
+srand(1)
+
+sprites = Array.new(SPRITES) do
+  sprite = Sprite.new
+  sprite.bitmap = bitmap
+  sprite.x = rand(Graphics.width)
+  sprite.y = rand(Graphics.height)
+  sprite.z = rand(1000)
+  sprite
+end
+
+WARMUP.times { Graphics.update }
+
+times = []
+
+FRAMES.times do
+  start = Time.now
+
+  sprites.each { |sprite| sprite.z = rand(1000) }
+  Graphics.update
+
+  times << Time.now - start
+end
+
+times.sort!
+avg = times.inject(:+) / times.size
+
+MKXP.puts(format("sprite_z: %d sprites, %d frames: avg %.3f ms, median %.3f ms, p95 %.3f ms",
+                 SPRITES, FRAMES, avg * 1000, times[times.size / 2] * 1000,
+                 times[(times.size * 0.95).to_i] * 1000))
+
+sprites.each(&:dispose)
+bitmap.dispose
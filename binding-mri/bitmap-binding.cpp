@@ -23,6 +23,8 @@
 #include "font.h"
 #include "exception.h"
 #include "sharedstate.h"
+#include "textlayoutcache.h"
+#include "texpool.h"
 #include "disposable-binding.h"
 #include "binding-util.h"
 #include "binding-types.h"
@@ -234,6 +236,105 @@ RB_METHOD(bitmapSetPixel)
 	return self;
 }
 
+RB_METHOD(bitmapPrefetchPixels)
+{
+	Bitmap *b = getPrivateData<Bitmap>(self);
+
+	if (argc == 1)
+	{
+		VALUE rectObj;
+		Rect *rect;
+
+		rb_get_args(argc, argv, "o", &rectObj RB_ARG_END);
+
+		rect = getPrivateDataCheck<Rect>(rectObj, RectType);
+
+		GUARD_EXC( b->prefetchPixels(rect->toIntRect()); );
+	}
+	else
+	{
+		int x, y, width, height;
+
+		rb_get_args(argc, argv, "iiii", &x, &y, &width, &height RB_ARG_END);
+
+		GUARD_EXC( b->prefetchPixels(x, y, width, height); );
+	}
+
+	return self;
+}
+
+static void checkRawDataSize(const IntRect &rect, long size)
+{
+	if (size != (long) rect.w * rect.h * 4)
+		throw Exception(Exception::ArgumentError,
+		                "Raw data size mismatch (expected %d bytes, got %ld)",
+		                rect.w * rect.h * 4, size);
+}
+
+RB_METHOD(bitmapGetRawData)
+{
+	Bitmap *b = getPrivateData<Bitmap>(self);
+
+	IntRect rect;
+
+	if (argc == 0)
+	{
+		GUARD_EXC( rect = b->rect(); );
+	}
+	else
+	{
+		VALUE rectObj;
+
+		rb_get_args(argc, argv, "o", &rectObj RB_ARG_END);
+
+		rect = getPrivateDataCheck<Rect>(rectObj, RectType)->toIntRect();
+	}
+
+	GUARD_EXC( b->checkTransferRect(rect); );
+
+	VALUE data = rb_str_new(0, (long) rect.w * rect.h * 4);
+
+	GUARD_EXC( b->readRect(rect, RSTRING_PTR(data)); );
+
+	return data;
+}
+
+RB_METHOD(bitmapSetRawData)
+{
+	Bitmap *b = getPrivateData<Bitmap>(self);
+
+	VALUE data;
+
+	rb_get_args(argc, argv, "S", &data RB_ARG_END);
+
+	GUARD_EXC(
+		IntRect rect = b->rect();
+		checkRawDataSize(rect, RSTRING_LEN(data));
+		b->writeRect(rect, RSTRING_PTR(data));
+	);
+
+	return data;
+}
+
+RB_METHOD(bitmapSetRawDataRect)
+{
+	Bitmap *b = getPrivateData<Bitmap>(self);
+
+	VALUE rectObj, data;
+	Rect *rect;
+
+	rb_get_args(argc, argv, "oS", &rectObj, &data RB_ARG_END);
+
+	rect = getPrivateDataCheck<Rect>(rectObj, RectType);
+
+	GUARD_EXC(
+		checkRawDataSize(rect->toIntRect(), RSTRING_LEN(data));
+		b->writeRect(rect->toIntRect(), RSTRING_PTR(data));
+	);
+
+	return self;
+}
+
 RB_METHOD(bitmapHueChange)
 {
 	Bitmap *b = getPrivateData<Bitmap>(self);
@@ -323,6 +424,56 @@ RB_METHOD(bitmapTextSize)
 	return RectType.wrap_object(rect);
 }
 
+static void preloadObj(VALUE obj)
+{
+	const char *filename = rb_string_value_cstr(&obj);
+
+	Bitmap::preload(filename);
+}
+
+RB_METHOD(bitmapPreload)
+{
+	RB_UNUSED_PARAM;
+
+	for (int i = 0; i < argc; ++i)
+	{
+		if (!RB_TYPE_P(argv[i], RUBY_T_ARRAY))
+		{
+			preloadObj(argv[i]);
+			continue;
+		}
+
+		for (long j = 0; j < RARRAY_LEN(argv[i]); ++j)
+			preloadObj(rb_ary_entry(argv[i], j));
+	}
+
+	return Qnil;
+}
+
+RB_METHOD(bitmapTextLayoutCacheStats)
+{
+	RB_UNUSED_PARAM;
+
+	TextLayoutCache &cache = shState->textLayoutCache();
+
+	return rb_ary_new3(3, UINT2NUM(cache.hits()),
+	                      UINT2NUM(cache.misses()),
+	                      UINT2NUM(cache.size()));
+}
+
+RB_METHOD(bitmapTexturePoolStats)
+{
+	RB_UNUSED_PARAM;
+
+	TexPool::Stats stats = shState->texPool().stats();
+
+	return rb_ary_new3(5, ULL2NUM(stats.hits),
+	                      ULL2NUM(stats.misses),
+	                      ULL2NUM(stats.evictions),
+	                      ULL2NUM(stats.count),
+	                      ULL2NUM(stats.bytes));
+}
+
 DEF_PROP_OBJ_VAL(Bitmap, Font, Font, "font")
 
 RB_METHOD(bitmapGradientFillRect)
@@ -413,6 +564,34 @@ RB_METHOD(bitmapRadialBlur)
 	return Qnil;
 }
 
+static VALUE bitmapBatchBody(VALUE self)
+{
+	return rb_yield(self);
+}
+
+static VALUE bitmapBatchEnd(VALUE self)
+{
+	Bitmap *b = getPrivateData<Bitmap>(self);
+
+	GUARD_EXC( b->endBatch(); );
+
+	return Qnil;
+}
+
+RB_METHOD(bitmapBatch)
+{
+	RB_UNUSED_PARAM;
+
+	Bitmap *b = getPrivateData<Bitmap>(self);
+
+	rb_need_block();
+
+	GUARD_EXC( b->beginBatch(); );
+
+	return rb_ensure((VALUE(*)(ANYARGS)) bitmapBatchBody, self,
+	                 (VALUE(*)(ANYARGS)) bitmapBatchEnd, self);
+}
+
 RB_METHOD(bitmapInitializeCopy)
 {
 	rb_check_argc(argc, 1);
@@ -454,9 +633,18 @@ bitmapBindingInit()
 	_rb_define_method(klass, "clear",       bitmapClear);
 	_rb_define_method(klass, "get_pixel",   bitmapGetPixel);
 	_rb_define_method(klass, "set_pixel",   bitmapSetPixel);
+	_rb_define_method(klass, "prefetch_pixels", bitmapPrefetchPixels);
+	_rb_define_method(klass, "raw_data",        bitmapGetRawData);
+	_rb_define_method(klass, "raw_data=",       bitmapSetRawData);
+	_rb_define_method(klass, "set_raw_data",    bitmapSetRawDataRect);
 	_rb_define_method(klass, "hue_change",  bitmapHueChange);
 	_rb_define_method(klass, "draw_text",   bitmapDrawText);
 	_rb_define_method(klass, "text_size",   bitmapTextSize);
+	_rb_define_method(klass, "batch",       bitmapBatch);
+
+	rb_define_class_method(klass, "text_layout_cache_stats", bitmapTextLayoutCacheStats);
+	rb_define_class_method(klass, "texture_pool_stats", bitmapTexturePoolStats);
+	rb_define_class_method(klass, "preload", bitmapPreload);
 
 	if (rgssVer >= 2)
 	{
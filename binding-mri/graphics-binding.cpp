@@ -24,6 +24,24 @@
 #include "binding-util.h"
 #include "binding-types.h"
 #include "exception.h"
+#include "vram.h"
+
+static VALUE memoryStats()
+{
+	VALUE hash = rb_hash_new();
+
+	for (int i = 0; i < VRAM::CategoryCount; ++i)
+	{
+		VRAM::Category cat = (VRAM::Category) i;
+		rb_hash_aset(hash, ID2SYM(rb_intern(VRAM::categoryName(cat))),
+		             ULL2NUM(VRAM::bytes(cat)));
+	}
+
+	rb_hash_aset(hash, ID2SYM(rb_intern("total")), ULL2NUM(VRAM::total()));
+	rb_hash_aset(hash, ID2SYM(rb_intern("budget")), ULL2NUM(VRAM::budget()));
+
+	return hash;
+}
 
 RB_METHOD(graphicsUpdate)
 {
@@ -31,6 +49,14 @@ RB_METHOD(graphicsUpdate)
 
 	shState->graphics().update();
 
+	if (VRAM::takePressure())
+	{
+		VALUE handler = rb_iv_get(self, "memory_pressure");
+
+		if (!NIL_P(handler))
+			rb_funcall(handler, rb_intern("call"), 1, memoryStats());
+	}
+
 	return Qnil;
 }
 
@@ -97,6 +123,23 @@ RB_METHOD(graphicsFrameReset)
 		return rb_bool_new(value); \
 	}
 
+RB_METHOD(graphicsMemoryStats)
+{
+	RB_UNUSED_PARAM;
+
+	return memoryStats();
+}
+
+RB_METHOD(graphicsOnMemoryPressure)
+{
+	RB_UNUSED_PARAM;
+
+	VALUE handler = rb_block_given_p() ? rb_block_proc() : Qnil;
+	rb_iv_set(self, "memory_pressure", handler);
+
+	return Qnil;
+}
+
 RB_METHOD(graphicsWidth)
 {
 	RB_UNUSED_PARAM;
@@ -219,6 +262,9 @@ void graphicsBindingInit()
 
 	_rb_define_module_function(module, "__reset__", graphicsReset);
 
+	_rb_define_module_function(module, "memory_stats", graphicsMemoryStats);
+	_rb_define_module_function(module, "on_memory_pressure", graphicsOnMemoryPressure);
+
 	INIT_GRA_PROP_BIND( FrameRate,  "frame_rate"  );
 	INIT_GRA_PROP_BIND( FrameCount, "frame_count" );
 
@@ -155,6 +155,17 @@ RB_METHOD(tableSetAt)
 	return argv[argc - 1];
 }
 
+RB_METHOD(tableCommit)
+{
+	RB_UNUSED_PARAM;
+
+	Table *t = getPrivateData<Table>(self);
+
+	t->commit();
+
+	return Qnil;
+}
+
 MARSH_LOAD_FUN(Table)
 INITCOPY_FUN(Table)
 
@@ -176,5 +187,6 @@ tableBindingInit()
 	_rb_define_method(klass, "zsize", tableZSize);
 	_rb_define_method(klass, "[]", tableGetAt);
 	_rb_define_method(klass, "[]=", tableSetAt);
+	_rb_define_method(klass, "commit", tableCommit);
 
 }
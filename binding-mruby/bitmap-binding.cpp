@@ -23,10 +23,16 @@
 #include "font.h"
 #include "exception.h"
 #include "sharedstate.h"
+#include "textlayoutcache.h"
+#include "texpool.h"
 #include "disposable-binding.h"
 #include "binding-util.h"
 #include "binding-types.h"
 
+#include <mruby/string.h>
+#include <mruby/array.h>
+#include <mruby/error.h>
+
 DEF_TYPE(Bitmap);
 
 MRB_METHOD(bitmapInitialize)
@@ -218,6 +224,105 @@ MRB_METHOD(bitmapSetPixel)
 	return mrb_nil_value();
 }
 
+MRB_METHOD(bitmapPrefetchPixels)
+{
+	Bitmap *b = getPrivateData<Bitmap>(mrb, self);
+
+	if (mrb->c->ci->argc == 1)
+	{
+		mrb_value rectObj;
+		Rect *rect;
+
+		mrb_get_args(mrb, "o", &rectObj);
+
+		rect = getPrivateDataCheck<Rect>(mrb, rectObj, RectType);
+
+		GUARD_EXC( b->prefetchPixels(rect->toIntRect()); )
+	}
+	else
+	{
+		mrb_int x, y, width, height;
+
+		mrb_get_args(mrb, "iiii", &x, &y, &width, &height);
+
+		GUARD_EXC( b->prefetchPixels(x, y, width, height); )
+	}
+
+	return mrb_nil_value();
+}
+
+static void checkRawDataSize(const IntRect &rect, mrb_int size)
+{
+	if (size != (mrb_int) rect.w * rect.h * 4)
+		throw Exception(Exception::ArgumentError,
+		                "Raw data size mismatch (expected %d bytes, got %d)",
+		                rect.w * rect.h * 4, (int) size);
+}
+
+MRB_METHOD(bitmapGetRawData)
+{
+	Bitmap *b = getPrivateData<Bitmap>(mrb, self);
+
+	IntRect rect;
+
+	if (mrb->c->ci->argc == 0)
+	{
+		GUARD_EXC( rect = b->rect(); )
+	}
+	else
+	{
+		mrb_value rectObj;
+
+		mrb_get_args(mrb, "o", &rectObj);
+
+		rect = getPrivateDataCheck<Rect>(mrb, rectObj, RectType)->toIntRect();
+	}
+
+	GUARD_EXC( b->checkTransferRect(rect); )
+
+	mrb_value data = mrb_str_new(mrb, 0, rect.w * rect.h * 4);
+
+	GUARD_EXC( b->readRect(rect, RSTRING_PTR(data)); )
+
+	return data;
+}
+
+MRB_METHOD(bitmapSetRawData)
+{
+	Bitmap *b = getPrivateData<Bitmap>(mrb, self);
+
+	mrb_value data;
+
+	mrb_get_args(mrb, "S", &data);
+
+	GUARD_EXC(
+		IntRect rect = b->rect();
+		checkRawDataSize(rect, RSTRING_LEN(data));
+		b->writeRect(rect, RSTRING_PTR(data));
+	)
+
+	return data;
+}
+
+MRB_METHOD(bitmapSetRawDataRect)
+{
+	Bitmap *b = getPrivateData<Bitmap>(mrb, self);
+
+	mrb_value rectObj, data;
+	Rect *rect;
+
+	mrb_get_args(mrb, "oS", &rectObj, &data);
+
+	rect = getPrivateDataCheck<Rect>(mrb, rectObj, RectType);
+
+	GUARD_EXC(
+		checkRawDataSize(rect->toIntRect(), RSTRING_LEN(data));
+		b->writeRect(rect->toIntRect(), RSTRING_PTR(data));
+	)
+
+	return self;
+}
+
 MRB_METHOD(bitmapHueChange)
 {
 	Bitmap *b = getPrivateData<Bitmap>(mrb, self);
@@ -231,6 +336,37 @@ MRB_METHOD(bitmapHueChange)
 	return mrb_nil_value();
 }
 
+static mrb_value bitmapBatchBody(mrb_state *mrb, mrb_value blockSelf)
+{
+	return mrb_yield(mrb, mrb_ary_ref(mrb, blockSelf, 0), mrb_ary_ref(mrb, blockSelf, 1));
+}
+
+static mrb_value bitmapBatchEnd(mrb_state *mrb, mrb_value self)
+{
+	Bitmap *b = getPrivateData<Bitmap>(mrb, self);
+
+	GUARD_EXC( b->endBatch(); )
+
+	return mrb_nil_value();
+}
+
+MRB_METHOD(bitmapBatch)
+{
+	Bitmap *b = getPrivateData<Bitmap>(mrb, self);
+
+	mrb_value block;
+
+	mrb_get_args(mrb, "&", &block);
+
+	if (mrb_nil_p(block))
+		mrb_raise(mrb, E_ARGUMENT_ERROR, "no block given");
+
+	GUARD_EXC( b->beginBatch(); )
+
+	return mrb_ensure(mrb, bitmapBatchBody, mrb_assoc_new(mrb, block, self),
+	                  bitmapBatchEnd, self);
+}
+
 MRB_METHOD(bitmapDrawText)
 {
 	Bitmap *b = getPrivateData<Bitmap>(mrb, self);
@@ -278,6 +414,65 @@ MRB_METHOD(bitmapTextSize)
 	return wrapObject(mrb, rect, RectType);
 }
 
+static void preloadObj(mrb_state *mrb, mrb_value obj)
+{
+	const char *filename = mrb_string_value_cstr(mrb, &obj);
+
+	Bitmap::preload(filename);
+}
+
+MRB_FUNCTION(bitmapPreload)
+{
+	mrb_int argc;
+	mrb_value *argv;
+
+	mrb_get_args(mrb, "*", &argv, &argc);
+
+	for (int i = 0; i < argc; ++i)
+	{
+		if (!mrb_array_p(argv[i]))
+		{
+			preloadObj(mrb, argv[i]);
+			continue;
+		}
+
+		for (mrb_int j = 0; j < RARRAY_LEN(argv[i]); ++j)
+			preloadObj(mrb, mrb_ary_ref(mrb, argv[i], j));
+	}
+
+	return mrb_nil_value();
+}
+
+MRB_METHOD(bitmapTextLayoutCacheStats)
+{
+	MRB_UNUSED_PARAM;
+
+	TextLayoutCache &cache = shState->textLayoutCache();
+
+	mrb_value ary = mrb_ary_new_capa(mrb, 3);
+	mrb_ary_push(mrb, ary, mrb_fixnum_value(cache.hits()));
+	mrb_ary_push(mrb, ary, mrb_fixnum_value(cache.misses()));
+	mrb_ary_push(mrb, ary, mrb_fixnum_value(cache.size()));
+
+	return ary;
+}
+
+MRB_METHOD(bitmapTexturePoolStats)
+{
+	MRB_UNUSED_PARAM;
+
+	TexPool::Stats stats = shState->texPool().stats();
+
+	mrb_value ary = mrb_ary_new_capa(mrb, 5);
+	mrb_ary_push(mrb, ary, mrb_fixnum_value(stats.hits));
+	mrb_ary_push(mrb, ary, mrb_fixnum_value(stats.misses));
+	mrb_ary_push(mrb, ary, mrb_fixnum_value(stats.evictions));
+	mrb_ary_push(mrb, ary, mrb_fixnum_value(stats.count));
+	mrb_ary_push(mrb, ary, mrb_fixnum_value(stats.bytes));
+
+	return ary;
+}
+
 MRB_METHOD(bitmapGetFont)
 {
 	checkDisposed<Bitmap>(mrb, self);
@@ -323,9 +518,18 @@ bitmapBindingInit(mrb_state *mrb)
 	mrb_define_method(mrb, klass, "clear",       bitmapClear,      MRB_ARGS_NONE());
 	mrb_define_method(mrb, klass, "get_pixel",   bitmapGetPixel,   MRB_ARGS_REQ(2));
 	mrb_define_method(mrb, klass, "set_pixel",   bitmapSetPixel,   MRB_ARGS_REQ(3));
+	mrb_define_method(mrb, klass, "prefetch_pixels", bitmapPrefetchPixels, MRB_ARGS_REQ(1) | MRB_ARGS_OPT(3));
+	mrb_define_method(mrb, klass, "raw_data",        bitmapGetRawData,     MRB_ARGS_OPT(1));
+	mrb_define_method(mrb, klass, "raw_data=",       bitmapSetRawData,     MRB_ARGS_REQ(1));
+	mrb_define_method(mrb, klass, "set_raw_data",    bitmapSetRawDataRect, MRB_ARGS_REQ(2));
 	mrb_define_method(mrb, klass, "hue_change",  bitmapHueChange,  MRB_ARGS_REQ(1));
 	mrb_define_method(mrb, klass, "draw_text",   bitmapDrawText,   MRB_ARGS_REQ(2) | MRB_ARGS_OPT(4));
 	mrb_define_method(mrb, klass, "text_size",   bitmapTextSize,   MRB_ARGS_REQ(1));
+	mrb_define_method(mrb, klass, "batch",       bitmapBatch,      MRB_ARGS_BLOCK());
+
+	mrb_define_class_method(mrb, klass, "text_layout_cache_stats", bitmapTextLayoutCacheStats, MRB_ARGS_NONE());
+	mrb_define_class_method(mrb, klass, "texture_pool_stats", bitmapTexturePoolStats, MRB_ARGS_NONE());
+	mrb_define_class_method(mrb, klass, "preload", bitmapPreload, MRB_ARGS_ANY());
 
 	mrb_define_method(mrb, klass, "font",        bitmapGetFont,    MRB_ARGS_NONE());
 	mrb_define_method(mrb, klass, "font=",       bitmapSetFont,    MRB_ARGS_REQ(1));
@@ -23,13 +23,60 @@
 #include "sharedstate.h"
 #include "binding-util.h"
 #include "exception.h"
+#include "vram.h"
 
-MRB_FUNCTION(graphicsUpdate)
+#include <mruby/hash.h>
+
+static mrb_value memoryStats(mrb_state *mrb)
 {
-	MRB_FUN_UNUSED_PARAM;
+	mrb_value hash = mrb_hash_new(mrb);
+
+	for (int i = 0; i < VRAM::CategoryCount; ++i)
+	{
+		VRAM::Category cat = (VRAM::Category) i;
+		mrb_hash_set(mrb, hash, mrb_symbol_value(mrb_intern_cstr(mrb, VRAM::categoryName(cat))),
+		             mrb_fixnum_value(VRAM::bytes(cat)));
+	}
+
+	mrb_hash_set(mrb, hash, mrb_symbol_value(mrb_intern_lit(mrb, "total")),
+	             mrb_fixnum_value(VRAM::total()));
+	mrb_hash_set(mrb, hash, mrb_symbol_value(mrb_intern_lit(mrb, "budget")),
+	             mrb_fixnum_value(VRAM::budget()));
+
+	return hash;
+}
+
+MRB_METHOD(graphicsUpdate)
+{
+	MRB_UNUSED_PARAM;
 
 	shState->graphics().update();
 
+	if (VRAM::takePressure())
+	{
+		mrb_value handler = mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "memory_pressure"));
+
+		if (!mrb_nil_p(handler))
+			mrb_yield(mrb, handler, memoryStats(mrb));
+	}
+
+	return mrb_nil_value();
+}
+
+MRB_FUNCTION(graphicsMemoryStats)
+{
+	MRB_FUN_UNUSED_PARAM;
+
+	return memoryStats(mrb);
+}
+
+MRB_METHOD(graphicsOnMemoryPressure)
+{
+	mrb_value handler;
+	mrb_get_args(mrb, "&", &handler);
+
+	mrb_iv_set(mrb, self, mrb_intern_lit(mrb, "memory_pressure"), handler);
+
 	return mrb_nil_value();
 }
 
@@ -113,6 +160,9 @@ void graphicsBindingInit(mrb_state *mrb)
 	mrb_define_module_function(mrb, module, "transition", graphicsTransition, MRB_ARGS_OPT(3));
 	mrb_define_module_function(mrb, module, "frame_reset", graphicsFrameReset, MRB_ARGS_NONE());
 
+	mrb_define_module_function(mrb, module, "memory_stats", graphicsMemoryStats, MRB_ARGS_NONE());
+	mrb_define_module_function(mrb, module, "on_memory_pressure", graphicsOnMemoryPressure, MRB_ARGS_BLOCK());
+
 	INIT_GRA_PROP_BIND( FrameRate,  "frame_rate"  );
 	INIT_GRA_PROP_BIND( FrameCount, "frame_count" );
 
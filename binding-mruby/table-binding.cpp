@@ -140,6 +140,15 @@ MRB_METHOD(tableSetAt)
 	return mrb_fixnum_value(value);
 }
 
+MRB_METHOD(tableCommit)
+{
+	Table *t = getPrivateData<Table>(mrb, self);
+
+	t->commit();
+
+	return mrb_nil_value();
+}
+
 MARSH_LOAD_FUN(Table)
 INITCOPY_FUN(Table)
 
@@ -160,6 +169,7 @@ tableBindingInit(mrb_state *mrb)
 	mrb_define_method(mrb, klass, "zsize",      tableZSize,      MRB_ARGS_NONE()                  );
 	mrb_define_method(mrb, klass, "[]",         tableGetAt,      MRB_ARGS_REQ(1) | MRB_ARGS_OPT(2));
 	mrb_define_method(mrb, klass, "[]=",        tableSetAt,      MRB_ARGS_REQ(2) | MRB_ARGS_OPT(2));
+	mrb_define_method(mrb, klass, "commit",     tableCommit,     MRB_ARGS_NONE()                  );
 
 	mrb_define_method(mrb, klass, "inspect", inspectObject, MRB_ARGS_NONE());
 }
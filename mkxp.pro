@@ -140,7 +140,15 @@ HEADERS += \
 	src/tileatlasvx.h \
 	src/sharedmidistate.h \
 	src/fluid-fun.h \
-	src/sdl-util.h
+	src/sdl-util.h \
+	src/frametrace.h \
+	src/spritebatch.h \
+	src/preparequeue.h \
+	src/bitmapatlas.h \
+	src/glyphcache.h \
+	src/textlayoutcache.h \
+	src/imageloader.h \
+	src/vram.h
 
 SOURCES += \
 	src/main.cpp \
@@ -186,7 +194,15 @@ SOURCES += \
 	src/tileatlasvx.cpp \
 	src/autotilesvx.cpp \
 	src/midisource.cpp \
-	src/fluid-fun.cpp
+	src/fluid-fun.cpp \
+	src/frametrace.cpp \
+	src/spritebatch.cpp \
+	src/preparequeue.cpp \
+	src/bitmapatlas.cpp \
+	src/glyphcache.cpp \
+	src/textlayoutcache.cpp \
+	src/imageloader.cpp \
+	src/vram.cpp
 
 EMBED = \
 	shader/common.h \
@@ -195,8 +211,11 @@ EMBED = \
 	shader/hue.frag \
 	shader/sprite.frag \
 	shader/plane.frag \
-	shader/gray.frag \
+	shader/viewportEffect.frag \
 	shader/bitmapBlit.frag \
+	shader/bitmapBlitBatch.frag \
+	shader/textBlit.frag \
+	shader/glyph.frag \
 	shader/flatColor.frag \
 	shader/simple.frag \
 	shader/simpleColor.frag \
@@ -207,6 +226,7 @@ EMBED = \
 	shader/simple.vert \
 	shader/simpleColor.vert \
 	shader/sprite.vert \
+	shader/spriteWave.vert \
 	shader/tilemap.vert \
 	shader/blur.frag \
 	shader/blurH.vert \
@@ -0,0 +1,37 @@
+/* Same blending as bitmapBlit, for blits recorded in
+ * a Bitmap batch: the destination copy is addressed by
+ * fragment position, and the opacity comes from the
+ * vertex color, so one draw call can cover many blits */
+
+uniform sampler2D source;
+uniform sampler2D destination;
+
+/* Location of the destination copy's
+ * origin in the target, and its size */
+uniform vec2 destOrigin;
+uniform vec2 destSizeInv;
+
+varying vec2 v_texCoord;
+varying lowp vec4 v_color;
+
+void main()
+{
+	vec2 coor = v_texCoord;
+	vec2 dstCoor = (gl_FragCoord.xy - destOrigin) * destSizeInv;
+
+	vec4 srcFrag = texture2D(source, coor);
+	vec4 dstFrag = texture2D(destination, dstCoor);
+
+	vec4 resFrag;
+
+	float co1 = srcFrag.a * v_color.a;
+	float co2 = dstFrag.a * (1.0 - co1);
+	resFrag.a = co1 + co2;
+
+	if (resFrag.a == 0.0)
+		resFrag.rgb = srcFrag.rgb;
+	else
+		resFrag.rgb = (co1*srcFrag.rgb + co2*dstFrag.rgb) / resFrag.a;
+
+	gl_FragColor = resFrag;
+}
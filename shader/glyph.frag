@@ -0,0 +1,13 @@
+
+uniform sampler2D texture;
+
+varying vec2 v_texCoord;
+varying lowp vec4 v_color;
+
+void main()
+{
+	/* Glyphs only carry coverage; blending this over a cleared
+	 * target yields a premultiplied image of the text */
+	gl_FragColor.rgb = v_color.rgb;
+	gl_FragColor.a = texture2D(texture, v_texCoord).a * v_color.a;
+}
@@ -0,0 +1,26 @@
+
+uniform mat4 projMat;
+
+uniform mat4 spriteMat;
+
+uniform vec2 texSizeInv;
+uniform vec2 texOrigin;
+
+uniform float waveAmp;
+uniform float waveFreq;
+uniform float wavePhase;
+
+/* x: undisplaced x, y: row of the chunk this
+ * vertex belongs to (in screen pixels) */
+attribute vec2 position;
+attribute vec2 texCoord;
+
+varying vec2 v_texCoord;
+
+void main()
+{
+	float x = position.x + sin(wavePhase + position.y * waveFreq) * waveAmp;
+
+	gl_Position = projMat * spriteMat * vec4(x, texCoord.y, 0, 1);
+	v_texCoord = (texCoord + texOrigin) * texSizeInv;
+}
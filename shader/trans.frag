@@ -3,6 +3,9 @@
 uniform sampler2D currentScene;
 uniform sampler2D frozenScene;
 uniform sampler2D transMap;
+/* Where the transition bitmap's pixels lie inside of
+ * transMap (normalized offset in xy, scale in zw) */
+uniform vec4 transMapRect;
 /* Normalized */
 uniform float prog;
 /* Vague [0, 512] normalized */
@@ -12,7 +15,7 @@ varying vec2 v_texCoord;
 
 void main()
 {
-    float transV = texture2D(transMap, v_texCoord).r;
+    float transV = texture2D(transMap, transMapRect.xy + v_texCoord * transMapRect.zw).r;
     float cTransV = clamp(transV, prog, prog+vague);
     lowp float alpha = (cTransV - prog) / vague;
     
@@ -20,11 +20,14 @@
 */
 
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include <math.h>
 
 #include "bitmap.h"
 
 #include <SDL.h>
-#include <SDL_image.h>
 #include <SDL_ttf.h>
 #include <SDL_rect.h>
 #include <SDL_surface.h>
@@ -41,22 +44,39 @@
 #include "sharedstate.h"
 #include "glstate.h"
 #include "texpool.h"
+#include "bitmapatlas.h"
+#include "glyphcache.h"
+#include "textlayoutcache.h"
+#include "imageloader.h"
+#include "preparequeue.h"
 #include "shader.h"
 #include "filesystem.h"
 #include "font.h"
 #include "eventthread.h"
+#include "util.h"
 
 using namespace std::literals;
 
 #define GUARD_MEGA \
 	{ \
-		if (p->megaSurface) \
+		if (p->isMega()) \
 			throw Exception(Exception::MKXPError, \
                             "Operation not supported for mega surfaces"); \
 	}
 
 #define OUTLINE_SIZE 1
 
+/* Edge length of the square areas getPixel()
+ * reads back from the GL at once */
+#define READBACK_TILE 64
+
+/* What a normalized color component ends
+ * up as in an 8 bit per channel texture */
+static uint8_t unormByte(float value)
+{
+	return (uint8_t) (clamp<float>(value, 0, 1) * 255.0f + 0.5f);
+}
+
 /* Normalize (= ensure width and
  * height are positive) */
 static IntRect normalizedRect(const IntRect &rect)
@@ -78,24 +98,70 @@ static IntRect normalizedRect(const IntRect &rect)
 	return norm;
 }
 
-struct BitmapPrivate
+/* 'rect' relative to the mega tile at 'tileRect' */
+static IntRect toTile(const IntRect &rect, const IntRect &tileRect)
+{
+	return IntRect(rect.x - tileRect.x, rect.y - tileRect.y, rect.w, rect.h);
+}
+
+struct BitmapPrivate : public Preparable
 {
 	Bitmap *self;
 
+	/* While the bitmap lives in an atlas page, only
+	 * the size in here is valid */
 	TEXFBO gl;
 
+	/* Bitmaps loaded from small images start out in a shared
+	 * atlas page. Anything writing to the bitmap (or handing
+	 * out its GL objects) has to call makeWritable() first */
+	BitmapAtlas::Region atlas;
+
+	/* Clones share the texture in 'gl' with their source until
+	 * either of them is written to, at which point the writer
+	 * copies it. Null if the texture isn't shared */
+	struct SharedTex
+	{
+		int refCount;
+	};
+
+	SharedTex *shared;
+
 	Font *font;
 
-	/* "Mega surfaces" are a hack to allow Tilesets to be used
-	 * whose Bitmaps don't fit into a regular texture. They're
-	 * kept in RAM and will throw an error if they're used in
-	 * any context other than as Tilesets */
-	SDL_Surface *megaSurface;
+	/* "Mega bitmaps" don't fit into a single texture. They're
+	 * split into a grid of regular bitmaps, and operations on
+	 * them are carried out on each tile they touch. Only the
+	 * size in 'gl' is valid for them */
+	struct MegaTile
+	{
+		Bitmap *bitmap;
+		IntRect rect;
+	};
+
+	std::vector<MegaTile> megaTiles;
 
 	/* A cached version of the bitmap in client memory, for
-	 * getPixel calls. Is invalidated any time the bitmap
-	 * is modified */
-	SDL_Surface *surface;
+	 * getPixel calls. It is read back in tiles of
+	 * READBACK_TILE² pixels, each of which is only fetched
+	 * once a pixel inside of it is requested (or prefetched)
+	 * and thrown away once the area it covers is modified */
+	struct ReadbackTile
+	{
+		std::vector<uint32_t> pixels;
+		bool valid;
+
+		/* Pixel pack buffer of a pending
+		 * asynchronous readback, or 0 */
+		GLuint pbo;
+
+		ReadbackTile()
+		    : valid(false),
+		      pbo(0)
+		{}
+	};
+
+	std::vector<ReadbackTile> tiles;
 	SDL_PixelFormat *format;
 
 	/* The 'tainted' area describes which parts of the
@@ -106,28 +172,299 @@ struct BitmapPrivate
 	 * ourselves the expensive blending calculation */
 	pixman_region32_t tainted;
 
+	/* Keeps the contents of a blit source's texture as they
+	 * were when the blit was recorded, even if the source is
+	 * written to or disposed before the blit is drawn */
+	struct TexPin
+	{
+		TEXFBO tex;
+		Vec2i origin;
+
+		/* Either of these holds the reference */
+		SharedTex *shared;
+		BitmapAtlas::Region atlas;
+	};
+
+	/* Solid color writes (setPixel, fillRect, clearRect) and
+	 * gradient fills don't go to the GL right away. They're
+	 * collected here, and drawn all at once when the bitmap is
+	 * next sampled, drawn to by any other means, or at the
+	 * latest at prepareDraw. While batching, blits from other
+	 * bitmaps are collected as well */
+	enum TaintOp
+	{
+		TaintAdd,
+		TaintSubtract,
+		TaintKeep
+	};
+
+	enum WriteOp
+	{
+		WriteFill,
+		WriteGradient,
+		WriteBlt
+	};
+
+	struct PendingWrite
+	{
+		WriteOp op;
+
+		/* Affected area, clipped to the bitmap */
+		IntRect rect;
+		TaintOp taint;
+
+		/* For fills and gradients, or (1, 1, 1, opacity) */
+		Vec4 color;
+
+		/* Gradients and blits are drawn to the
+		 * unclipped rectangle, which can be flipped */
+		IntRect posRect;
+
+		Vec4 color2;
+		bool vertical;
+
+		TexPin source;
+		IntRect sourceRect;
+	};
+
+	std::vector<PendingWrite> pendingWrites;
+
+	/* Union of the pending writes' areas */
+	pixman_region32_t pendingArea;
+
+	/* Created on the first flush of more than one write */
+	ColorQuadArray *writeQuads;
+
+	/* Nesting depth of Bitmap::beginBatch() */
+	int batchDepth;
+
 	BitmapPrivate(Bitmap *self)
 	    : self(self),
-	      megaSurface(0),
-	      surface(0)
+	      shared(0),
+	      writeQuads(0),
+	      batchDepth(0)
 	{
 		format = SDL_AllocFormat(SDL_PIXELFORMAT_ABGR8888);
 
 		font = &shState->defaultFont();
 		pixman_region32_init(&tainted);
+		pixman_region32_init(&pendingArea);
 	}
 
 	~BitmapPrivate()
 	{
+		for (size_t i = 0; i < tiles.size(); ++i)
+			dropTile(tiles[i]);
+
+		dropPendingWrites();
+		delete writeQuads;
+
 		SDL_FreeFormat(format);
 		pixman_region32_fini(&tainted);
+		pixman_region32_fini(&pendingArea);
 	}
 
-	void allocSurface()
+	bool isMega() const
 	{
-		surface = SDL_CreateRGBSurface(0, gl.width, gl.height, format->BitsPerPixel,
-		                               format->Rmask, format->Gmask,
-		                               format->Bmask, format->Amask);
+		return !megaTiles.empty();
+	}
+
+	void initMega(int width, int height)
+	{
+		const int tileSize = glState.caps.maxTexSize;
+
+		gl.width = width;
+		gl.height = height;
+
+		try
+		{
+			for (int y = 0; y < height; y += tileSize)
+				for (int x = 0; x < width; x += tileSize)
+				{
+					MegaTile tile;
+					tile.rect = IntRect(x, y, std::min(tileSize, width - x),
+					                          std::min(tileSize, height - y));
+					tile.bitmap = new Bitmap(tile.rect.w, tile.rect.h);
+					tile.bitmap->setInitFont(font);
+
+					megaTiles.push_back(tile);
+				}
+		}
+		catch (const Exception &)
+		{
+			finiMega();
+			throw;
+		}
+	}
+
+	void finiMega()
+	{
+		for (size_t i = 0; i < megaTiles.size(); ++i)
+			delete megaTiles[i].bitmap;
+
+		megaTiles.clear();
+	}
+
+	/* Calls 'func(tile, tileRect)' for each mega tile
+	 * overlapping 'area' (in bitmap coordinates) */
+	template<typename F>
+	void forMegaTiles(const IntRect &area, F func) const
+	{
+		IntRect norm = normalizedRect(area);
+
+		for (size_t i = 0; i < megaTiles.size(); ++i)
+			if (SDL_HasIntersection(&norm, &megaTiles[i].rect))
+				func(*megaTiles[i].bitmap, megaTiles[i].rect);
+	}
+
+	/* Mega bitmaps aren't drawn to themselves, so nothing
+	 * else would tell listeners about changes to their tiles */
+	void megaModified()
+	{
+		shState->markDirty();
+		self->modified();
+	}
+
+	int tilesX() const
+	{
+		return (gl.width + READBACK_TILE - 1) / READBACK_TILE;
+	}
+
+	int tilesY() const
+	{
+		return (gl.height + READBACK_TILE - 1) / READBACK_TILE;
+	}
+
+	IntRect tileRect(int tx, int ty) const
+	{
+		IntRect rect(tx * READBACK_TILE, ty * READBACK_TILE,
+		             READBACK_TILE, READBACK_TILE);
+
+		rect.w = std::min(rect.w, gl.width  - rect.x);
+		rect.h = std::min(rect.h, gl.height - rect.y);
+
+		return rect;
+	}
+
+	ReadbackTile &tileAt(int tx, int ty)
+	{
+		if (tiles.empty())
+			tiles.resize(tilesX() * tilesY());
+
+		return tiles[ty * tilesX() + tx];
+	}
+
+	void dropTile(ReadbackTile &tile)
+	{
+		if (tile.pbo)
+		{
+			::gl.DeleteBuffers(1, &tile.pbo);
+			tile.pbo = 0;
+		}
+
+		tile.valid = false;
+	}
+
+	/* Reads 'rect' of the bitmap into the currently bound
+	 * pixel pack target ('data' is an offset if a pack
+	 * buffer is bound) */
+	void readPixels(const IntRect &rect, void *data)
+	{
+		const Vec2i orig = texOrigin();
+
+		FBO::bind(backingTex().fbo);
+		::gl.ReadPixels(orig.x + rect.x, orig.y + rect.y, rect.w, rect.h,
+		                GL_RGBA, GL_UNSIGNED_BYTE, data);
+	}
+
+	/* Starts an asynchronous readback of the tile if the
+	 * GL supports it, otherwise reads it right away */
+	void requestTile(int tx, int ty)
+	{
+		ReadbackTile &tile = tileAt(tx, ty);
+
+		if (tile.valid || tile.pbo)
+			return;
+
+		if (!::gl.MapBuffer)
+		{
+			fetchTile(tx, ty);
+			return;
+		}
+
+		const IntRect rect = tileRect(tx, ty);
+
+		::gl.GenBuffers(1, &tile.pbo);
+		::gl.BindBuffer(GL_PIXEL_PACK_BUFFER, tile.pbo);
+		::gl.BufferData(GL_PIXEL_PACK_BUFFER, rect.w * rect.h * 4, 0, GL_STREAM_READ);
+
+		readPixels(rect, 0);
+
+		::gl.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	/* Makes the tile valid, completing a pending asynchronous
+	 * readback or doing a synchronous one */
+	ReadbackTile &fetchTile(int tx, int ty)
+	{
+		ReadbackTile &tile = tileAt(tx, ty);
+
+		if (tile.valid)
+			return tile;
+
+		const IntRect rect = tileRect(tx, ty);
+		tile.pixels.resize(rect.w * rect.h);
+
+		if (tile.pbo)
+		{
+			::gl.BindBuffer(GL_PIXEL_PACK_BUFFER, tile.pbo);
+
+			const void *data = ::gl.MapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+			memcpy(dataPtr(tile.pixels), data, rect.w * rect.h * 4);
+
+			::gl.UnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			::gl.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+			::gl.DeleteBuffers(1, &tile.pbo);
+			tile.pbo = 0;
+		}
+		else
+		{
+			readPixels(rect, dataPtr(tile.pixels));
+		}
+
+		tile.valid = true;
+
+		return tile;
+	}
+
+	/* Pixel inside a valid tile */
+	uint32_t &cachedPixel(ReadbackTile &tile, int x, int y) const
+	{
+		const int tileW = std::min(READBACK_TILE, gl.width - (x - x % READBACK_TILE));
+
+		return tile.pixels[(y % READBACK_TILE) * tileW + (x % READBACK_TILE)];
+	}
+
+	/* Drops all cached tiles touching 'area' */
+	void invalidateTiles(const IntRect &area)
+	{
+		if (tiles.empty())
+			return;
+
+		IntRect norm = normalizedRect(area);
+
+		int x1 = std::max(norm.x, 0);
+		int y1 = std::max(norm.y, 0);
+		int x2 = std::min(norm.x + norm.w, gl.width);
+		int y2 = std::min(norm.y + norm.h, gl.height);
+
+		if (x1 >= x2 || y1 >= y2)
+			return;
+
+		for (int ty = y1 / READBACK_TILE; ty <= (y2-1) / READBACK_TILE; ++ty)
+			for (int tx = x1 / READBACK_TILE; tx <= (x2-1) / READBACK_TILE; ++tx)
+				dropTile(tileAt(tx, ty));
 	}
 
 	void clearTaintedArea()
@@ -170,10 +507,153 @@ struct BitmapPrivate
 		return result != PIXMAN_REGION_OUT;
 	}
 
+	TEXFBO &backingTex()
+	{
+		flushWrites();
+
+		if (atlas.valid())
+			return shState->bitmapAtlas().page(atlas);
+
+		return gl;
+	}
+
+	Vec2i texOrigin() const
+	{
+		return atlas.valid() ? atlas.rect.pos() : Vec2i();
+	}
+
+	void leaveAtlas()
+	{
+		if (!atlas.valid())
+			return;
+
+		TEXFBO tex = shState->texPool().request(gl.width, gl.height);
+
+		GLMeta::blitBegin(tex);
+		GLMeta::blitSource(backingTex());
+		GLMeta::blitRectangle(atlas.rect, Vec2i());
+		GLMeta::blitEnd();
+
+		/* Releasing might wipe the page */
+		shState->bitmapAtlas().release(atlas);
+		gl = tex;
+	}
+
+	/* Makes 'gl' share its texture with 'other' */
+	void shareTex(BitmapPrivate &other)
+	{
+		if (!other.shared)
+		{
+			other.shared = new SharedTex;
+			other.shared->refCount = 1;
+		}
+
+		++other.shared->refCount;
+
+		shared = other.shared;
+		gl = other.gl;
+	}
+
+	TexPin pinTex()
+	{
+		flushWrites();
+
+		TexPin pin;
+		pin.tex = backingTex();
+		pin.origin = texOrigin();
+		pin.shared = 0;
+		pin.atlas = atlas;
+
+		if (atlas.valid())
+		{
+			shState->bitmapAtlas().retain(atlas);
+		}
+		else
+		{
+			if (!shared)
+			{
+				shared = new SharedTex;
+				shared->refCount = 1;
+			}
+
+			++shared->refCount;
+			pin.shared = shared;
+		}
+
+		return pin;
+	}
+
+	static void unpinTex(TexPin &pin)
+	{
+		if (pin.atlas.valid())
+		{
+			shState->bitmapAtlas().release(pin.atlas);
+		}
+		else if (--pin.shared->refCount == 0)
+		{
+			delete pin.shared;
+			shState->texPool().release(pin.tex);
+		}
+	}
+
+	/* Gives up this bitmap's reference to the texture in 'gl' */
+	void releaseTex()
+	{
+		if (shared)
+		{
+			const bool lastRef = (--shared->refCount == 0);
+
+			if (lastRef)
+				delete shared;
+
+			shared = 0;
+
+			if (!lastRef)
+				return;
+		}
+
+		shState->texPool().release(gl);
+	}
+
+	void leaveShared()
+	{
+		if (!shared)
+			return;
+
+		/* Everyone else already made their own copy */
+		if (shared->refCount == 1)
+		{
+			delete shared;
+			shared = 0;
+
+			return;
+		}
+
+		--shared->refCount;
+		shared = 0;
+
+		TEXFBO tex = shState->texPool().request(gl.width, gl.height);
+
+		GLMeta::blitBegin(tex);
+		GLMeta::blitSource(gl);
+		GLMeta::blitRectangle(IntRect(0, 0, gl.width, gl.height), Vec2i());
+		GLMeta::blitEnd();
+
+		gl = tex;
+	}
+
+	void makeWritable()
+	{
+		leaveAtlas();
+		leaveShared();
+	}
+
 	void bindTexture(ShaderBase &shader)
 	{
-		TEX::bind(gl.tex);
-		shader.setTexSize(Vec2i(gl.width, gl.height));
+		TEXFBO &tex = backingTex();
+
+		TEX::bind(tex.tex);
+		shader.setTexSize(Vec2i(tex.texWidth, tex.texHeight), texOrigin());
 	}
 
 	void bindFBO()
@@ -215,6 +695,327 @@ struct BitmapPrivate
 		glState.scissorTest.pop();
 	}
 
+	/* Applies a solid color write to the cached readback
+	 * tiles it touches, so they needn't be read back again */
+	void patchTiles(const IntRect &area, const Vec4 &color)
+	{
+		if (tiles.empty())
+			return;
+
+		const uint32_t pixel = SDL_MapRGBA(format, unormByte(color.x), unormByte(color.y),
+		                                   unormByte(color.z), unormByte(color.w));
+
+		const int x2 = area.x + area.w;
+		const int y2 = area.y + area.h;
+
+		for (int ty = area.y / READBACK_TILE; ty <= (y2-1) / READBACK_TILE; ++ty)
+			for (int tx = area.x / READBACK_TILE; tx <= (x2-1) / READBACK_TILE; ++tx)
+			{
+				ReadbackTile &tile = tileAt(tx, ty);
+
+				if (!tile.valid)
+				{
+					/* A pending readback would miss the write */
+					dropTile(tile);
+					continue;
+				}
+
+				const IntRect tRect = tileRect(tx, ty);
+
+				for (int y = std::max(area.y, tRect.y); y < std::min(y2, tRect.y + tRect.h); ++y)
+					for (int x = std::max(area.x, tRect.x); x < std::min(x2, tRect.x + tRect.w); ++x)
+						cachedPixel(tile, x, y) = pixel;
+			}
+	}
+
+	/* Clips 'area' to the bitmap into 'out',
+	 * returns false if nothing is left */
+	bool clipToBitmap(const IntRect &area, IntRect &out) const
+	{
+		IntRect norm = normalizedRect(area);
+
+		int x1 = std::max(norm.x, 0);
+		int y1 = std::max(norm.y, 0);
+		int x2 = std::min(norm.x + norm.w, gl.width);
+		int y2 = std::min(norm.y + norm.h, gl.height);
+
+		if (x1 >= x2 || y1 >= y2)
+			return false;
+
+		out = IntRect(x1, y1, x2 - x1, y2 - y1);
+
+		return true;
+	}
+
+	bool touchesPendingArea(const IntRect &rect)
+	{
+		pixman_box32_t box;
+		box.x1 = rect.x;
+		box.y1 = rect.y;
+		box.x2 = rect.x + rect.w;
+		box.y2 = rect.y + rect.h;
+
+		return pixman_region32_contains_rectangle(&pendingArea, &box) != PIXMAN_REGION_OUT;
+	}
+
+	void queueWrite(const IntRect &rect, const Vec4 &color, TaintOp taint)
+	{
+		PendingWrite write;
+		write.op = WriteFill;
+		write.color = color;
+		write.taint = taint;
+
+		if (!clipToBitmap(rect, write.rect))
+			return;
+
+		makeWritable();
+
+		patchTiles(write.rect, color);
+
+		/* Covers up everything written before */
+		if (write.rect.w == gl.width && write.rect.h == gl.height)
+			dropPendingWrites();
+
+		pushWrite(write);
+	}
+
+	void queueGradient(const IntRect &rect, const Vec4 &color1,
+	                   const Vec4 &color2, bool vertical)
+	{
+		PendingWrite write;
+		write.op = WriteGradient;
+		write.posRect = rect;
+		write.color = color1;
+		write.color2 = color2;
+		write.vertical = vertical;
+		write.taint = TaintAdd;
+
+		if (!clipToBitmap(rect, write.rect))
+			return;
+
+		makeWritable();
+		invalidateTiles(write.rect);
+		pushWrite(write);
+	}
+
+	/* 'source' can't be this bitmap */
+	void queueBlt(const IntRect &destRect, BitmapPrivate &source,
+	              const IntRect &sourceRect, int opacity)
+	{
+		PendingWrite write;
+		write.op = WriteBlt;
+		write.posRect = destRect;
+		write.sourceRect = sourceRect;
+		write.color = Vec4(1, 1, 1, opacity / 255.0f);
+		write.taint = TaintAdd;
+
+		if (!clipToBitmap(destRect, write.rect))
+			return;
+
+		makeWritable();
+
+		/* Blits blend with the destination as it was before
+		 * the flush, so they can't go on top of anything else
+		 * that is pending */
+		if (touchesPendingArea(write.rect))
+			flushWrites();
+
+		write.source = source.pinTex();
+
+		invalidateTiles(write.rect);
+		pushWrite(write);
+	}
+
+	void pushWrite(const PendingWrite &write)
+	{
+		const bool first = pendingWrites.empty();
+		pendingWrites.push_back(write);
+
+		pixman_region32_union_rect(&pendingArea, &pendingArea, write.rect.x, write.rect.y,
+		                           write.rect.w, write.rect.h);
+
+		shState->markDirty();
+
+		/* Whoever reacts to the signal will go through
+		 * a flush before reading the new contents, so
+		 * one signal per batch is enough */
+		if (first)
+		{
+			schedulePrepare();
+			self->modified();
+		}
+	}
+
+	void dropPendingWrites()
+	{
+		for (size_t i = 0; i < pendingWrites.size(); ++i)
+			if (pendingWrites[i].op == WriteBlt)
+				unpinTex(pendingWrites[i].source);
+
+		pendingWrites.clear();
+
+		pixman_region32_fini(&pendingArea);
+		pixman_region32_init(&pendingArea);
+	}
+
+	/* Draws all pending writes. Like any other drawing, this
+	 * leaves the bitmap's framebuffer bound; tracked glState
+	 * properties are restored. Pending writes are normally
+	 * drawn by the prepare pass before the scene is composited,
+	 * and anyone reading bitmaps while building their own
+	 * target (eg. tilemap atlases) fetches them up front */
+	void flushWrites()
+	{
+		if (pendingWrites.empty())
+			return;
+
+		for (size_t i = 0; i < pendingWrites.size(); ++i)
+		{
+			const PendingWrite &write = pendingWrites[i];
+
+			if (write.taint == TaintAdd)
+				addTaintedArea(write.rect);
+			else if (write.taint == TaintSubtract)
+				substractTaintedArea(write.rect);
+		}
+
+		if (pendingWrites.size() == 1 && pendingWrites[0].op == WriteFill)
+		{
+			/* Not worth a vertex upload */
+			fillRect(pendingWrites[0].rect, pendingWrites[0].color);
+		}
+		else
+		{
+			drawWrites();
+		}
+
+		dropPendingWrites();
+	}
+
+	/* Whether writes 'a' and 'b' can go into one draw call */
+	static bool sameRun(const PendingWrite &a, const PendingWrite &b)
+	{
+		if (a.op != WriteBlt || b.op != WriteBlt)
+			return a.op != WriteBlt && b.op != WriteBlt;
+
+		return a.source.tex.tex == b.source.tex.tex && a.source.origin == b.source.origin;
+	}
+
+	void drawWrites()
+	{
+		if (!writeQuads)
+			writeQuads = new ColorQuadArray;
+
+		writeQuads->resize(pendingWrites.size());
+		std::vector<Vertex> &vert = writeQuads->vertices;
+
+		IntRect bltArea;
+		bool haveBlt = false;
+
+		for (size_t i = 0; i < pendingWrites.size(); ++i)
+		{
+			const PendingWrite &write = pendingWrites[i];
+			Vertex *v = &vert[i*4];
+
+			switch (write.op)
+			{
+			case WriteFill :
+				Quad::setPosRect(v, FloatRect(write.rect));
+				Quad::setColor(v, write.color);
+				break;
+
+			case WriteGradient :
+				Quad::setPosRect(v, FloatRect(write.posRect));
+				v[0].color = write.color;
+				v[1].color = write.vertical ? write.color : write.color2;
+				v[2].color = write.color2;
+				v[3].color = write.vertical ? write.color2 : write.color;
+				break;
+
+			case WriteBlt :
+				Quad::setTexPosRect(v, FloatRect(write.sourceRect), FloatRect(write.posRect));
+				Quad::setColor(v, write.color);
+
+				if (haveBlt)
+					SDL_UnionRect(&bltArea, &write.rect, &bltArea);
+				else
+					bltArea = write.rect;
+
+				haveBlt = true;
+				break;
+			}
+		}
+
+		writeQuads->commit();
+
+		glState.program.push();
+
+		/* Read the destination once for all blits */
+		TEXFBO *dstCopy = 0;
+
+		if (haveBlt)
+		{
+			dstCopy = &shState->gpTexFBO(bltArea.w, bltArea.h);
+
+			GLMeta::blitBegin(*dstCopy);
+			GLMeta::blitSource(gl);
+			GLMeta::blitRectangle(bltArea, Vec2i());
+			GLMeta::blitEnd();
+		}
+
+		bindFBO();
+		glState.viewport.pushSet(IntRect(0, 0, gl.width, gl.height));
+
+		glState.scissorTest.pushSet(false);
+		glState.blend.pushSet(false);
+
+		for (size_t i = 0; i < pendingWrites.size();)
+		{
+			const PendingWrite &write = pendingWrites[i];
+			size_t end = i + 1;
+
+			while (end < pendingWrites.size() && sameRun(write, pendingWrites[end]))
+				++end;
+
+			if (write.op == WriteBlt)
+			{
+				BltBatchShader &shader = shState->shaders().bltBatch;
+				shader.bind();
+				shader.applyViewportProj();
+				shader.setTranslation(Vec2i());
+				shader.setSource();
+				shader.setDestination(dstCopy->tex, bltArea.pos(),
+				                      Vec2i(dstCopy->width, dstCopy->height));
+
+				TEX::bind(write.source.tex.tex);
+				shader.setTexSize(Vec2i(write.source.tex.texWidth, write.source.tex.texHeight),
+				                  write.source.origin);
+			}
+			else
+			{
+				SimpleColorShader &shader = shState->shaders().simpleColor;
+				shader.bind();
+				shader.applyViewportProj();
+				shader.setTranslation(Vec2i());
+			}
+
+			writeQuads->draw(i, end - i);
+			i = end;
+		}
+
+		glState.blend.pop();
+		glState.scissorTest.pop();
+
+		glState.viewport.pop();
+
+		glState.program.pop();
+	}
+
+	void prepare()
+	{
+		flushWrites();
+	}
+
 	static void ensureFormat(SDL_Surface *&surf, Uint32 format)
 	{
 		if (surf->format->format == format)
@@ -225,51 +1026,78 @@ struct BitmapPrivate
 		surf = surfConv;
 	}
 
-	void onModified(bool freeSurface = true)
+	/* 'area' is the part of the bitmap that changed */
+	void onModified(const IntRect &area)
 	{
-		if (surface && freeSurface)
-		{
-			SDL_FreeSurface(surface);
-			surface = 0;
-		}
+		invalidateTiles(area);
 
+		shState->markDirty();
 		self->modified();
 	}
-};
 
-struct BitmapOpenHandler : FileSystem::OpenHandler
-{
-	SDL_Surface *surf;
-
-	BitmapOpenHandler()
-	    : surf(0)
-	{}
-
-	bool tryRead(SDL_RWops &ops, const char *ext)
+	void onModified()
 	{
-		surf = IMG_LoadTyped_RW(&ops, 1, ext);
-		return surf != 0;
+		onModified(IntRect(0, 0, gl.width, gl.height));
 	}
 };
 
 Bitmap::Bitmap(const char *filename)
 {
-	BitmapOpenHandler handler;
-	shState->fileSystem().openRead(handler, filename);
-	SDL_Surface *imgSurf = handler.surf;
+	/* Already decoded if it was preloaded */
+	SDL_Surface *imgSurf = shState->imageLoader().take(filename);
+
+	if (!imgSurf)
+		imgSurf = shState->imageLoader().decode(filename);
 
 	if (!imgSurf)
 		throw Exception(Exception::SDLError, "Error loading image '%s': %s",
 		                filename, SDL_GetError());
 
-	p->ensureFormat(imgSurf, SDL_PIXELFORMAT_ABGR8888);
+	BitmapAtlas::Region atlas;
 
 	if (imgSurf->w > glState.caps.maxTexSize || imgSurf->h > glState.caps.maxTexSize)
 	{
-		/* Mega surface */
+		/* Mega bitmap */
 		p = new BitmapPrivate(this);
-		p->megaSurface = imgSurf;
-		SDL_SetSurfaceBlendMode(p->megaSurface, SDL_BLENDMODE_NONE);
+
+		try
+		{
+			p->initMega(imgSurf->w, imgSurf->h);
+		}
+		catch (const Exception &e)
+		{
+			delete p;
+			SDL_FreeSurface(imgSurf);
+			throw e;
+		}
+
+		for (size_t i = 0; i < p->megaTiles.size(); ++i)
+		{
+			const BitmapPrivate::MegaTile &tile = p->megaTiles[i];
+
+			TEX::bind(tile.bitmap->p->gl.tex);
+			GLMeta::subRectImageUpload(imgSurf->w, tile.rect.x, tile.rect.y, 0, 0,
+			                           tile.rect.w, tile.rect.h, imgSurf, GL_RGBA);
+
+			tile.bitmap->p->addTaintedArea(tile.bitmap->rect());
+		}
+
+		GLMeta::subRectImageEnd();
+		SDL_FreeSurface(imgSurf);
+	}
+	else if (shState->bitmapAtlas().allocate(imgSurf->w, imgSurf->h, atlas))
+	{
+		/* Atlased surface */
+		p = new BitmapPrivate(this);
+		p->atlas = atlas;
+		p->gl.width = imgSurf->w;
+		p->gl.height = imgSurf->h;
+
+		TEX::bind(p->backingTex().tex);
+		TEX::uploadSubImage(atlas.rect.x, atlas.rect.y, atlas.rect.w, atlas.rect.h,
+		                    imgSurf->pixels, GL_RGBA);
+
+		SDL_FreeSurface(imgSurf);
 	}
 	else
 	{
@@ -289,8 +1117,9 @@ Bitmap::Bitmap(const char *filename)
 		p = new BitmapPrivate(this);
 		p->gl = tex;
 
+		/* The texture can be larger than the image */
 		TEX::bind(p->gl.tex);
-		TEX::uploadImage(p->gl.width, p->gl.height, imgSurf->pixels, GL_RGBA);
+		TEX::uploadSubImage(0, 0, p->gl.width, p->gl.height, imgSurf->pixels, GL_RGBA);
 
 		SDL_FreeSurface(imgSurf);
 	}
@@ -298,11 +1127,34 @@ Bitmap::Bitmap(const char *filename)
 	p->addTaintedArea(rect());
 }
 
+void Bitmap::preload(const char *filename)
+{
+	shState->imageLoader().preload(filename);
+}
+
 Bitmap::Bitmap(int width, int height)
 {
 	if (width <= 0 || height <= 0)
 		throw Exception(Exception::RGSSError, "Invalid bitmap dimensions (w=%d h=%d)", width, height);
 
+	if (width > glState.caps.maxTexSize || height > glState.caps.maxTexSize)
+	{
+		/* Mega bitmap, tiles start out cleared */
+		p = new BitmapPrivate(this);
+
+		try
+		{
+			p->initMega(width, height);
+		}
+		catch (const Exception &e)
+		{
+			delete p;
+			throw e;
+		}
+
+		return;
+	}
+
 	TEXFBO tex = shState->texPool().request(width, height);
 
 	p = new BitmapPrivate(this);
@@ -313,13 +1165,41 @@ Bitmap::Bitmap(int width, int height)
 
 Bitmap::Bitmap(const Bitmap &other)
 {
-	other.ensureNonMega();
-
 	p = new BitmapPrivate(this);
 
-	p->gl = shState->texPool().request(other.width(), other.height());
+	if (other.p->isMega())
+	{
+		p->gl.width = other.width();
+		p->gl.height = other.height();
+
+		/* Clones of the tiles share their textures in turn */
+		for (size_t i = 0; i < other.p->megaTiles.size(); ++i)
+		{
+			BitmapPrivate::MegaTile tile = other.p->megaTiles[i];
+			tile.bitmap = new Bitmap(*tile.bitmap);
+			tile.bitmap->setInitFont(p->font);
+
+			p->megaTiles.push_back(tile);
+		}
+
+		return;
+	}
+
+	/* Atlas pages can't be shared this way */
+	if (other.p->atlas.valid())
+	{
+		p->gl = shState->texPool().request(other.width(), other.height());
+
+		blt(0, 0, other, rect());
+
+		return;
+	}
+
+	/* Copied once either of us is written to */
+	other.p->flushWrites();
+	p->shareTex(*other.p);
 
-	blt(0, 0, other, rect());
+	pixman_region32_copy(&p->tainted, &other.p->tainted);
 }
 
 Bitmap::~Bitmap()
@@ -331,9 +1211,6 @@ int Bitmap::width() const
 {
 	guardDisposed();
 
-	if (p->megaSurface)
-		return p->megaSurface->w;
-
 	return p->gl.width;
 }
 
@@ -341,9 +1218,6 @@ int Bitmap::height() const
 {
 	guardDisposed();
 
-	if (p->megaSurface)
-		return p->megaSurface->h;
-
 	return p->gl.height;
 }
 
@@ -383,8 +1257,6 @@ void Bitmap::stretchBlt(const IntRect &destRect,
 {
 	guardDisposed();
 
-	GUARD_MEGA;
-
 	if (source.isDisposed())
 		return;
 
@@ -393,92 +1265,64 @@ void Bitmap::stretchBlt(const IntRect &destRect,
 	if (opacity == 0)
 		return;
 
-	SDL_Surface *srcSurf = source.megaSurface();
-
-	if (srcSurf && shState->config().subImageFix)
+	if (p->isMega())
 	{
-		/* Blit from software surface, for broken GL drivers */
-		Vec2i gpTexSize;
-		shState->ensureTexSize(sourceRect.w, sourceRect.h, gpTexSize);
-		shState->bindTex();
-
-		GLMeta::subRectImageUpload(srcSurf->w, sourceRect.x, sourceRect.y, 0, 0,
-		                           sourceRect.w, sourceRect.h, srcSurf, GL_RGBA);
-		GLMeta::subRectImageEnd();
-
-		SimpleShader &shader = shState->shaders().simple;
-		shader.bind();
-		shader.setTranslation(Vec2i());
-		shader.setTexSize(gpTexSize);
-
-		p->pushSetViewport(shader);
-		p->bindFBO();
-
-		Quad &quad = shState->gpQuad();
-		quad.setTexRect(FloatRect(0, 0, sourceRect.w, sourceRect.h));
-		quad.setPosRect(destRect);
-
-		p->blitQuad(quad);
-		p->popViewport();
-
-		p->addTaintedArea(destRect);
-		p->onModified();
+		p->forMegaTiles(destRect, [&](Bitmap &tile, const IntRect &tileRect)
+		{
+			tile.stretchBlt(toTile(destRect, tileRect), source, sourceRect, opacity);
+		});
 
+		p->megaModified();
 		return;
 	}
-	else if (srcSurf)
-	{
-		/* Blit from software surface */
-		/* Don't do transparent blits for now */
-		if (opacity < 255)
-			source.ensureNonMega();
-
-		SDL_Rect srcRect = sourceRect;
-		SDL_Rect dstRect = destRect;
-		SDL_Rect btmRect = { 0, 0, width(), height() };
-		SDL_Rect bltRect;
 
-		if (SDL_IntersectRect(&btmRect, &dstRect, &bltRect) != SDL_TRUE)
+	if (source.p->isMega())
+	{
+		if (sourceRect.w <= 0 || sourceRect.h <= 0)
 			return;
 
-		int bpp;
-		Uint32 rMask, gMask, bMask, aMask;
-		SDL_PixelFormatEnumToMasks(SDL_PIXELFORMAT_ABGR8888,
-		                           &bpp, &rMask, &gMask, &bMask, &aMask);
-		SDL_Surface *blitTemp =
-			SDL_CreateRGBSurface(0, destRect.w, destRect.h, bpp, rMask, gMask, bMask, aMask);
+		const float scaleX = (float) destRect.w / sourceRect.w;
+		const float scaleY = (float) destRect.h / sourceRect.h;
 
-		SDL_BlitScaled(srcSurf, &srcRect, blitTemp, 0);
+		/* Blit each tile's part of 'sourceRect' to the matching
+		 * part of 'destRect'. Edges are rounded the same way on
+		 * both sides of a tile border, so the parts line up */
+		source.p->forMegaTiles(sourceRect, [&](Bitmap &tile, const IntRect &tileRect)
+		{
+			IntRect part;
+			SDL_IntersectRect(&sourceRect, &tileRect, &part);
 
-		TEX::bind(p->gl.tex);
+			int x1 = destRect.x + lroundf((part.x - sourceRect.x) * scaleX);
+			int y1 = destRect.y + lroundf((part.y - sourceRect.y) * scaleY);
+			int x2 = destRect.x + lroundf((part.x + part.w - sourceRect.x) * scaleX);
+			int y2 = destRect.y + lroundf((part.y + part.h - sourceRect.y) * scaleY);
 
-		if (bltRect.w == dstRect.w && bltRect.h == dstRect.h)
-		{
-			/* Dest rectangle lies within bounding box */
-			TEX::uploadSubImage(destRect.x, destRect.y,
-			                    destRect.w, destRect.h,
-			                    blitTemp->pixels, GL_RGBA);
-		}
-		else
-		{
-			/* Clipped blit */
-			GLMeta::subRectImageUpload(blitTemp->w, bltRect.x - dstRect.x, bltRect.y - dstRect.y,
-			                           bltRect.x, bltRect.y, bltRect.w, bltRect.h, blitTemp, GL_RGBA);
-			GLMeta::subRectImageEnd();
-		}
+			stretchBlt(IntRect(x1, y1, x2 - x1, y2 - y1),
+			           tile, toTile(part, tileRect), opacity);
+		});
 
-		SDL_FreeSurface(blitTemp);
+		return;
+	}
 
-		p->onModified();
+	if (p->batchDepth > 0 && &source != this)
+	{
+		p->queueBlt(destRect, *source.p, sourceRect, opacity);
 		return;
 	}
 
+	p->makeWritable();
+	p->flushWrites();
+	source.p->flushWrites();
+
 	if (opacity == 255 && !p->touchesTaintedArea(destRect))
 	{
 		/* Fast blit */
+		IntRect srcRect = sourceRect;
+		srcRect.setPos(srcRect.pos() + source.p->texOrigin());
+
 		GLMeta::blitBegin(p->gl);
-		GLMeta::blitSource(source.p->gl);
-		GLMeta::blitRectangle(sourceRect, destRect);
+		GLMeta::blitSource(source.p->backingTex());
+		GLMeta::blitRectangle(srcRect, destRect);
 		GLMeta::blitEnd();
 	}
 	else
@@ -493,10 +1337,16 @@ void Bitmap::stretchBlt(const IntRect &destRect,
 		GLMeta::blitRectangle(destRect, Vec2i());
 		GLMeta::blitEnd();
 
-		FloatRect bltSubRect((float) sourceRect.x / source.width(),
-		                     (float) sourceRect.y / source.height(),
-		                     ((float) source.width() / sourceRect.w) * ((float) destRect.w / gpTex.width),
-		                     ((float) source.height() / sourceRect.h) * ((float) destRect.h / gpTex.height));
+		/* Source coordinates are normalized to the
+		 * backing texture, which for atlased bitmaps
+		 * is larger than the bitmap itself */
+		const TEXFBO &srcTex = source.p->backingTex();
+		const Vec2i srcOrig = source.p->texOrigin();
+
+		FloatRect bltSubRect((float) (sourceRect.x + srcOrig.x) / srcTex.texWidth,
+		                     (float) (sourceRect.y + srcOrig.y) / srcTex.texHeight,
+		                     ((float) srcTex.texWidth / sourceRect.w) * ((float) destRect.w / gpTex.width),
+		                     ((float) srcTex.texHeight / sourceRect.h) * ((float) destRect.h / gpTex.height));
 
 		BltShader &shader = shState->shaders().blt;
 		shader.bind();
@@ -518,7 +1368,7 @@ void Bitmap::stretchBlt(const IntRect &destRect,
 	}
 
 	p->addTaintedArea(destRect);
-	p->onModified();
+	p->onModified(destRect);
 }
 
 void Bitmap::fillRect(int x, int y,
@@ -532,18 +1382,23 @@ void Bitmap::fillRect(const IntRect &rect, const Vec4 &color)
 {
 	guardDisposed();
 
-	GUARD_MEGA;
+	if (p->isMega())
+	{
+		p->forMegaTiles(rect, [&](Bitmap &tile, const IntRect &tileRect)
+		{
+			tile.fillRect(toTile(rect, tileRect), color);
+		});
 
-	p->fillRect(rect, color);
+		p->megaModified();
+		return;
+	}
 
 	if (color.w == 0)
 		/* Clear op */
-		p->substractTaintedArea(rect);
+		p->queueWrite(rect, color, BitmapPrivate::TaintSubtract);
 	else
 		/* Fill op */
-		p->addTaintedArea(rect);
-
-	p->onModified();
+		p->queueWrite(rect, color, BitmapPrivate::TaintAdd);
 }
 
 void Bitmap::gradientFillRect(int x, int y,
@@ -560,41 +1415,18 @@ void Bitmap::gradientFillRect(const IntRect &rect,
 {
 	guardDisposed();
 
-	GUARD_MEGA;
-
-	SimpleColorShader &shader = shState->shaders().simpleColor;
-	shader.bind();
-	shader.setTranslation(Vec2i());
-
-	Quad &quad = shState->gpQuad();
-
-	if (vertical)
+	if (p->isMega())
 	{
-		quad.vert[0].color = color1;
-		quad.vert[1].color = color1;
-		quad.vert[2].color = color2;
-		quad.vert[3].color = color2;
-	}
-	else
-	{
-		quad.vert[0].color = color1;
-		quad.vert[3].color = color1;
-		quad.vert[1].color = color2;
-		quad.vert[2].color = color2;
-	}
-
-	quad.setPosRect(rect);
-
-	p->bindFBO();
-	p->pushSetViewport(shader);
-
-	p->blitQuad(quad);
-
-	p->popViewport();
+		p->forMegaTiles(rect, [&](Bitmap &tile, const IntRect &tileRect)
+		{
+			tile.gradientFillRect(toTile(rect, tileRect), color1, color2, vertical);
+		});
 
-	p->addTaintedArea(rect);
+		p->megaModified();
+		return;
+	}
 
-	p->onModified();
+	p->queueGradient(rect, color1, color2, vertical);
 }
 
 void Bitmap::clearRect(int x, int y, int width, int height)
@@ -606,18 +1438,39 @@ void Bitmap::clearRect(const IntRect &rect)
 {
 	guardDisposed();
 
-	GUARD_MEGA;
+	if (p->isMega())
+	{
+		p->forMegaTiles(rect, [&](Bitmap &tile, const IntRect &tileRect)
+		{
+			tile.clearRect(toTile(rect, tileRect));
+		});
 
-	p->fillRect(rect, Vec4());
+		p->megaModified();
+		return;
+	}
 
-	p->onModified();
+	p->queueWrite(rect, Vec4(), BitmapPrivate::TaintKeep);
 }
 
 void Bitmap::blur()
 {
 	guardDisposed();
 
-	GUARD_MEGA;
+	/* Each tile on its own; the borders between
+	 * them stay a little sharper */
+	if (p->isMega())
+	{
+		p->forMegaTiles(rect(), [&](Bitmap &tile, const IntRect &)
+		{
+			tile.blur();
+		});
+
+		p->megaModified();
+		return;
+	}
+
+	p->makeWritable();
+	p->flushWrites();
 
 	Quad &quad = shState->gpQuad();
 	FloatRect rect(0, 0, width(), height());
@@ -636,7 +1489,7 @@ void Bitmap::blur()
 	FBO::bind(auxTex.fbo);
 
 	pass1.bind();
-	pass1.setTexSize(Vec2i(width(), height()));
+	pass1.setTexSize(Vec2i(p->gl.texWidth, p->gl.texHeight));
 	pass1.applyViewportProj();
 
 	quad.draw();
@@ -645,7 +1498,7 @@ void Bitmap::blur()
 	p->bindFBO();
 
 	pass2.bind();
-	pass2.setTexSize(Vec2i(width(), height()));
+	pass2.setTexSize(Vec2i(auxTex.texWidth, auxTex.texHeight));
 	pass2.applyViewportProj();
 
 	quad.draw();
@@ -663,6 +1516,8 @@ void Bitmap::radialBlur(int angle, int divisions)
 	guardDisposed();
 
 	GUARD_MEGA;
+	p->leaveAtlas();
+	p->flushWrites();
 
 	angle     = clamp<int>(angle, 0, 359);
 	divisions = clamp<int>(divisions, 2, 100);
@@ -747,7 +1602,7 @@ void Bitmap::radialBlur(int angle, int divisions)
 	glState.blendMode.pop();
 	glState.clearColor.pop();
 
-	shState->texPool().release(p->gl);
+	p->releaseTex();
 	p->gl = newTex;
 
 	p->onModified();
@@ -757,7 +1612,30 @@ void Bitmap::clear()
 {
 	guardDisposed();
 
-	GUARD_MEGA;
+	if (p->isMega())
+	{
+		p->forMegaTiles(rect(), [&](Bitmap &tile, const IntRect &)
+		{
+			tile.clear();
+		});
+
+		p->megaModified();
+		return;
+	}
+
+	/* No point in copying a shared texture first */
+	if (p->shared)
+	{
+		const TEXFBO old = p->gl;
+
+		p->releaseTex();
+		p->gl = shState->texPool().request(old.width, old.height);
+	}
+
+	p->makeWritable();
+
+	/* Would all be cleared anyway */
+	p->dropPendingWrites();
 
 	p->bindFBO();
 
@@ -772,37 +1650,29 @@ void Bitmap::clear()
 	p->onModified();
 }
 
-static uint32_t &getPixelAt(SDL_Surface *surf, SDL_PixelFormat *form, int x, int y)
-{
-	size_t offset = x*form->BytesPerPixel + y*surf->pitch;
-	uint8_t *bytes = (uint8_t*) surf->pixels + offset;
-
-	return *((uint32_t*) bytes);
-}
-
 Color Bitmap::getPixel(int x, int y) const
 {
 	guardDisposed();
 
-	GUARD_MEGA;
-
 	if (x < 0 || y < 0 || x >= width() || y >= height())
 		return Vec4();
 
-	if (!p->surface)
+	if (p->isMega())
 	{
-		p->allocSurface();
+		Color value;
 
-		FBO::bind(p->gl.fbo);
-
-		glState.viewport.pushSet(IntRect(0, 0, width(), height()));
-
-		gl.ReadPixels(0, 0, width(), height(), GL_RGBA, GL_UNSIGNED_BYTE, p->surface->pixels);
+		p->forMegaTiles(IntRect(x, y, 1, 1), [&](Bitmap &tile, const IntRect &tileRect)
+		{
+			value = tile.getPixel(x - tileRect.x, y - tileRect.y);
+		});
 
-		glState.viewport.pop();
+		return value;
 	}
 
-	uint32_t pixel = getPixelAt(p->surface, p->format, x, y);
+	BitmapPrivate::ReadbackTile &tile =
+		p->fetchTile(x / READBACK_TILE, y / READBACK_TILE);
+
+	uint32_t pixel = p->cachedPixel(tile, x, y);
 
 	return Color((pixel >> p->format->Rshift) & 0xFF,
 	             (pixel >> p->format->Gshift) & 0xFF,
@@ -814,45 +1684,159 @@ void Bitmap::setPixel(int x, int y, const Color &color)
 {
 	guardDisposed();
 
-	GUARD_MEGA;
-
 	if (x < 0 || y < 0 || x >= width() || y >= height())
 		return;
 
-	uint8_t pixel[] =
+	if (p->isMega())
 	{
-		(uint8_t) clamp<double>(color.red,   0, 255),
-		(uint8_t) clamp<double>(color.green, 0, 255),
-		(uint8_t) clamp<double>(color.blue,  0, 255),
-		(uint8_t) clamp<double>(color.alpha, 0, 255)
-	};
+		p->forMegaTiles(IntRect(x, y, 1, 1), [&](Bitmap &tile, const IntRect &tileRect)
+		{
+			tile.setPixel(x - tileRect.x, y - tileRect.y, color);
+		});
 
-	TEX::bind(p->gl.tex);
-	TEX::uploadSubImage(x, y, 1, 1, &pixel, GL_RGBA);
+		p->megaModified();
+		return;
+	}
 
-	p->addTaintedArea(IntRect(x, y, 1, 1));
+	Vec4 value((uint8_t) clamp<double>(color.red,   0, 255) / 255.0f,
+	           (uint8_t) clamp<double>(color.green, 0, 255) / 255.0f,
+	           (uint8_t) clamp<double>(color.blue,  0, 255) / 255.0f,
+	           (uint8_t) clamp<double>(color.alpha, 0, 255) / 255.0f);
 
-	/* Setting just a single pixel is no reason to throw away the
-	 * whole cached surface; we can just apply the same change */
+	p->queueWrite(IntRect(x, y, 1, 1), value, BitmapPrivate::TaintAdd);
+}
+
+void Bitmap::prefetchPixels(int x, int y, int width, int height)
+{
+	prefetchPixels(IntRect(x, y, width, height));
+}
 
-	if (p->surface)
+void Bitmap::prefetchPixels(const IntRect &rect)
+{
+	guardDisposed();
+
+	if (p->isMega())
 	{
-		uint32_t &surfPixel = getPixelAt(p->surface, p->format, x, y);
-		surfPixel = SDL_MapRGBA(p->format, pixel[0], pixel[1], pixel[2], pixel[3]);
+		p->forMegaTiles(rect, [&](Bitmap &tile, const IntRect &tileRect)
+		{
+			tile.prefetchPixels(toTile(rect, tileRect));
+		});
+
+		return;
 	}
 
-	p->onModified(false);
+	IntRect norm = normalizedRect(rect);
+
+	int x1 = std::max(norm.x, 0);
+	int y1 = std::max(norm.y, 0);
+	int x2 = std::min(norm.x + norm.w, width());
+	int y2 = std::min(norm.y + norm.h, height());
+
+	if (x1 >= x2 || y1 >= y2)
+		return;
+
+	for (int ty = y1 / READBACK_TILE; ty <= (y2-1) / READBACK_TILE; ++ty)
+		for (int tx = x1 / READBACK_TILE; tx <= (x2-1) / READBACK_TILE; ++tx)
+			p->requestTile(tx, ty);
 }
 
-void Bitmap::hueChange(int hue)
+void Bitmap::checkTransferRect(const IntRect &rect) const
 {
 	guardDisposed();
 
-	GUARD_MEGA;
+	if (rect.x < 0 || rect.y < 0 || rect.w <= 0 || rect.h <= 0 ||
+	    rect.x + rect.w > width() || rect.y + rect.h > height())
+		throw Exception(Exception::ArgumentError,
+		                "Bitmap: pixel rect (%d, %d, %d, %d) out of bounds",
+		                rect.x, rect.y, rect.w, rect.h);
+}
+
+void Bitmap::readRect(const IntRect &rect, void *data) const
+{
+	checkTransferRect(rect);
+
+	if (p->isMega())
+	{
+		std::vector<uint8_t> part;
+
+		p->forMegaTiles(rect, [&](Bitmap &tile, const IntRect &tileRect)
+		{
+			IntRect area;
+			SDL_IntersectRect(&rect, &tileRect, &area);
+
+			part.resize(area.w * area.h * 4);
+			tile.readRect(toTile(area, tileRect), &part[0]);
+
+			for (int y = 0; y < area.h; ++y)
+				memcpy((uint8_t*) data + ((area.y - rect.y + y) * rect.w + (area.x - rect.x)) * 4,
+				       &part[y * area.w * 4], area.w * 4);
+		});
+
+		return;
+	}
+
+	p->readPixels(rect, data);
+}
+
+void Bitmap::writeRect(const IntRect &rect, const void *data)
+{
+	checkTransferRect(rect);
+
+	if (p->isMega())
+	{
+		std::vector<uint8_t> part;
+
+		p->forMegaTiles(rect, [&](Bitmap &tile, const IntRect &tileRect)
+		{
+			IntRect area;
+			SDL_IntersectRect(&rect, &tileRect, &area);
+
+			part.resize(area.w * area.h * 4);
+
+			for (int y = 0; y < area.h; ++y)
+				memcpy(&part[y * area.w * 4],
+				       (const uint8_t*) data + ((area.y - rect.y + y) * rect.w + (area.x - rect.x)) * 4,
+				       area.w * 4);
+
+			tile.writeRect(toTile(area, tileRect), &part[0]);
+		});
+
+		p->megaModified();
+		return;
+	}
+
+	p->makeWritable();
+	p->flushWrites();
+
+	TEX::bind(p->gl.tex);
+	TEX::uploadSubImage(rect.x, rect.y, rect.w, rect.h, data, GL_RGBA);
+
+	p->addTaintedArea(rect);
+
+	p->onModified(rect);
+}
+
+void Bitmap::hueChange(int hue)
+{
+	guardDisposed();
 
 	if ((hue % 360) == 0)
 		return;
 
+	if (p->isMega())
+	{
+		p->forMegaTiles(rect(), [&](Bitmap &tile, const IntRect &)
+		{
+			tile.hueChange(hue);
+		});
+
+		p->megaModified();
+		return;
+	}
+
+	p->leaveAtlas();
+	p->flushWrites();
+
 	TEXFBO newTex = shState->texPool().request(width(), height());
 
 	FloatRect texRect(rect());
@@ -876,7 +1860,7 @@ void Bitmap::hueChange(int hue)
 
 	TEX::unbind();
 
-	shState->texPool().release(p->gl);
+	p->releaseTex();
 	p->gl = newTex;
 
 	p->onModified();
@@ -1034,19 +2018,184 @@ static void applyShadow(SDL_Surface *&in, const SDL_PixelFormat &fm, const SDL_C
 	in = out;
 }
 
+static uint16_t utf8_to_ucs2(const char *_input,
+                             const char **end_ptr);
+
+/* The glyph cache only deals with characters
+ * inside of the basic multilingual plane */
+static bool decodeUcs2(const char *str, std::vector<uint16_t> &out)
+{
+	while (*str)
+	{
+		if ((uint8_t) *str >= 0xF0)
+			return false;
+
+		const char *next;
+		uint16_t ch = utf8_to_ucs2(str, &next);
+
+		if (next == str)
+			return false;
+
+		out.push_back(ch);
+		str = next;
+	}
+
+	return true;
+}
+
+static TextLayout &getTextLayout(TTF_Font *font, const char *str)
+{
+	TextLayout &layout = shState->textLayoutCache().get(font, str);
+
+	if (!layout.prepared)
+	{
+		layout.text = fixupString(str);
+		layout.allSpace = is_all_space(layout.text);
+		layout.prepared = true;
+	}
+
+	return layout;
+}
+
+/* Draws the text from the glyph cache in one GPU pass.
+ * Returns false if the string can't be drawn that way */
+static bool drawTextCached(BitmapPrivate *p, const IntRect &rect,
+                           TTF_Font *font, TextLayout &layout, int align)
+{
+	if (layout.glyphState == TextLayout::GlyphsUnknown)
+		layout.glyphState = decodeUcs2(layout.text.c_str(), layout.chars) ?
+			TextLayout::GlyphsDecoded : TextLayout::GlyphsUnsupported;
+
+	if (layout.glyphState == TextLayout::GlyphsUnsupported)
+		return false;
+
+	const Color &fontColor = p->font->getColor();
+	const Color &outColor = p->font->getOutColor();
+
+	/* Like the surface path, layers are drawn opaque
+	 * and the font alpha applied when blitting */
+	Vec4 color = fontColor.norm;
+	color.w = 1;
+
+	Vec4 outlineColor = outColor.norm;
+	outlineColor.w = 1;
+
+	float txtAlpha = fontColor.norm.w;
+
+	GlyphCache &cache = shState->glyphCache();
+	GlyphCache::TextRun run;
+
+	if (!cache.render(font, layout, color, outlineColor,
+	                  p->font->getOutline(), p->font->getShadow(), run))
+		return false;
+
+	/* Nothing but glyphs missing from the font */
+	if (run.width == 0)
+		return true;
+
+	TEXFBO &txtTex = cache.target();
+
+	int alignX = rect.x;
+
+	switch (align)
+	{
+	default:
+	case Bitmap::Left :
+		break;
+
+	case Bitmap::Center :
+		alignX += (rect.w - run.width) / 2;
+		break;
+
+	case Bitmap::Right :
+		alignX += rect.w - run.width;
+		break;
+	}
+
+	if (alignX < rect.x)
+		alignX = rect.x;
+
+	int alignY = rect.y + (rect.h - run.lineHeight) / 2;
+
+	float squeeze = (float) rect.w / run.width;
+
+	if (squeeze > 1)
+		squeeze = 1;
+
+	FloatRect posRect(alignX, alignY, run.width * squeeze, run.height);
+
+	/* Aquire a partial copy of the destination
+	 * buffer we're about to render to */
+	TEXFBO &gpTex2 = shState->gpTexFBO(posRect.w, posRect.h);
+
+	GLMeta::blitBegin(gpTex2);
+	GLMeta::blitSource(p->gl);
+	GLMeta::blitRectangle(posRect, Vec2i());
+	GLMeta::blitEnd();
+
+	FloatRect bltRect(0, 0,
+	                  (float) (txtTex.width * squeeze) / gpTex2.width,
+	                  (float) txtTex.height / gpTex2.height);
+
+	TextBltShader &shader = shState->shaders().textBlt;
+	shader.bind();
+	shader.setTexSize(Vec2i(txtTex.width, txtTex.height));
+	shader.setSource();
+	shader.setDestination(gpTex2.tex);
+	shader.setSubRect(bltRect);
+	shader.setOpacity(txtAlpha);
+
+	TEX::bind(txtTex.tex);
+	TEX::setSmooth(true);
+
+	Quad &quad = shState->gpQuad();
+	quad.setTexRect(FloatRect(0, 0, run.width, run.height));
+	quad.setPosRect(posRect);
+
+	p->bindFBO();
+	p->pushSetViewport(shader);
+
+	p->blitQuad(quad);
+
+	p->popViewport();
+
+	p->addTaintedArea(posRect);
+	p->onModified(posRect);
+
+	return true;
+}
+
 void Bitmap::drawText(const IntRect &rect, const char *str, int align)
 {
 	guardDisposed();
 
-	GUARD_MEGA;
-
-	std::string fixed = fixupString(str);
-	str = fixed.c_str();
+	/* The tiles share our font */
+	if (p->isMega())
+	{
+		p->forMegaTiles(rect, [&](Bitmap &tile, const IntRect &tileRect)
+		{
+			tile.drawText(toTile(rect, tileRect), str, align);
+		});
 
-	if (is_all_space(fixed))
+		p->megaModified();
 		return;
+	}
+
+	p->makeWritable();
+	p->flushWrites();
 
 	TTF_Font *font = p->font->getSdlFont();
+	TextLayout &layout = getTextLayout(font, str);
+
+	if (layout.allSpace)
+		return;
+
+	if (shState->config().glyphCache &&
+	    drawTextCached(p, rect, font, layout, align))
+		return;
+
+	str = layout.text.c_str();
+
 	const Color &fontColor = p->font->getColor();
 	const Color &outColor = p->font->getOutColor();
 
@@ -1245,7 +2394,7 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
 	SDL_FreeSurface(txtSurf);
 	p->addTaintedArea(posRect);
 
-	p->onModified();
+	p->onModified(posRect);
 }
 
 /* http://www.lemoda.net/c/utf8-to-ucs2/index.html */
@@ -1296,12 +2445,13 @@ IntRect Bitmap::textSize(const char *str)
 {
 	guardDisposed();
 
-	GUARD_MEGA;
-
 	TTF_Font *font = p->font->getSdlFont();
+	TextLayout &layout = getTextLayout(font, str);
 
-	std::string fixed = fixupString(str);
-	str = fixed.c_str();
+	if (layout.width >= 0)
+		return IntRect(0, 0, layout.width, layout.height);
+
+	str = layout.text.c_str();
 
 	int w, h;
 	TTF_SizeUTF8(font, str, &w, &h);
@@ -1315,6 +2465,9 @@ IntRect Bitmap::textSize(const char *str)
 	if (p->font->getItalic() && *endPtr == '\0')
 		TTF_GlyphMetrics(font, ucs2, 0, 0, 0, 0, &w);
 
+	layout.width = w;
+	layout.height = h;
+
 	return IntRect(0, 0, w, h);
 }
 
@@ -1328,16 +2481,60 @@ void Bitmap::setFont(Font &value)
 void Bitmap::setInitFont(Font *value)
 {
 	p->font = value;
+
+	for (size_t i = 0; i < p->megaTiles.size(); ++i)
+		p->megaTiles[i].bitmap->setInitFont(value);
+}
+
+void Bitmap::beginBatch()
+{
+	guardDisposed();
+
+	for (size_t i = 0; i < p->megaTiles.size(); ++i)
+		p->megaTiles[i].bitmap->beginBatch();
+
+	++p->batchDepth;
+}
+
+void Bitmap::endBatch()
+{
+	/* Might have been disposed during the batch */
+	if (isDisposed() || p->batchDepth == 0)
+		return;
+
+	for (size_t i = 0; i < p->megaTiles.size(); ++i)
+		p->megaTiles[i].bitmap->endBatch();
+
+	if (--p->batchDepth == 0)
+		p->flushWrites();
 }
 
 TEXFBO &Bitmap::getGLTypes()
 {
+	p->makeWritable();
+	p->flushWrites();
+
 	return p->gl;
 }
 
-SDL_Surface *Bitmap::megaSurface() const
+bool Bitmap::isMega() const
 {
-	return p->megaSurface;
+	return p->isMega();
+}
+
+size_t Bitmap::megaTileCount() const
+{
+	return p->megaTiles.size();
+}
+
+Bitmap &Bitmap::megaTile(size_t i) const
+{
+	return *p->megaTiles[i].bitmap;
+}
+
+IntRect Bitmap::megaTileRect(size_t i) const
+{
+	return p->megaTiles[i].rect;
 }
 
 void Bitmap::ensureNonMega() const
@@ -1353,6 +2550,16 @@ void Bitmap::bindTex(ShaderBase &shader)
 	p->bindTexture(shader);
 }
 
+const TEXFBO &Bitmap::backingTex() const
+{
+	return p->backingTex();
+}
+
+Vec2i Bitmap::texOrigin() const
+{
+	return p->texOrigin();
+}
+
 void Bitmap::taintArea(const IntRect &rect)
 {
 	p->addTaintedArea(rect);
@@ -1360,10 +2567,14 @@ void Bitmap::taintArea(const IntRect &rect)
 
 void Bitmap::releaseResources()
 {
-	if (p->megaSurface)
-		SDL_FreeSurface(p->megaSurface);
+	shState->markDirty();
+
+	if (p->isMega())
+		p->finiMega();
+	else if (p->atlas.valid())
+		shState->bitmapAtlas().release(p->atlas);
 	else
-		shState->texPool().release(p->gl);
+		p->releaseTex();
 
 	delete p;
 }
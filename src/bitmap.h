@@ -31,7 +31,6 @@
 class Font;
 class ShaderBase;
 struct TEXFBO;
-struct SDL_Surface;
 
 struct BitmapPrivate;
 // FIXME make this class use proper RGSS classes again
@@ -40,10 +39,15 @@ class Bitmap : public Disposable
 public:
 	Bitmap(const char *filename);
 	Bitmap(int width, int height);
-	/* Clone constructor */
+	/* Clone constructor. The clone shares the texture of 'other'
+	 * until either of them is modified */
 	Bitmap(const Bitmap &other);
 	~Bitmap();
 
+	/* Starts decoding 'filename' in the background, so that
+	 * creating a Bitmap from it later only has to upload it */
+	static void preload(const char *filename);
+
 	int width()  const;
 	int height() const;
 	IntRect rect() const;
@@ -81,8 +85,31 @@ public:
 	Color getPixel(int x, int y) const;
 	void setPixel(int x, int y, const Color &color);
 
+	/* Starts reading back 'rect' ahead of getPixel() calls
+	 * (asynchronously where supported), so they don't
+	 * have to stall on the GPU later */
+	void prefetchPixels(int x, int y, int width, int height);
+	void prefetchPixels(const IntRect &rect);
+
+	/* Bulk pixel transfer; 'data' holds 'rect' as packed
+	 * RGBA8 rows, top to bottom (rect.w * rect.h * 4 bytes).
+	 * 'rect' must lie fully inside the bitmap */
+	void readRect(const IntRect &rect, void *data) const;
+	void writeRect(const IntRect &rect, const void *data);
+
+	/* Throws if 'rect' isn't valid for the above, so callers
+	 * can check it before allocating a buffer for it */
+	void checkTransferRect(const IntRect &rect) const;
+
 	void hueChange(int hue);
 
+	/* Until the matching endBatch(), blits from other bitmaps
+	 * are recorded along with fills and gradients, and drawn
+	 * in as few passes as possible at the end. Other operations
+	 * draw whatever was recorded first. Batches can nest */
+	void beginBatch();
+	void endBatch();
+
 	enum TextAlign
 	{
 		Left = 0,
@@ -106,14 +133,33 @@ public:
 	void setInitFont(Font *value);
 
 	/* <internal> */
+	/* Gives the bitmap a texture of its own if necessary
+	 * (moving it out of the atlas, or copying a texture
+	 * shared with clones) */
 	TEXFBO &getGLTypes();
-	SDL_Surface *megaSurface() const;
+
+	/* Mega bitmaps (larger than the maximum texture size) are
+	 * split into a grid of regular bitmaps. Their own GL types
+	 * are empty; anything drawing them has to go through
+	 * the tiles instead */
+	bool isMega() const;
+	size_t megaTileCount() const;
+	Bitmap &megaTile(size_t i) const;
+	IntRect megaTileRect(size_t i) const;
 	void ensureNonMega() const;
 
 	/* Binds the backing texture and sets the correct
 	 * texture size uniform in shader */
 	void bindTex(ShaderBase &shader);
 
+	/* The texture bindTex() binds, and the offset of the
+	 * bitmap's pixels inside of it. Atlased bitmaps share
+	 * their page's texture with other bitmaps. Pending writes
+	 * are drawn first; use this over getGLTypes() when only
+	 * reading, so the texture can stay shared */
+	const TEXFBO &backingTex() const;
+	Vec2i texOrigin() const;
+
 	/* Adds 'rect' to tainted area */
 	void taintArea(const IntRect &rect);
 
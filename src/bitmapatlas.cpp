@@ -0,0 +1,165 @@
+/*
+** bitmapatlas.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bitmapatlas.h"
+
+#include "config.h"
+#include "sharedstate.h"
+#include "glstate.h"
+
+#include <algorithm>
+
+#define PAGE_SIZE 1024
+
+/* Transparent gap kept to the right and below each region
+ * so sampling at a region's edge never picks up a neighbour */
+#define PADDING 1
+
+BitmapAtlas::BitmapAtlas(const Config &conf, int maxTexSize)
+{
+	pageSize = std::min<int>(PAGE_SIZE, maxTexSize);
+	maxBitmapSize = std::min<int>(conf.bitmapAtlas, pageSize - PADDING);
+}
+
+BitmapAtlas::~BitmapAtlas()
+{
+	for (size_t i = 0; i < pages.size(); ++i)
+	{
+		TEXFBO::fini(pages[i]->tex);
+		delete pages[i];
+	}
+}
+
+bool BitmapAtlas::allocate(int width, int height, Region &out)
+{
+	if (width > maxBitmapSize || height > maxBitmapSize)
+		return false;
+
+	const int cellW = width + PADDING;
+	const int cellH = height + PADDING;
+
+	size_t i;
+
+	for (i = 0; i < pages.size(); ++i)
+		if (allocateIn(*pages[i], cellW, cellH, out.rect))
+			break;
+
+	if (i == pages.size())
+	{
+		pages.push_back(newPage());
+		allocateIn(*pages.back(), cellW, cellH, out.rect);
+	}
+
+	++pages[i]->regions;
+
+	out.page = i;
+	out.rect.w = width;
+	out.rect.h = height;
+
+	return true;
+}
+
+void BitmapAtlas::release(Region &region)
+{
+	if (!region.valid())
+		return;
+
+	Page &page = *pages[region.page];
+
+	if (--page.regions == 0)
+		clearPage(page);
+
+	region = Region();
+}
+
+void BitmapAtlas::retain(const Region &region)
+{
+	if (!region.valid())
+		return;
+
+	++pages[region.page]->regions;
+}
+
+TEXFBO &BitmapAtlas::page(const Region &region)
+{
+	return pages[region.page]->tex;
+}
+
+bool BitmapAtlas::allocateIn(Page &page, int cellW, int cellH, IntRect &out)
+{
+	Shelf *best = 0;
+
+	/* Pick the shelf that wastes the least height */
+	for (size_t i = 0; i < page.shelves.size(); ++i)
+	{
+		Shelf &shelf = page.shelves[i];
+
+		if (shelf.h < cellH || pageSize - shelf.x < cellW)
+			continue;
+
+		if (!best || shelf.h < best->h)
+			best = &shelf;
+	}
+
+	if (!best)
+	{
+		if (pageSize - page.top < cellH)
+			return false;
+
+		Shelf shelf = { page.top, cellH, 0 };
+		page.shelves.push_back(shelf);
+		page.top += cellH;
+
+		best = &page.shelves.back();
+	}
+
+	out.x = best->x;
+	out.y = best->y;
+	best->x += cellW;
+
+	return true;
+}
+
+BitmapAtlas::Page *BitmapAtlas::newPage()
+{
+	Page *page = new Page;
+
+	TEXFBO::init(page->tex);
+	TEXFBO::allocEmpty(page->tex, pageSize, pageSize, VRAM::Bitmaps);
+	TEXFBO::linkFBO(page->tex);
+
+	clearPage(*page);
+
+	return page;
+}
+
+void BitmapAtlas::clearPage(Page &page)
+{
+	page.shelves.clear();
+	page.top = 0;
+	page.regions = 0;
+
+	FBO::bind(page.tex.fbo);
+
+	glState.clearColor.pushSet(Vec4());
+	FBO::clear();
+	glState.clearColor.pop();
+}
@@ -0,0 +1,96 @@
+/*
+** bitmapatlas.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BITMAPATLAS_H
+#define BITMAPATLAS_H
+
+#include "gl-util.h"
+#include "etc-internal.h"
+
+#include <vector>
+
+struct Config;
+
+/* Packs small, read-mostly bitmaps into shared texture pages
+ * (shelf packing), so elements drawing different bitmaps can
+ * still share texture binds and batched draw calls.
+ * Regions are never reused individually; a page is wiped
+ * and starts over once its last region is released */
+class BitmapAtlas
+{
+public:
+	struct Region
+	{
+		int page;
+		IntRect rect;
+
+		Region()
+		    : page(-1)
+		{}
+
+		bool valid() const
+		{
+			return page >= 0;
+		}
+	};
+
+	BitmapAtlas(const Config &conf, int maxTexSize);
+	~BitmapAtlas();
+
+	/* Returns false if the atlas is disabled or
+	 * the bitmap is too large to be placed in it */
+	bool allocate(int width, int height, Region &out);
+	void release(Region &region);
+
+	/* Keeps the page of 'region' from being wiped until
+	 * a copy of 'region' is released as well */
+	void retain(const Region &region);
+
+	TEXFBO &page(const Region &region);
+
+private:
+	struct Shelf
+	{
+		int y, h;
+		/* Start of the free space */
+		int x;
+	};
+
+	struct Page
+	{
+		TEXFBO tex;
+		std::vector<Shelf> shelves;
+		/* Start of the unshelved space */
+		int top;
+		size_t regions;
+	};
+
+	bool allocateIn(Page &page, int cellW, int cellH, IntRect &out);
+	Page *newPage();
+	void clearPage(Page &page);
+
+	std::vector<Page*> pages;
+
+	int maxBitmapSize;
+	int pageSize;
+};
+
+#endif // BITMAPATLAS_H
@@ -78,6 +78,18 @@ public:
 		return iter->second;
 	}
 
+	/* Returns null if 'key' isn't contained. Unlike value(),
+	 * doesn't copy; unlike operator[], doesn't insert */
+	inline const V *find(const K &key) const
+	{
+		const_iterator iter = p.find(key);
+
+		if (iter == p.cend())
+			return 0;
+
+		return &iter->second;
+	}
+
 	inline V &operator[](const K &key)
 	{
 		return p[key];
@@ -155,12 +155,15 @@ void Config::read(int argc, char *argv[])
 	PO_DESC(rgssVersion, int, 0) \
 	PO_DESC(debugMode, bool, false) \
 	PO_DESC(printFPS, bool, false) \
+	PO_DESC(traceFile, std::string, "") \
 	PO_DESC(muteAudio, bool, false) \
 	PO_DESC(winResizable, bool, false) \
 	PO_DESC(fullscreen, bool, false) \
 	PO_DESC(fixedAspectRatio, bool, true) \
 	PO_DESC(smoothScaling, bool, true) \
 	PO_DESC(vsync, bool, false) \
+	PO_DESC(headless, bool, false) \
+	PO_DESC(threadedPresent, bool, false) \
 	PO_DESC(defScreenW, int, 0) \
 	PO_DESC(defScreenH, int, 0) \
 	PO_DESC(windowTitle, std::string, "") \
@@ -168,9 +171,19 @@ void Config::read(int argc, char *argv[])
 	PO_DESC(frameSkip, bool, true) \
 	PO_DESC(syncToRefreshrate, bool, false) \
 	PO_DESC(solidFonts, bool, false) \
+	PO_DESC(glyphCache, bool, true) \
+	PO_DESC(textLayoutCache, int, 512) \
 	PO_DESC(subImageFix, bool, false) \
 	PO_DESC(enableBlitting, bool, true) \
 	PO_DESC(maxTextureSize, int, 0) \
+	PO_DESC(bitmapAtlas, int, 0) \
+	PO_DESC(texturePoolSize, int, 20) \
+	PO_DESC(texturePoolSizeClasses, bool, false) \
+	PO_DESC(vramBudget, int, 0) \
+	PO_DESC(staticTilemapSize, int, 0) \
+	PO_DESC(preloadThreads, int, 2) \
+	PO_DESC(preloadBudget, int, 64) \
+	PO_DESC(imageCache, std::string, "") \
 	PO_DESC(gameFolder, std::string, ".") \
 	PO_DESC(anyAltToggleFS, bool, false) \
 	PO_DESC(enableReset, bool, true) \
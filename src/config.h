@@ -32,6 +32,7 @@ struct Config
 
 	bool debugMode;
 	bool printFPS;
+	std::string traceFile;
 
 	bool muteAudio;
 
@@ -40,6 +41,8 @@ struct Config
 	bool fixedAspectRatio;
 	bool smoothScaling;
 	bool vsync;
+	bool headless;
+	bool threadedPresent;
 
 	int defScreenW;
 	int defScreenH;
@@ -50,10 +53,20 @@ struct Config
 	bool syncToRefreshrate;
 
 	bool solidFonts;
+	bool glyphCache;
+	int textLayoutCache;
 
 	bool subImageFix;
 	bool enableBlitting;
 	int maxTextureSize;
+	int bitmapAtlas;
+	int texturePoolSize;
+	bool texturePoolSizeClasses;
+	int vramBudget;
+	int staticTilemapSize;
+	int preloadThreads;
+	int preloadBudget;
+	std::string imageCache;
 
 	std::string gameFolder;
 	bool anyAltToggleFS;
@@ -23,10 +23,19 @@
 
 #include "serial-util.h"
 #include "exception.h"
+#include "sharedstate.h"
 
 #include <SDL_types.h>
 #include <SDL_pixels.h>
 
+/* Color, Tone and Rect values feed directly into rendering;
+ * they can however also change before the shared state exists */
+static void markDirty()
+{
+	if (shState)
+		shState->markDirty();
+}
+
 Color::Color(double red, double green, double blue, double alpha)
 	: red(red), green(green), blue(blue), alpha(alpha)
 {
@@ -71,30 +80,39 @@ void Color::set(double red, double green, double blue, double alpha)
 	this->alpha = alpha;
 
 	updateInternal();
+	markDirty();
 }
 
 void Color::setRed(double value)
 {
 	red = value;
 	norm.x = clamp<double>(value, 0, 255) / 255;
+
+	markDirty();
 }
 
 void Color::setGreen(double value)
 {
 	green = value;
 	norm.y = clamp<double>(value, 0, 255) / 255;
+
+	markDirty();
 }
 
 void Color::setBlue(double value)
 {
 	blue = value;
 	norm.z = clamp<double>(value, 0, 255) / 255;
+
+	markDirty();
 }
 
 void Color::setAlpha(double value)
 {
 	alpha = value;
 	norm.w = clamp<double>(value, 0, 255) / 255;
+
+	markDirty();
 }
 
 /* Serializable */
@@ -183,6 +201,7 @@ void Tone::set(double red, double green, double blue, double gray)
 
 	updateInternal();
 	valueChanged();
+	markDirty();
 }
 
 const Tone& Tone::operator=(const Tone &o)
@@ -194,6 +213,7 @@ const Tone& Tone::operator=(const Tone &o)
 	norm  = o.norm;
 
 	valueChanged();
+	markDirty();
 
 	return o;
 }
@@ -204,6 +224,7 @@ void Tone::setRed(double value)
 	norm.x = (float) clamp<double>(value, -255, 255) / 255;
 
 	valueChanged();
+	markDirty();
 }
 
 void Tone::setGreen(double value)
@@ -212,6 +233,7 @@ void Tone::setGreen(double value)
 	norm.y = (float) clamp<double>(value, -255, 255) / 255;
 
 	valueChanged();
+	markDirty();
 }
 
 void Tone::setBlue(double value)
@@ -220,6 +242,7 @@ void Tone::setBlue(double value)
 	norm.z = (float) clamp<double>(value, -255, 255) / 255;
 
 	valueChanged();
+	markDirty();
 }
 
 void Tone::setGray(double value)
@@ -228,6 +251,7 @@ void Tone::setGray(double value)
 	norm.w = (float) clamp<double>(value, 0, 255) / 255;
 
 	valueChanged();
+	markDirty();
 }
 
 /* Serializable */
@@ -313,6 +337,7 @@ void Rect::set(int x, int y, int w, int h)
 	width = w;
 	height = h;
 	valueChanged();
+	markDirty();
 }
 
 const Rect &Rect::operator=(const Rect &o)
@@ -323,6 +348,7 @@ const Rect &Rect::operator=(const Rect &o)
 	height = o.height;
 
 	valueChanged();
+	markDirty();
 
 	return o;
 }
@@ -334,6 +360,7 @@ void Rect::empty()
 
 	x = y = width = height = 0;
 	valueChanged();
+	markDirty();
 }
 
 bool Rect::isEmpty() const
@@ -348,6 +375,7 @@ void Rect::setX(int value)
 
 	x = value;
 	valueChanged();
+	markDirty();
 }
 
 void Rect::setY(int value)
@@ -357,6 +385,7 @@ void Rect::setY(int value)
 
 	y = value;
 	valueChanged();
+	markDirty();
 }
 
 void Rect::setWidth(int value)
@@ -366,6 +395,7 @@ void Rect::setWidth(int value)
 
 	width = value;
 	valueChanged();
+	markDirty();
 }
 
 void Rect::setHeight(int value)
@@ -375,6 +405,7 @@ void Rect::setHeight(int value)
 
 	height = value;
 	valueChanged();
+	markDirty();
 }
 
 int Rect::serialSize() const
@@ -603,9 +603,15 @@ openReadEnumCB(void *d, const char *dirpath, const char *filename)
 		return PHYSFS_ENUM_STOP;
 
 	/* If the path cache is active, translate from lower case
-	 * to mixed case path */
+	 * to mixed case path. The cache is only read from here, as
+	 * image preloading calls this from worker threads too */
 	if (data.pathTrans)
-		fullPath = (*data.pathTrans)[fullPath].c_str();
+	{
+		const std::string *mixedCase = data.pathTrans->find(fullPath);
+
+		if (mixedCase)
+			fullPath = mixedCase->c_str();
+	}
 
 	PHYSFS_File *phys = PHYSFS_openRead(fullPath);
 
@@ -666,11 +672,13 @@ void FileSystem::openRead(OpenHandler &handler, const char *filename)
 	if (p->havePathCache)
 	{
 		/* Get the list of files contained in this directory
-		 * and manually iterate over them */
-		const std::vector<std::string> &fileList = p->fileLists[dir];
+		 * and manually iterate over them (without inserting
+		 * unknown directories, see openReadEnumCB) */
+		const std::vector<std::string> *fileList = p->fileLists.find(dir);
 
-		for (size_t i = 0; i < fileList.size(); ++i)
-			openReadEnumCB(&data, dir, fileList[i].c_str());
+		if (fileList)
+			for (size_t i = 0; i < fileList->size(); ++i)
+				openReadEnumCB(&data, dir, (*fileList)[i].c_str());
 	}
 	else
 	{
@@ -56,6 +56,8 @@ public:
 		virtual bool tryRead(SDL_RWops &ops, const char *ext) = 0;
 	};
 
+	/* Safe to call from several threads at once
+	 * (the path cache is read-only after startup) */
 	void openRead(OpenHandler &handler,
 	              const char *filename);
 
@@ -24,6 +24,7 @@
 
 #include "etc.h"
 #include "etc-internal.h"
+#include "sharedstate.h"
 
 class Flashable
 {
@@ -45,6 +46,8 @@ public:
 		this->duration = duration;
 		counter = 0;
 
+		shState->markDirty();
+
 		if (!color)
 		{
 			emptyFlashFlag = true;
@@ -60,6 +63,8 @@ public:
 		if (!flashing)
 			return;
 
+		shState->markDirty();
+
 		if (++counter > duration)
 		{
 			/* Flash finished. Cleanup */
@@ -0,0 +1,312 @@
+/*
+** frametrace.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "frametrace.h"
+
+#include "config.h"
+#include "gl-fun.h"
+#include "debugwriter.h"
+
+#include <SDL_timer.h>
+
+#include <stdio.h>
+#include <deque>
+#include <vector>
+
+/* GPU timestamps become available a few frames late; beyond
+ * this many frames in flight we block on the oldest one */
+#define MAX_PENDING_FRAMES 4
+
+/* Track IDs in the trace */
+#define TID_CPU 1
+#define TID_GPU 2
+
+struct TraceEvent
+{
+	const char *name;
+	const char *argName;
+	int arg;
+
+	uint64_t cpuBegin;
+	uint64_t cpuEnd;
+
+	/* Timestamp queries (0 without GPU timing) */
+	GLuint gpuBegin;
+	GLuint gpuEnd;
+};
+
+struct TraceFrame
+{
+	unsigned int index;
+
+	uint64_t cpuBegin;
+	uint64_t cpuEnd;
+
+	std::vector<TraceEvent> events;
+
+	/* The last query issued in this frame; once it is
+	 * available, all others are as well */
+	GLuint lastQuery;
+};
+
+struct FrameTracePrivate
+{
+	FILE *f;
+	bool firstEvent;
+
+	bool gpuTiming;
+
+	uint64_t tickBase;
+	double ticksPerUS;
+	int64_t gpuBase;
+
+	TraceFrame current;
+	std::vector<size_t> openScopes;
+
+	std::deque<TraceFrame> pending;
+	std::vector<GLuint> freeQueries;
+
+	FrameTracePrivate(FILE *f)
+	    : f(f),
+	      firstEvent(true),
+	      gpuTiming(gl.QueryCounter != 0 && gl.GetInteger64v != 0),
+	      tickBase(SDL_GetPerformanceCounter()),
+	      ticksPerUS(SDL_GetPerformanceFrequency() / 1000000.0),
+	      gpuBase(0)
+	{
+		/* Align the GPU clock with our CPU time base */
+		if (gpuTiming)
+			gl.GetInteger64v(GL_TIMESTAMP, &gpuBase);
+
+		fputs("[\n", f);
+
+		writeThreadName(TID_CPU, "CPU");
+
+		if (gpuTiming)
+			writeThreadName(TID_GPU, "GPU");
+
+		current.index = 0;
+		current.cpuBegin = tickBase;
+		current.lastQuery = 0;
+	}
+
+	~FrameTracePrivate()
+	{
+		flush(true);
+
+		if (!freeQueries.empty())
+			gl.DeleteQueries(freeQueries.size(), &freeQueries[0]);
+
+		fputs("\n]\n", f);
+		fclose(f);
+	}
+
+	GLuint timestamp()
+	{
+		GLuint query;
+
+		if (freeQueries.empty())
+		{
+			gl.GenQueries(1, &query);
+		}
+		else
+		{
+			query = freeQueries.back();
+			freeQueries.pop_back();
+		}
+
+		gl.QueryCounter(query, GL_TIMESTAMP);
+		current.lastQuery = query;
+
+		return query;
+	}
+
+	/* Blocks until the query result is available */
+	double gpuUS(GLuint query)
+	{
+		uint64_t value;
+		gl.GetQueryObjectui64v(query, GL_QUERY_RESULT, &value);
+		freeQueries.push_back(query);
+
+		return ((int64_t) value - gpuBase) / 1000.0;
+	}
+
+	double cpuUS(uint64_t ticks) const
+	{
+		return (int64_t) (ticks - tickBase) / ticksPerUS;
+	}
+
+	void beginEvent()
+	{
+		fputs(firstEvent ? "" : ",\n", f);
+		firstEvent = false;
+	}
+
+	void writeThreadName(int tid, const char *name)
+	{
+		beginEvent();
+		fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+		           "\"args\":{\"name\":\"%s\"}}", tid, name);
+	}
+
+	void writeEvent(int tid, const char *name, double begin, double end,
+	                const char *argName, int arg)
+	{
+		beginEvent();
+		fprintf(f, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+		           "\"ts\":%.3f,\"dur\":%.3f", name, tid, begin, end - begin);
+
+		if (argName)
+			fprintf(f, ",\"args\":{\"%s\":%d}", argName, arg);
+
+		fputs("}", f);
+	}
+
+	bool frameReady(const TraceFrame &frame) const
+	{
+		if (!frame.lastQuery)
+			return true;
+
+		GLint available = 0;
+		gl.GetQueryObjectiv(frame.lastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+
+		return available != 0;
+	}
+
+	void writeFrame(const TraceFrame &frame)
+	{
+		writeEvent(TID_CPU, "Frame", cpuUS(frame.cpuBegin), cpuUS(frame.cpuEnd),
+		           "index", frame.index);
+
+		for (size_t i = 0; i < frame.events.size(); ++i)
+		{
+			const TraceEvent &e = frame.events[i];
+
+			writeEvent(TID_CPU, e.name, cpuUS(e.cpuBegin), cpuUS(e.cpuEnd),
+			           e.argName, e.arg);
+
+			if (!e.gpuBegin)
+				continue;
+
+			double begin = gpuUS(e.gpuBegin);
+			double end = gpuUS(e.gpuEnd);
+
+			writeEvent(TID_GPU, e.name, begin, end, e.argName, e.arg);
+		}
+	}
+
+	void flush(bool wait)
+	{
+		while (!pending.empty())
+		{
+			if (!wait && !frameReady(pending.front()))
+				break;
+
+			writeFrame(pending.front());
+			pending.pop_front();
+		}
+	}
+};
+
+FrameTrace::FrameTrace(const Config &conf)
+    : p(0)
+{
+	if (conf.traceFile.empty())
+		return;
+
+	FILE *f = fopen(conf.traceFile.c_str(), "wb");
+
+	if (!f)
+	{
+		Debug() << "Unable to open trace file" << conf.traceFile;
+		return;
+	}
+
+	p = new FrameTracePrivate(f);
+
+	Debug() << "Writing frame trace to" << conf.traceFile
+	        << (p->gpuTiming ? "(with GPU timing)" : "(CPU timing only)");
+}
+
+FrameTrace::~FrameTrace()
+{
+	delete p;
+}
+
+void FrameTrace::beginScope(const char *name, const char *argName, int arg)
+{
+	TraceEvent e;
+	e.name = name;
+	e.argName = argName;
+	e.arg = arg;
+	e.cpuBegin = SDL_GetPerformanceCounter();
+	e.cpuEnd = e.cpuBegin;
+	e.gpuBegin = p->gpuTiming ? p->timestamp() : 0;
+	e.gpuEnd = 0;
+
+	p->openScopes.push_back(p->current.events.size());
+	p->current.events.push_back(e);
+}
+
+void FrameTrace::endScope()
+{
+	if (p->openScopes.empty())
+		return;
+
+	TraceEvent &e = p->current.events[p->openScopes.back()];
+	p->openScopes.pop_back();
+
+	if (p->gpuTiming)
+		e.gpuEnd = p->timestamp();
+
+	e.cpuEnd = SDL_GetPerformanceCounter();
+}
+
+void FrameTrace::endFrame()
+{
+	/* Scopes can't span frames */
+	while (!p->openScopes.empty())
+		endScope();
+
+	TraceFrame &cur = p->current;
+	cur.cpuEnd = SDL_GetPerformanceCounter();
+
+	p->pending.push_back(TraceFrame());
+	TraceFrame &frame = p->pending.back();
+
+	frame.index = cur.index;
+	frame.cpuBegin = cur.cpuBegin;
+	frame.cpuEnd = cur.cpuEnd;
+	frame.lastQuery = cur.lastQuery;
+	frame.events.swap(cur.events);
+
+	cur.index++;
+	cur.cpuBegin = cur.cpuEnd;
+	cur.lastQuery = 0;
+
+	p->flush(false);
+
+	while (p->pending.size() > MAX_PENDING_FRAMES)
+	{
+		p->writeFrame(p->pending.front());
+		p->pending.pop_front();
+	}
+}
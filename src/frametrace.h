@@ -0,0 +1,77 @@
+/*
+** frametrace.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FRAMETRACE_H
+#define FRAMETRACE_H
+
+struct FrameTracePrivate;
+struct Config;
+
+/* Records the duration of named scopes per frame and streams
+ * them into a Chrome trace (JSON) file, viewable in
+ * chrome://tracing or Perfetto. CPU durations are always
+ * recorded; if the GL supports timer queries, the GPU
+ * duration of each scope is recorded on a separate track.
+ * Does nothing unless a trace file is configured */
+class FrameTrace
+{
+public:
+	FrameTrace(const Config &conf);
+	~FrameTrace();
+
+	bool isEnabled() const
+	{
+		return p != 0;
+	}
+
+	/* 'name' and 'argName' must be string literals */
+	void beginScope(const char *name, const char *argName = 0, int arg = 0);
+	void endScope();
+
+	/* Closes the current frame. Called once per
+	 * frame after it has been presented */
+	void endFrame();
+
+private:
+	FrameTracePrivate *p;
+};
+
+struct TraceScope
+{
+	TraceScope(FrameTrace &trace, const char *name,
+	           const char *argName = 0, int arg = 0)
+	    : trace(trace.isEnabled() ? &trace : 0)
+	{
+		if (this->trace)
+			this->trace->beginScope(name, argName, arg);
+	}
+
+	~TraceScope()
+	{
+		if (trace)
+			trace->endScope();
+	}
+
+private:
+	FrameTrace *trace;
+};
+
+#endif // FRAMETRACE_H
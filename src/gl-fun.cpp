@@ -97,6 +97,7 @@ void initGLFunctions()
 
 	/* Assume single digit */
 	int glMajor = *ver - '0';
+	int glMinor = (ver[1] == '.') ? ver[2] - '0' : 0;
 
 	if (glMajor < 2)
 		throw EXC("At least OpenGL (ES) 2.0 is required");
@@ -163,6 +164,57 @@ void initGLFunctions()
 		GL_VAO_FUN;
 	}
 
+	/* Timer query entrypoints */
+	if (HAVE_EXT(ARB_timer_query) || (!gles && glMajor >= 4))
+	{
+#undef EXT_SUFFIX
+#define EXT_SUFFIX ""
+		GL_TIMER_QUERY_FUN;
+	}
+	else if (HAVE_EXT(EXT_disjoint_timer_query))
+	{
+#undef EXT_SUFFIX
+#define EXT_SUFFIX "EXT"
+		GL_TIMER_QUERY_FUN;
+	}
+
+	/* Not part of ARB_timer_query, but needed
+	 * to read the current GPU time with it */
+	if (gles ? glMajor >= 3 : (glMajor > 3 || (glMajor == 3 && glMinor >= 2) || HAVE_EXT(ARB_sync)))
+	{
+#undef EXT_SUFFIX
+#define EXT_SUFFIX ""
+		GL_INTEGER64_FUN;
+	}
+	else if (HAVE_EXT(EXT_disjoint_timer_query))
+	{
+#undef EXT_SUFFIX
+#define EXT_SUFFIX "EXT"
+		GL_INTEGER64_FUN;
+	}
+
+	/* Sync object entrypoints */
+	if (HAVE_EXT(ARB_sync) || glMajor >= 4 || (gles && glMajor >= 3))
+	{
+#undef EXT_SUFFIX
+#define EXT_SUFFIX ""
+		GL_SYNC_FUN;
+	}
+	else if (HAVE_EXT(APPLE_sync))
+	{
+#undef EXT_SUFFIX
+#define EXT_SUFFIX "APPLE"
+		GL_SYNC_FUN;
+	}
+
+	/* Pixel buffer object entrypoints (asynchronous readback) */
+	if (!gles && (glMajor >= 3 || HAVE_EXT(ARB_pixel_buffer_object)))
+	{
+#undef EXT_SUFFIX
+#define EXT_SUFFIX ""
+		GL_PBO_FUN;
+	}
+
 	/* Debug callback entrypoints */
 	if (HAVE_EXT(KHR_debug))
 	{
@@ -29,10 +29,14 @@
 #include <SDL_opengl.h>
 #endif
 
+#include <stdint.h>
+
 /* Etc */
 typedef GLenum (APIENTRYP _PFNGLGETERRORPROC) (void);
 typedef void (APIENTRYP _PFNGLCLEARCOLORPROC) (GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha);
 typedef void (APIENTRYP _PFNGLCLEARPROC) (GLbitfield mask);
+typedef void (APIENTRYP _PFNGLFINISHPROC) (void);
+typedef void (APIENTRYP _PFNGLFLUSHPROC) (void);
 typedef const GLubyte * (APIENTRYP _PFNGLGETSTRINGPROC) (GLenum name);
 typedef void (APIENTRYP _PFNGLGETINTEGERVPROC) (GLenum pname, GLint *params);
 typedef void (APIENTRYP _PFNGLPIXELSTOREIPROC) (GLenum pname, GLint param);
@@ -110,9 +114,50 @@ typedef void (APIENTRYP _PFNGLGENVERTEXARRAYSPROC) (GLsizei n, GLuint* arrays);
 typedef void (APIENTRYP _PFNGLDELETEVERTEXARRAYSPROC) (GLsizei n, const GLuint* arrays);
 typedef void (APIENTRYP _PFNGLBINDVERTEXARRAYPROC) (GLuint array);
 
+/* Timer query */
+typedef void (APIENTRYP _PFNGLGENQUERIESPROC) (GLsizei n, GLuint *ids);
+typedef void (APIENTRYP _PFNGLDELETEQUERIESPROC) (GLsizei n, const GLuint *ids);
+typedef void (APIENTRYP _PFNGLQUERYCOUNTERPROC) (GLuint id, GLenum target);
+typedef void (APIENTRYP _PFNGLGETQUERYOBJECTIVPROC) (GLuint id, GLenum pname, GLint *params);
+typedef void (APIENTRYP _PFNGLGETQUERYOBJECTUI64VPROC) (GLuint id, GLenum pname, uint64_t *params);
+typedef void (APIENTRYP _PFNGLGETINTEGER64VPROC) (GLenum pname, int64_t *params);
+
+/* Sync object */
+typedef void * _GLsync;
+typedef _GLsync (APIENTRYP _PFNGLFENCESYNCPROC) (GLenum condition, GLbitfield flags);
+typedef void (APIENTRYP _PFNGLDELETESYNCPROC) (_GLsync sync);
+typedef void (APIENTRYP _PFNGLWAITSYNCPROC) (_GLsync sync, GLbitfield flags, uint64_t timeout);
+
+/* Pixel buffer object */
+typedef void * (APIENTRYP _PFNGLMAPBUFFERPROC) (GLenum target, GLenum access);
+typedef GLboolean (APIENTRYP _PFNGLUNMAPBUFFERPROC) (GLenum target);
+
 /* GLES only */
 typedef void (APIENTRYP _PFNGLRELEASESHADERCOMPILERPROC) (void);
 
+#ifndef GL_TIMESTAMP
+#define GL_TIMESTAMP 0x8E28
+#endif
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT 0x8866
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_TIMEOUT_IGNORED
+#define GL_TIMEOUT_IGNORED 0xFFFFFFFFFFFFFFFFull
+#endif
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_READ_ONLY
+#define GL_READ_ONLY 0x88B8
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+
 #ifdef GLES2_HEADER
 #define GL_NUM_EXTENSIONS 0x821D
 #define GL_READ_FRAMEBUFFER 0x8CA8
@@ -127,6 +172,8 @@ typedef void (APIENTRYP _PFNGLRELEASESHADERCOMPILERPROC) (void);
 	GL_FUN(GetError, _PFNGLGETERRORPROC) \
 	GL_FUN(ClearColor, _PFNGLCLEARCOLORPROC) \
 	GL_FUN(Clear, _PFNGLCLEARPROC) \
+	GL_FUN(Finish, _PFNGLFINISHPROC) \
+	GL_FUN(Flush, _PFNGLFLUSHPROC) \
 	GL_FUN(GetString, _PFNGLGETSTRINGPROC) \
 	GL_FUN(GetIntegerv, _PFNGLGETINTEGERVPROC) \
 	GL_FUN(PixelStorei, _PFNGLPIXELSTOREIPROC) \
@@ -200,6 +247,29 @@ typedef void (APIENTRYP _PFNGLRELEASESHADERCOMPILERPROC) (void);
 	GL_FUN(DeleteVertexArrays, _PFNGLDELETEVERTEXARRAYSPROC) \
 	GL_FUN(BindVertexArray, _PFNGLBINDVERTEXARRAYPROC)
 
+#define GL_TIMER_QUERY_FUN \
+	/* Timer query */ \
+	GL_FUN(GenQueries, _PFNGLGENQUERIESPROC) \
+	GL_FUN(DeleteQueries, _PFNGLDELETEQUERIESPROC) \
+	GL_FUN(QueryCounter, _PFNGLQUERYCOUNTERPROC) \
+	GL_FUN(GetQueryObjectiv, _PFNGLGETQUERYOBJECTIVPROC) \
+	GL_FUN(GetQueryObjectui64v, _PFNGLGETQUERYOBJECTUI64VPROC)
+
+#define GL_INTEGER64_FUN \
+	/* 64 bit state queries (GL 3.2 / ARB_sync) */ \
+	GL_FUN(GetInteger64v, _PFNGLGETINTEGER64VPROC)
+
+#define GL_SYNC_FUN \
+	/* Sync object */ \
+	GL_FUN(FenceSync, _PFNGLFENCESYNCPROC) \
+	GL_FUN(DeleteSync, _PFNGLDELETESYNCPROC) \
+	GL_FUN(WaitSync, _PFNGLWAITSYNCPROC)
+
+#define GL_PBO_FUN \
+	/* Pixel buffer object */ \
+	GL_FUN(MapBuffer, _PFNGLMAPBUFFERPROC) \
+	GL_FUN(UnmapBuffer, _PFNGLUNMAPBUFFERPROC)
+
 #define GL_DEBUG_KHR_FUN \
 	GL_FUN(DebugMessageCallback, _PFNGLDEBUGMESSAGECALLBACKPROC)
 
@@ -216,6 +286,10 @@ struct GLFunctions
 	GL_FBO_FUN
 	GL_FBO_BLIT_FUN
 	GL_VAO_FUN
+	GL_TIMER_QUERY_FUN
+	GL_INTEGER64_FUN
+	GL_SYNC_FUN
+	GL_PBO_FUN
 	GL_DEBUG_KHR_FUN
 	GL_GREMEMDY_FUN
 
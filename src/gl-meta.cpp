@@ -131,6 +131,21 @@ void vaoUnbind(VAO &vao)
 	}
 }
 
+void vaoSetBase(VAO &vao, size_t vertex)
+{
+	const size_t base = vertex * vao.vertSize;
+
+	VBO::bind(vao.vbo);
+
+	for (size_t i = 0; i < vao.attrCount; ++i)
+	{
+		const VertexAttribute &va = vao.attr[i];
+		const GLvoid *offset = (const char*) va.offset + base;
+
+		gl.VertexAttribPointer(va.index, va.size, va.type, GL_FALSE, vao.vertSize, offset);
+	}
+}
+
 #define HAVE_NATIVE_BLIT gl.BlitFramebuffer
 
 static void _blitBegin(FBO::ID fbo, const Vec2i &size)
@@ -161,7 +176,7 @@ void blitBeginScreen(const Vec2i &size)
 	_blitBegin(FBO::ID(0), size);
 }
 
-void blitSource(TEXFBO &source)
+void blitSource(const TEXFBO &source)
 {
 	if (HAVE_NATIVE_BLIT)
 	{
@@ -170,7 +185,7 @@ void blitSource(TEXFBO &source)
 	else
 	{
 		SimpleShader &shader = shState->shaders().simple;
-		shader.setTexSize(Vec2i(source.width, source.height));
+		shader.setTexSize(Vec2i(source.texWidth, source.texHeight));
 		TEX::bind(source.tex);
 	}
 }
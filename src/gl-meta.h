@@ -64,10 +64,15 @@ void vaoFini(VAO &vao);
 void vaoBind(VAO &vao);
 void vaoUnbind(VAO &vao);
 
+/* Points the attributes of the bound 'vao' at 'vertex' and on,
+ * so indices (which only go so high) can reach vertices further
+ * back in large vertex buffers */
+void vaoSetBase(VAO &vao, size_t vertex);
+
 /* EXT_framebuffer_blit */
 void blitBegin(TEXFBO &target);
 void blitBeginScreen(const Vec2i &size);
-void blitSource(TEXFBO &source);
+void blitSource(const TEXFBO &source);
 void blitRectangle(const IntRect &src, const Vec2i &dstPos);
 void blitRectangle(const IntRect &src, const IntRect &dst,
                    bool smooth = false);
@@ -24,6 +24,7 @@
 
 #include "gl-fun.h"
 #include "etc-internal.h"
+#include "vram.h"
 
 /* Struct wrapping GLuint for some light type safety */
 #define DEF_GL_ID \
@@ -63,6 +64,7 @@ namespace TEX
 
 	static inline void del(ID id)
 	{
+		VRAM::freed(id.gl);
 		gl.DeleteTextures(1, &id.gl);
 	}
 
@@ -86,9 +88,12 @@ namespace TEX
 		gl.TexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, format, GL_UNSIGNED_BYTE, data);
 	}
 
-	static inline void allocEmpty(GLsizei width, GLsizei height)
+	/* Allocates storage for the bound texture, which
+	 * has to be 'id', accounting it to 'cat' */
+	static inline void allocEmpty(ID id, GLsizei width, GLsizei height, VRAM::Category cat)
 	{
 		gl.TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+		VRAM::allocated(id.gl, width, height, cat);
 	}
 
 	static inline void setRepeat(bool mode)
@@ -203,8 +208,14 @@ struct TEXFBO
 	FBO::ID fbo;
 	int width, height;
 
+	/* Allocated size of 'tex', which texture coordinates
+	 * are normalized to. Can be larger than the size in use
+	 * for textures from a TexPool with size classes */
+	int texWidth, texHeight;
+
 	TEXFBO()
-	    : tex(0), fbo(0), width(0), height(0)
+	    : tex(0), fbo(0), width(0), height(0),
+	      texWidth(0), texHeight(0)
 	{}
 
 	bool operator==(const TEXFBO &other) const
@@ -221,12 +232,13 @@ struct TEXFBO
 		TEX::setSmooth(false);
 	}
 
-	static inline void allocEmpty(TEXFBO &obj, int width, int height)
+	static inline void allocEmpty(TEXFBO &obj, int width, int height,
+	                              VRAM::Category cat)
 	{
 		TEX::bind(obj.tex);
-		TEX::allocEmpty(width, height);
-		obj.width = width;
-		obj.height = height;
+		TEX::allocEmpty(obj.tex, width, height, cat);
+		obj.width = obj.texWidth = width;
+		obj.height = obj.texHeight = height;
 	}
 
 	static inline void linkFBO(TEXFBO &obj)
@@ -246,6 +258,7 @@ struct TEXFBO
 		obj.tex = TEX::ID(0);
 		obj.fbo = FBO::ID(0);
 		obj.width = obj.height = 0;
+		obj.texWidth = obj.texHeight = 0;
 	}
 };
 
@@ -0,0 +1,416 @@
+/*
+** glyphcache.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "glyphcache.h"
+
+#include "textlayoutcache.h"
+#include "config.h"
+#include "sharedstate.h"
+#include "glstate.h"
+#include "gl-meta.h"
+#include "shader.h"
+#include "quad.h"
+#include "util.h"
+
+#include <SDL_ttf.h>
+#include <SDL_surface.h>
+#include <SDL_version.h>
+
+#include <algorithm>
+
+#define ATLAS_SIZE 1024
+
+/* Transparent gap kept to the right and
+ * below each glyph, see BitmapAtlas */
+#define PADDING 1
+
+/* Has to match Bitmap's */
+#define OUTLINE_SIZE 1
+
+#if SDL_VERSIONNUM(SDL_TTF_MAJOR_VERSION, SDL_TTF_MINOR_VERSION, SDL_TTF_PATCHLEVEL) \
+    >= SDL_VERSIONNUM(2, 0, 14)
+#define HAVE_GLYPH_KERNING
+#endif
+
+GlyphCache::GlyphCache(int maxTexSize)
+    : atlasSize(std::min<int>(ATLAS_SIZE, maxTexSize)),
+      top(0)
+{}
+
+GlyphCache::~GlyphCache()
+{
+	if (atlas.tex != TEX::ID(0))
+		TEXFBO::fini(atlas);
+
+	if (runTarget.tex != TEX::ID(0))
+		TEXFBO::fini(runTarget);
+}
+
+static void putGlyph(Vertex *vert, const IntRect &tex,
+                     int x, int y, const Vec4 &color)
+{
+	Quad::setTexPosRect(vert, FloatRect(tex),
+	                    FloatRect(x, y, tex.w, tex.h));
+	Quad::setColor(vert, color);
+}
+
+bool GlyphCache::render(_TTF_Font *font, TextLayout &layout,
+                        const Vec4 &color, const Vec4 &outColor,
+                        bool outline, bool shadow, TextRun &run)
+{
+	const std::vector<uint16_t> &chars = layout.chars;
+	const int style = TTF_GetFontStyle(font);
+	const size_t stride = outline ? 2 : 1;
+
+	bool resident = false;
+
+	/* All glyphs of the string have to be in the atlas at
+	 * the same time; if they don't fit, start over once
+	 * with an empty atlas */
+	for (int attempt = 0; attempt < 2 && !resident; ++attempt)
+	{
+		if (attempt > 0)
+			clear();
+
+		runGlyphs.resize(chars.size() * stride);
+		resident = true;
+
+		for (size_t i = 0; i < chars.size() && resident; ++i)
+		{
+			resident = lookup(font, style, chars[i], false, runGlyphs[i*stride]);
+
+			if (resident && outline)
+				resident = lookup(font, style, chars[i], true, runGlyphs[i*stride+1]);
+		}
+	}
+
+	if (!resident)
+		return false;
+
+	if (layout.pen.size() != chars.size())
+		layOut(font, layout);
+
+	const std::vector<int> &pen = layout.pen;
+	int textW = 0;
+
+	for (size_t i = 0; i < chars.size(); ++i)
+		textW = std::max(textW, pen[i] + runGlyphs[i*stride].cellW);
+
+	run.lineHeight = layout.lineHeight;
+
+	/* Shadow and text are drawn on top of the outline,
+	 * which extends past them on every side */
+	const int textOff = outline ? OUTLINE_SIZE : 0;
+
+	if (outline)
+	{
+		run.width  = textW + OUTLINE_SIZE*2;
+		run.height = run.lineHeight + OUTLINE_SIZE*2;
+	}
+	else
+	{
+		run.width  = textW + (shadow ? 1 : 0);
+		run.height = run.lineHeight + (shadow ? 1 : 0);
+	}
+
+	size_t layers = 1 + (outline ? 1 : 0) + (shadow ? 1 : 0);
+
+	quads.resize(chars.size() * layers);
+	Vertex *vert = dataPtr(quads.vertices);
+	size_t count = 0;
+
+	if (outline)
+		for (size_t i = 0; i < chars.size(); ++i)
+		{
+			const Glyph &g = runGlyphs[i*stride+1];
+
+			if (g.rect.w > 0)
+				putGlyph(&vert[count++*4], g.rect, pen[i] + g.offset.x,
+				         g.offset.y, outColor);
+		}
+
+	if (shadow)
+		for (size_t i = 0; i < chars.size(); ++i)
+		{
+			const Glyph &g = runGlyphs[i*stride];
+
+			if (g.rect.w > 0)
+				putGlyph(&vert[count++*4], g.rect, pen[i] + textOff + g.offset.x + 1,
+				         textOff + g.offset.y + 1, Vec4(0, 0, 0, 1));
+		}
+
+	for (size_t i = 0; i < chars.size(); ++i)
+	{
+		const Glyph &g = runGlyphs[i*stride];
+
+		if (g.rect.w > 0)
+			putGlyph(&vert[count++*4], g.rect, pen[i] + textOff + g.offset.x,
+			         textOff + g.offset.y, color);
+	}
+
+	quads.resize(count);
+
+	ensureTarget(run.width, run.height);
+
+	FBO::bind(runTarget.fbo);
+	glState.viewport.pushSet(IntRect(0, 0, runTarget.width, runTarget.height));
+
+	glState.clearColor.pushSet(Vec4());
+	FBO::clear();
+	glState.clearColor.pop();
+
+	if (count > 0)
+	{
+		quads.commit();
+
+		GlyphShader &shader = shState->shaders().glyph;
+		shader.bind();
+		shader.applyViewportProj();
+		shader.setTranslation(Vec2i());
+		shader.setTexSize(Vec2i(atlas.width, atlas.height));
+
+		TEX::bind(atlas.tex);
+
+		/* Normal blending of the shader's straight alpha output
+		 * accumulates a premultiplied image of all layers */
+		glState.blend.pushSet(true);
+		glState.blendMode.pushSet(BlendNormal);
+
+		quads.draw();
+
+		glState.blendMode.pop();
+		glState.blend.pop();
+	}
+
+	glState.viewport.pop();
+
+	return true;
+}
+
+/* Places the line cells the way TTF_RenderUTF8 would */
+void GlyphCache::layOut(_TTF_Font *font, TextLayout &layout)
+{
+	const std::vector<uint16_t> &chars = layout.chars;
+	layout.pen.resize(chars.size());
+
+	int penX = 0;
+
+	for (size_t i = 0; i < chars.size(); ++i)
+	{
+#ifdef HAVE_GLYPH_KERNING
+		if (i > 0)
+			penX += TTF_GetFontKerningSizeGlyphs(font, chars[i-1], chars[i]);
+#endif
+
+		layout.pen[i] = penX;
+
+		int minX, maxX, minY, maxY, advance;
+
+		if (TTF_GlyphMetrics(font, chars[i], &minX, &maxX, &minY, &maxY, &advance) == 0)
+			penX += advance;
+	}
+
+	layout.lineHeight = TTF_FontHeight(font);
+}
+
+TEXFBO &GlyphCache::target()
+{
+	return runTarget;
+}
+
+bool GlyphCache::lookup(_TTF_Font *font, int style, uint16_t ch,
+                        bool outline, Glyph &out)
+{
+	const Key key(font, ch | (style << 16) | ((outline ? 1 : 0) << 24));
+
+	if (glyphs.contains(key))
+	{
+		out = glyphs.value(key);
+		return true;
+	}
+
+	if (!rasterize(font, ch, outline, out))
+		return false;
+
+	glyphs.insert(key, out);
+
+	return true;
+}
+
+bool GlyphCache::rasterize(_TTF_Font *font, uint16_t ch,
+                           bool outline, Glyph &out)
+{
+	out = Glyph();
+
+	if (outline)
+		TTF_SetFontOutline(font, OUTLINE_SIZE);
+
+	/* Color comes from the vertices, only coverage is kept */
+	SDL_Color white = { 255, 255, 255, 255 };
+	SDL_Surface *surf;
+
+	if (shState->config().solidFonts)
+		surf = TTF_RenderGlyph_Solid(font, ch, white);
+	else
+		surf = TTF_RenderGlyph_Blended(font, ch, white);
+
+	if (outline)
+		TTF_SetFontOutline(font, 0);
+
+	/* Glyph the font can't render; cache it as blank */
+	if (!surf)
+		return true;
+
+	if (surf->format->format != SDL_PIXELFORMAT_ABGR8888)
+	{
+		SDL_Surface *conv = SDL_ConvertSurfaceFormat(surf, SDL_PIXELFORMAT_ABGR8888, 0);
+		SDL_FreeSurface(surf);
+		surf = conv;
+	}
+
+	out.cellW = surf->w;
+
+	/* Only the inked part goes into the atlas */
+	const uint32_t aMask = surf->format->Amask;
+	int x1 = surf->w, y1 = surf->h, x2 = 0, y2 = 0;
+
+	for (int y = 0; y < surf->h; ++y)
+	{
+		const uint32_t *row = (const uint32_t*) ((const uint8_t*) surf->pixels + y*surf->pitch);
+
+		for (int x = 0; x < surf->w; ++x)
+			if (row[x] & aMask)
+			{
+				x1 = std::min(x1, x);
+				y1 = std::min(y1, y);
+				x2 = std::max(x2, x+1);
+				y2 = std::max(y2, y+1);
+			}
+	}
+
+	if (x1 >= x2 || y1 >= y2)
+	{
+		SDL_FreeSurface(surf);
+		return true;
+	}
+
+	if (!allocate(x2 - x1, y2 - y1, out.rect))
+	{
+		SDL_FreeSurface(surf);
+		return false;
+	}
+
+	out.offset = Vec2i(x1, y1);
+
+	SDL_SetSurfaceBlendMode(surf, SDL_BLENDMODE_NONE);
+
+	TEX::bind(atlas.tex);
+	GLMeta::subRectImageUpload(surf->w, x1, y1, out.rect.x, out.rect.y,
+	                           out.rect.w, out.rect.h, surf, GL_RGBA);
+	GLMeta::subRectImageEnd();
+
+	SDL_FreeSurface(surf);
+
+	return true;
+}
+
+bool GlyphCache::allocate(int width, int height, IntRect &out)
+{
+	const int cellW = width + PADDING;
+	const int cellH = height + PADDING;
+
+	if (cellW > atlasSize || cellH > atlasSize)
+		return false;
+
+	if (atlas.tex == TEX::ID(0))
+	{
+		TEXFBO::init(atlas);
+		TEXFBO::allocEmpty(atlas, atlasSize, atlasSize, VRAM::Text);
+		TEXFBO::linkFBO(atlas);
+
+		clear();
+	}
+
+	Shelf *best = 0;
+
+	/* Pick the shelf that wastes the least height */
+	for (size_t i = 0; i < shelves.size(); ++i)
+	{
+		Shelf &shelf = shelves[i];
+
+		if (shelf.h < cellH || atlasSize - shelf.x < cellW)
+			continue;
+
+		if (!best || shelf.h < best->h)
+			best = &shelf;
+	}
+
+	if (!best)
+	{
+		if (atlasSize - top < cellH)
+			return false;
+
+		Shelf shelf = { top, cellH, 0 };
+		shelves.push_back(shelf);
+		top += cellH;
+
+		best = &shelves.back();
+	}
+
+	out = IntRect(best->x, best->y, width, height);
+	best->x += cellW;
+
+	return true;
+}
+
+void GlyphCache::clear()
+{
+	glyphs = BoostHash<Key, Glyph>();
+	shelves.clear();
+	top = 0;
+
+	if (atlas.tex == TEX::ID(0))
+		return;
+
+	/* Keep the padding transparent */
+	FBO::bind(atlas.fbo);
+
+	glState.clearColor.pushSet(Vec4());
+	FBO::clear();
+	glState.clearColor.pop();
+}
+
+void GlyphCache::ensureTarget(int width, int height)
+{
+	if (width <= runTarget.width && height <= runTarget.height)
+		return;
+
+	if (runTarget.tex != TEX::ID(0))
+		TEXFBO::fini(runTarget);
+
+	/* Grow in steps, strings vary a lot in length */
+	width  = std::max(runTarget.width,  (width  + 63) & ~63);
+	height = std::max(runTarget.height, (height + 15) & ~15);
+
+	TEXFBO::init(runTarget);
+	TEXFBO::allocEmpty(runTarget, width, height, VRAM::Text);
+	TEXFBO::linkFBO(runTarget);
+}
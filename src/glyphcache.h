@@ -0,0 +1,124 @@
+/*
+** glyphcache.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GLYPHCACHE_H
+#define GLYPHCACHE_H
+
+#include "gl-util.h"
+#include "etc-internal.h"
+#include "quadarray.h"
+#include "boost-hash.h"
+
+#include <vector>
+#include <utility>
+#include <stdint.h>
+
+struct _TTF_Font;
+struct TextLayout;
+
+/* Rasterizes each glyph once per font handle, style and
+ * outline into a shared atlas texture, and renders strings
+ * from it as one batch of glyph quads instead of running
+ * them through SDL_ttf as a whole every time.
+ * The atlas is wiped and starts over once it is full */
+class GlyphCache
+{
+public:
+	struct TextRun
+	{
+		/* Size of the rendered text,
+		 * including outline and shadow */
+		int width, height;
+
+		/* Height of the bare text line,
+		 * used for vertical alignment */
+		int lineHeight;
+	};
+
+	GlyphCache(int maxTexSize);
+	~GlyphCache();
+
+	/* Renders the decoded chars of 'layout' into target()
+	 * (starting at its origin) with premultiplied alpha:
+	 * outline glyphs in 'outColor' if 'outline' is set, then
+	 * a black shadow offset by one pixel if 'shadow' is set,
+	 * then the text in 'color'. Lays out 'layout' if it hasn't
+	 * been yet. Returns false if the glyphs don't fit into
+	 * the atlas, in which case nothing is rendered */
+	bool render(_TTF_Font *font, TextLayout &layout,
+	            const Vec4 &color, const Vec4 &outColor,
+	            bool outline, bool shadow, TextRun &run);
+
+	/* Holds the result of the last render() */
+	TEXFBO &target();
+
+private:
+	struct Glyph
+	{
+		/* Location of the inked part in the atlas
+		 * (empty for blank glyphs), and its
+		 * offset inside of the glyph's cell */
+		IntRect rect;
+		Vec2i offset;
+
+		/* Width of the glyph's cell */
+		int cellW;
+
+		Glyph()
+		    : cellW(0)
+		{}
+	};
+
+	/* (font, char | style << 16 | outline << 24) */
+	typedef std::pair<_TTF_Font*, uint32_t> Key;
+
+	void layOut(_TTF_Font *font, TextLayout &layout);
+	bool lookup(_TTF_Font *font, int style, uint16_t ch,
+	            bool outline, Glyph &out);
+	bool rasterize(_TTF_Font *font, uint16_t ch,
+	               bool outline, Glyph &out);
+	bool allocate(int width, int height, IntRect &out);
+	void clear();
+	void ensureTarget(int width, int height);
+
+	BoostHash<Key, Glyph> glyphs;
+
+	TEXFBO atlas;
+	int atlasSize;
+
+	/* Shelf packing state, see BitmapAtlas */
+	struct Shelf
+	{
+		int y, h;
+		int x;
+	};
+
+	std::vector<Shelf> shelves;
+	int top;
+
+	TEXFBO runTarget;
+
+	/* Reused between render() calls */
+	std::vector<Glyph> runGlyphs;
+	ColorQuadArray quads;
+};
+
+#endif // GLYPHCACHE_H
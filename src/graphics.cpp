@@ -31,16 +31,21 @@
 #include "quad.h"
 #include "eventthread.h"
 #include "texpool.h"
+#include "vram.h"
+#include "frametrace.h"
+#include "preparequeue.h"
 #include "bitmap.h"
 #include "etc-internal.h"
 #include "disposable.h"
 #include "intrulist.h"
 #include "binding.h"
 #include "debugwriter.h"
+#include "sdl-util.h"
 
 #include <SDL_video.h>
 #include <SDL_timer.h>
 #include <SDL_image.h>
+#include <SDL_mutex.h>
 
 #include <time.h>
 #include <sys/time.h>
@@ -64,7 +69,7 @@ struct PingPong
 		for (int i = 0; i < 2; ++i)
 		{
 			TEXFBO::init(rt[i]);
-			TEXFBO::allocEmpty(rt[i], screenW, screenH);
+			TEXFBO::allocEmpty(rt[i], screenW, screenH, VRAM::Screen);
 			TEXFBO::linkFBO(rt[i]);
 			gl.ClearColor(0, 0, 0, 1);
 			FBO::clear();
@@ -94,7 +99,7 @@ struct PingPong
 		screenH = height;
 
 		for (int i = 0; i < 2; ++i)
-			TEXFBO::allocEmpty(rt[i], width, height);
+			TEXFBO::allocEmpty(rt[i], width, height, VRAM::Screen);
 	}
 
 	void startRender()
@@ -146,7 +151,10 @@ public:
 		const int w = geometry.rect.w;
 		const int h = geometry.rect.h;
 
-		shState->prepareDraw();
+		{
+			TraceScope scope(shState->frameTrace(), "prepareDraw");
+			shState->prepareQueue().process();
+		}
 
 		pp.startRender();
 
@@ -172,109 +180,45 @@ public:
 		const IntRect &viewpRect = glState.scissorBox.get();
 		const IntRect &screenRect = geometry.rect;
 
-		const bool toneRGBEffect  = t.xyzNotNull();
-		const bool toneGrayEffect = t.w != 0;
-		const bool colorEffect    = c.w > 0;
-		const bool flashEffect    = f.w > 0;
-
-		if (toneGrayEffect)
-		{
-			pp.swapRender();
-
-			if (!viewpRect.encloses(screenRect))
-			{
-				/* Scissor test _does_ affect FBO blit operations,
-				 * and since we're inside the draw cycle, it will
-				 * be turned on, so turn it off temporarily */
-				glState.scissorTest.pushSet(false);
-
-				GLMeta::blitBegin(pp.frontBuffer());
-				GLMeta::blitSource(pp.backBuffer());
-				GLMeta::blitRectangle(geometry.rect, Vec2i());
-				GLMeta::blitEnd();
+		const bool toneEffect  = t.xyzNotNull() || t.w != 0;
+		const bool colorEffect = c.w > 0;
+		const bool flashEffect = f.w > 0;
 
-				glState.scissorTest.pop();
-			}
+		if (!toneEffect && !colorEffect && !flashEffect)
+			return;
 
-			GrayShader &shader = shState->shaders().gray;
-			shader.bind();
-			shader.setGray(t.w);
-			shader.applyViewportProj();
-			shader.setTexSize(screenRect.size());
+		/* Only the part of the screen covered by the viewport
+		 * is affected, so that's all we need to copy and shade */
+		IntRect effectRect;
+		if (!SDL_IntersectRect(&viewpRect, &screenRect, &effectRect))
+			return;
 
-			TEX::bind(pp.backBuffer().tex);
+		TraceScope scope(shState->frameTrace(), "ScreenScene::requestViewportRender");
 
-			glState.blend.pushSet(false);
-			screenQuad.draw();
-			glState.blend.pop();
-		}
+		/* Copy the affected area into the back buffer
+		 * so we can sample it while drawing over it */
+		GLMeta::blitBegin(pp.backBuffer());
+		GLMeta::blitSource(pp.frontBuffer());
+		GLMeta::blitRectangle(effectRect, Vec2i(effectRect.x, effectRect.y));
+		GLMeta::blitEnd();
 
-		if (!toneRGBEffect && !colorEffect && !flashEffect)
-			return;
+		FBO::bind(pp.frontBuffer().fbo);
 
-		FlatColorShader &shader = shState->shaders().flatColor;
+		/* Apply gray, tone, color and flash in one pass,
+		 * the scissor box still limits it to the viewport */
+		ViewportEffectShader &shader = shState->shaders().viewportEffect;
 		shader.bind();
 		shader.applyViewportProj();
+		shader.setTexSize(screenRect.size());
+		shader.setTone(t);
+		shader.setColor(colorEffect ? c : Vec4());
+		shader.setFlash(flashEffect ? f : Vec4());
 
-		if (toneRGBEffect)
-		{
-			/* First split up additive / substractive components */
-			Vec4 add, sub;
-
-			if (t.x > 0)
-				add.x = t.x;
-			if (t.y > 0)
-				add.y = t.y;
-			if (t.z > 0)
-				add.z = t.z;
-
-			if (t.x < 0)
-				sub.x = -t.x;
-			if (t.y < 0)
-				sub.y = -t.y;
-			if (t.z < 0)
-				sub.z = -t.z;
-
-			/* Then apply them using hardware blending */
-			gl.BlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE);
-
-			if (add.xyzNotNull())
-			{
-				gl.BlendEquation(GL_FUNC_ADD);
-				shader.setColor(add);
-
-				screenQuad.draw();
-			}
+		TEX::bind(pp.backBuffer().tex);
 
-			if (sub.xyzNotNull())
-			{
-				gl.BlendEquation(GL_FUNC_REVERSE_SUBTRACT);
-				shader.setColor(sub);
-
-				screenQuad.draw();
-			}
-		}
-
-		if (colorEffect || flashEffect)
-		{
-			gl.BlendEquation(GL_FUNC_ADD);
-			gl.BlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
-			                     GL_ZERO, GL_ONE);
-		}
-
-		if (colorEffect)
-		{
-			shader.setColor(c);
-			screenQuad.draw();
-		}
-
-		if (flashEffect)
-		{
-			shader.setColor(f);
-			screenQuad.draw();
-		}
-
-		glState.blendMode.refresh();
+		glState.blend.pushSet(false);
+		screenQuad.draw();
+		glState.blend.pop();
 	}
 
 	void setBrightness(float norm)
@@ -443,6 +387,293 @@ private:
 	}
 };
 
+/* Presents finished frames from a dedicated thread owning a second
+ * GL context that shares objects with the RGSS one. The RGSS thread
+ * only copies each frame into one of two present buffers and moves
+ * on, so a buffer swap blocking on vsync no longer stalls script
+ * execution; it is throttled only once both buffers are queued */
+struct PresentThread
+{
+	struct Frame
+	{
+		/* Allocated and filled in the RGSS context */
+		TEXFBO buffer;
+
+		/* FBOs aren't shared between contexts, so the
+		 * present context wraps 'buffer.tex' in its own */
+		FBO::ID presentFBO;
+
+		/* Signaled once the copy into 'buffer' is done */
+		_GLsync fence;
+
+		/* Signaled once the present context is done reading
+		 * 'buffer', set before the frame is handed back */
+		_GLsync readFence;
+
+		/* Flipped and scaled target rect in the window */
+		IntRect dstRect;
+	};
+
+	Frame frames[2];
+
+	/* Index of the next frame filled by the RGSS thread */
+	size_t fillIdx;
+
+	SDL_Window *window;
+	SDL_GLContext ctx;
+	bool vsync;
+	bool smooth;
+
+	/* Number of frames queued for presenting / free for filling */
+	SDL_sem *queuedSem;
+	SDL_sem *freeSem;
+
+	/* Posted once the present thread has tried to make
+	 * its context current, with the result in 'started' */
+	SDL_sem *startSem;
+	bool started;
+
+	AtomicFlag quit;
+	SDL_Thread *thread;
+
+	/* Returns null if presenting from a separate thread
+	 * isn't possible, in which case the RGSS thread keeps
+	 * presenting on its own. Must be called with the RGSS
+	 * context current, which it is again on return */
+	static PresentThread *create(RGSSThreadData *threadData,
+	                             SDL_GLContext mainCtx,
+	                             const Vec2i &res)
+	{
+		if (threadData->config.headless)
+			return 0;
+
+		if (!gl.BlitFramebuffer)
+		{
+			Debug() << "Threaded present requires framebuffer blits, disabled";
+			return 0;
+		}
+
+		SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+		SDL_GLContext ctx = SDL_GL_CreateContext(threadData->window);
+		SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+
+		/* Context creation makes the new one current */
+		SDL_GL_MakeCurrent(threadData->window, mainCtx);
+
+		if (!ctx)
+		{
+			Debug() << "Failed to create present context:" << SDL_GetError();
+			return 0;
+		}
+
+		PresentThread *presenter = new PresentThread(threadData, ctx, res);
+
+		/* Some drivers (eg. EGL) refuse to have the window
+		 * surface current in two threads at once */
+		if (!presenter->started)
+		{
+			delete presenter;
+			return 0;
+		}
+
+		return presenter;
+	}
+
+	PresentThread(RGSSThreadData *threadData,
+	              SDL_GLContext ctx,
+	              const Vec2i &res)
+	    : fillIdx(0),
+	      window(threadData->window),
+	      ctx(ctx),
+	      vsync(threadData->config.vsync || threadData->config.syncToRefreshrate),
+	      smooth(threadData->config.smoothScaling)
+	{
+		for (size_t i = 0; i < ARRAY_SIZE(frames); ++i)
+		{
+			TEXFBO::init(frames[i].buffer);
+			TEXFBO::allocEmpty(frames[i].buffer, res.x, res.y, VRAM::Screen);
+			TEXFBO::linkFBO(frames[i].buffer);
+
+			frames[i].fence = 0;
+			frames[i].readFence = 0;
+		}
+
+		/* The textures must be fully specified before
+		 * the other context first touches them */
+		gl.Finish();
+
+		queuedSem = SDL_CreateSemaphore(0);
+		freeSem = SDL_CreateSemaphore(ARRAY_SIZE(frames));
+		startSem = SDL_CreateSemaphore(0);
+		started = false;
+
+		thread = createSDLThread
+			<PresentThread, &PresentThread::run>(this, "present");
+
+		SDL_SemWait(startSem);
+	}
+
+	~PresentThread()
+	{
+		quit.set();
+		SDL_SemPost(queuedSem);
+		SDL_WaitThread(thread, 0);
+
+		SDL_GL_DeleteContext(ctx);
+
+		SDL_DestroySemaphore(queuedSem);
+		SDL_DestroySemaphore(freeSem);
+		SDL_DestroySemaphore(startSem);
+
+		for (size_t i = 0; i < ARRAY_SIZE(frames); ++i)
+		{
+			if (frames[i].fence)
+				gl.DeleteSync(frames[i].fence);
+
+			if (frames[i].readFence)
+				gl.DeleteSync(frames[i].readFence);
+
+			TEXFBO::fini(frames[i].buffer);
+		}
+	}
+
+	/* Called from the RGSS thread, before writing to a
+	 * frame handed back by the present thread */
+	void waitForRead(Frame &frame)
+	{
+		if (!frame.readFence)
+			return;
+
+		gl.WaitSync(frame.readFence, 0, GL_TIMEOUT_IGNORED);
+		gl.DeleteSync(frame.readFence);
+		frame.readFence = 0;
+	}
+
+	/* Called from the RGSS thread */
+	void queueFrame(TEXFBO &source, const IntRect &dstRect)
+	{
+		SDL_SemWait(freeSem);
+
+		Frame &frame = frames[fillIdx];
+		waitForRead(frame);
+
+		GLMeta::blitBegin(frame.buffer);
+		GLMeta::blitSource(source);
+		GLMeta::blitRectangle(IntRect(0, 0, frame.buffer.width, frame.buffer.height), Vec2i());
+		GLMeta::blitEnd();
+
+		frame.dstRect = dstRect;
+
+		if (gl.FenceSync)
+			frame.fence = gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		/* The copy has to be submitted before the present
+		 * context can wait on it; without fences, wait
+		 * for it to complete outright */
+		if (frame.fence)
+			gl.Flush();
+		else
+			gl.Finish();
+
+		fillIdx = (fillIdx + 1) % ARRAY_SIZE(frames);
+
+		SDL_SemPost(queuedSem);
+	}
+
+	/* Called from the RGSS thread */
+	void resize(const Vec2i &res)
+	{
+		/* Wait for all queued frames to be presented */
+		for (size_t i = 0; i < ARRAY_SIZE(frames); ++i)
+			SDL_SemWait(freeSem);
+
+		for (size_t i = 0; i < ARRAY_SIZE(frames); ++i)
+		{
+			waitForRead(frames[i]);
+			TEXFBO::allocEmpty(frames[i].buffer, res.x, res.y, VRAM::Screen);
+		}
+
+		for (size_t i = 0; i < ARRAY_SIZE(frames); ++i)
+			SDL_SemPost(freeSem);
+	}
+
+	void run()
+	{
+		if (SDL_GL_MakeCurrent(window, ctx) != 0)
+		{
+			Debug() << "Failed to make present context current:" << SDL_GetError()
+			        << "(falling back to synchronous present)";
+			SDL_SemPost(startSem);
+
+			return;
+		}
+
+		started = true;
+		SDL_SemPost(startSem);
+
+		SDL_GL_SetSwapInterval(vsync ? 1 : 0);
+
+		for (size_t i = 0; i < ARRAY_SIZE(frames); ++i)
+			frames[i].presentFBO = FBO::gen();
+
+		gl.ClearColor(0, 0, 0, 1);
+
+		size_t presentIdx = 0;
+
+		while (true)
+		{
+			SDL_SemWait(queuedSem);
+
+			if (quit)
+				break;
+
+			Frame &frame = frames[presentIdx];
+
+			if (frame.fence)
+			{
+				gl.WaitSync(frame.fence, 0, GL_TIMEOUT_IGNORED);
+				gl.DeleteSync(frame.fence);
+				frame.fence = 0;
+			}
+
+			/* Reattach every time so a texture respecified
+			 * by a resize is picked up in this context */
+			FBO::bind(frame.presentFBO);
+			FBO::setTarget(frame.buffer.tex);
+
+			gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+			FBO::clear();
+
+			const IntRect &dst = frame.dstRect;
+			gl.BlitFramebuffer(0, 0, frame.buffer.width, frame.buffer.height,
+			                   dst.x, dst.y, dst.x+dst.w, dst.y+dst.h,
+			                   GL_COLOR_BUFFER_BIT, smooth ? GL_LINEAR : GL_NEAREST);
+
+			/* The RGSS context may only write to 'buffer' again
+			 * once the blit above has read it; without fences,
+			 * wait for that here before handing it back */
+			if (gl.FenceSync)
+				frame.readFence = gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+			if (frame.readFence)
+				gl.Flush();
+			else
+				gl.Finish();
+
+			SDL_GL_SwapWindow(window);
+
+			presentIdx = (presentIdx + 1) % ARRAY_SIZE(frames);
+
+			SDL_SemPost(freeSem);
+		}
+
+		for (size_t i = 0; i < ARRAY_SIZE(frames); ++i)
+			FBO::del(frames[i].presentFBO);
+
+		SDL_GL_MakeCurrent(window, 0);
+	}
+};
+
 struct GraphicsPrivate
 {
 	/* Screen resolution, ie. the resolution at which
@@ -466,6 +697,9 @@ struct GraphicsPrivate
 	RGSSThreadData *threadData;
 	SDL_GLContext glCtx;
 
+	/* Null when presenting from the RGSS thread */
+	PresentThread *presenter;
+
 	int frameRate;
 	int frameCount;
 	int brightness;
@@ -476,6 +710,11 @@ struct GraphicsPrivate
 	TEXFBO frozenScene;
 	Quad screenQuad;
 
+	/* Dirty generation the PingPong front buffer was last
+	 * composited at; see SharedState::markDirty() */
+	unsigned int compositedGen;
+	bool forceComposite;
+
 	/* Global list of all live Disposables
 	 * (disposed on reset) */
 	IntruList<Disposable> dispList;
@@ -487,27 +726,35 @@ struct GraphicsPrivate
 	      screen(scRes.x, scRes.y),
 	      threadData(rtData),
 	      glCtx(SDL_GL_GetCurrentContext()),
+	      presenter(0),
 	      frameRate(DEF_FRAMERATE),
 	      frameCount(0),
 	      brightness(255),
 	      fpsLimiter(frameRate),
-	      frozen(false)
+	      frozen(false),
+	      compositedGen(0),
+	      forceComposite(true)
 	{
 		recalculateScreenSize(rtData);
 		updateScreenResoRatio(rtData);
 
 		TEXFBO::init(frozenScene);
-		TEXFBO::allocEmpty(frozenScene, scRes.x, scRes.y);
+		TEXFBO::allocEmpty(frozenScene, scRes.x, scRes.y, VRAM::Screen);
 		TEXFBO::linkFBO(frozenScene);
 
 		FloatRect screenRect(0, 0, scRes.x, scRes.y);
 		screenQuad.setTexPosRect(screenRect, screenRect);
 
+		if (rtData->config.threadedPresent)
+			presenter = PresentThread::create(rtData, glCtx, scRes);
+
 		fpsLimiter.resetFrameAdjust();
 	}
 
 	~GraphicsPrivate()
 	{
+		delete presenter;
+
 		TEXFBO::fini(frozenScene);
 	}
 
@@ -573,8 +820,26 @@ struct GraphicsPrivate
 
 	void swapGLBuffer()
 	{
-		fpsLimiter.delay();
-		SDL_GL_SwapWindow(threadData->window);
+		FrameTrace &trace = shState->frameTrace();
+
+		{
+			TraceScope scope(trace, "FPSLimiter::delay");
+			fpsLimiter.delay();
+		}
+
+		{
+			TraceScope scope(trace, "SDL_GL_SwapWindow");
+
+			/* Without a swap to throttle on, wait for the
+			 * GL to drain so frame times stay meaningful */
+			if (threadData->config.headless)
+				gl.Finish();
+			else if (!presenter)
+				SDL_GL_SwapWindow(threadData->window);
+		}
+
+		if (trace.isEnabled())
+			trace.endFrame();
 
 		++frameCount;
 
@@ -591,28 +856,69 @@ struct GraphicsPrivate
 		GLMeta::blitEnd();
 	}
 
+	IntRect flippedScaledRect() const
+	{
+		return IntRect(scOffset.x, scSize.y+scOffset.y, scSize.x, -scSize.y);
+	}
+
 	void metaBlitBufferFlippedScaled()
 	{
 		GLMeta::blitRectangle(IntRect(0, 0, scRes.x, scRes.y),
-		                      IntRect(scOffset.x, scSize.y+scOffset.y, scSize.x, -scSize.y),
+		                      flippedScaledRect(),
 		                      threadData->config.smoothScaling);
 	}
 
-	void redrawScreen()
+	/* Scales 'buffer' (at screen resolution) into the window,
+	 * either directly or by handing it to the present thread */
+	void blitBufferToScreen(TEXFBO &buffer)
 	{
-		screen.composite();
+		TraceScope scope(shState->frameTrace(), "Screen blit");
+
+		if (presenter)
+		{
+			presenter->queueFrame(buffer, flippedScaledRect());
+			return;
+		}
 
 		GLMeta::blitBeginScreen(winSize);
-		GLMeta::blitSource(screen.getPP().frontBuffer());
+		GLMeta::blitSource(buffer);
 
 		FBO::clear();
 		metaBlitBufferFlippedScaled();
 
 		GLMeta::blitEnd();
+	}
 
+	void presentBuffer(TEXFBO &buffer)
+	{
+		blitBufferToScreen(buffer);
 		swapGLBuffer();
 	}
 
+	void redrawScreen()
+	{
+		/* If nothing on screen changed since the last composite,
+		 * the front buffer still holds the current frame */
+		if (forceComposite || compositedGen != shState->dirtyGeneration())
+		{
+			screen.composite();
+
+			/* Changes made while preparing the draw
+			 * are already part of this frame */
+			compositedGen = shState->dirtyGeneration();
+			forceComposite = false;
+		}
+
+		/* The frame stays in the PingPong buffers */
+		if (threadData->config.headless)
+		{
+			swapGLBuffer();
+			return;
+		}
+
+		presentBuffer(screen.getPP().frontBuffer());
+	}
+
 	void checkSyncLock()
 	{
 		if (!threadData->syncPoint.mainSyncLocked())
@@ -646,6 +952,9 @@ Graphics::Graphics(RGSSThreadData *data)
 	{
 		p->fpsLimiter.disabled = true;
 	}
+
+	if (data->config.headless)
+		p->fpsLimiter.disabled = true;
 }
 
 Graphics::~Graphics()
@@ -658,6 +967,10 @@ void Graphics::update()
 	p->checkShutDownReset();
 	p->checkSyncLock();
 
+	/* Give back pooled textures if anything pushed
+	 * us over the memory budget since last frame */
+	shState->texPool().trim(VRAM::excess());
+
 	if (p->frozen)
 		return;
 
@@ -666,7 +979,16 @@ void Graphics::update()
 		if (p->threadData->config.frameSkip)
 		{
 			/* Skip frame */
-			p->fpsLimiter.delay();
+			FrameTrace &trace = shState->frameTrace();
+
+			{
+				TraceScope scope(trace, "FPSLimiter::delay");
+				p->fpsLimiter.delay();
+			}
+
+			if (trace.isEnabled())
+				trace.endFrame();
+
 			++p->frameCount;
 			p->threadData->ethread->notifyFrame();
 
@@ -730,7 +1052,14 @@ void Graphics::transition(int duration,
 		shader.applyViewportProj();
 		shader.setFrozenScene(p->frozenScene.tex);
 		shader.setCurrentScene(currentScene.tex);
-		shader.setTransMap(transMap->getGLTypes().tex);
+		/* The transition bitmap may sit in the atlas, or in a pooled
+		 * texture larger than itself; only sample its own pixels */
+		const TEXFBO &mapTex = transMap->backingTex();
+		const Vec2i mapOrig = transMap->texOrigin();
+
+		shader.setTransMap(mapTex.tex);
+		shader.setTransMapRect(Vec2i(mapTex.texWidth, mapTex.texHeight),
+		                       IntRect(mapOrig.x, mapOrig.y, transMap->width(), transMap->height()));
 		shader.setVague(vague / 256.0f);
 		shader.setTexSize(p->scRes);
 	}
@@ -792,14 +1121,7 @@ void Graphics::transition(int duration,
 
 		/* Then blit it flipped and scaled to the screen */
 		FBO::unbind();
-		FBO::clear();
-
-		GLMeta::blitBeginScreen(Vec2i(p->winSize));
-		GLMeta::blitSource(transBuffer);
-		p->metaBlitBufferFlippedScaled();
-		GLMeta::blitEnd();
-
-		p->swapGLBuffer();
+		p->presentBuffer(transBuffer);
 	}
 
 	glState.blend.pop();
@@ -855,15 +1177,7 @@ void Graphics::fadeout(int duration)
 
 		if (p->frozen)
 		{
-			GLMeta::blitBeginScreen(p->scSize);
-			GLMeta::blitSource(p->frozenScene);
-
-			FBO::clear();
-			p->metaBlitBufferFlippedScaled();
-
-			GLMeta::blitEnd();
-
-			p->swapGLBuffer();
+			p->presentBuffer(p->frozenScene);
 		}
 		else
 		{
@@ -885,15 +1199,7 @@ void Graphics::fadein(int duration)
 
 		if (p->frozen)
 		{
-			GLMeta::blitBeginScreen(p->scSize);
-			GLMeta::blitSource(p->frozenScene);
-
-			FBO::clear();
-			p->metaBlitBufferFlippedScaled();
-
-			GLMeta::blitEnd();
-
-			p->swapGLBuffer();
+			p->presentBuffer(p->frozenScene);
 		}
 		else
 		{
@@ -937,8 +1243,12 @@ void Graphics::resizeScreen(int width, int height)
 	p->scRes = size;
 
 	p->screen.setResolution(width, height);
+	p->forceComposite = true;
+
+	TEXFBO::allocEmpty(p->frozenScene, width, height, VRAM::Screen);
 
-	TEXFBO::allocEmpty(p->frozenScene, width, height);
+	if (p->presenter)
+		p->presenter->resize(size);
 
 	FloatRect screenRect(0, 0, width, height);
 	p->screenQuad.setTexPosRect(screenRect, screenRect);
@@ -970,6 +1280,7 @@ void Graphics::setBrightness(int value)
 
 	p->brightness = value;
 	p->screen.setBrightness(value / 255.0);
+	p->forceComposite = true;
 }
 
 void Graphics::reset()
@@ -990,6 +1301,7 @@ void Graphics::reset()
 	p->fpsLimiter.resetFrameAdjust();
 	p->frozen = false;
 	p->screen.getPP().clearBuffers();
+	p->forceComposite = true;
 
 	setFrameRate(DEF_FRAMERATE);
 	setBrightness(255);
@@ -1027,8 +1339,6 @@ void Graphics::repaintWait(const AtomicFlag &exitCond, bool checkReset)
 
 	/* Repaint the screen with the last good frame we drew */
 	TEXFBO &lastFrame = p->screen.getPP().frontBuffer();
-	GLMeta::blitBeginScreen(p->winSize);
-	GLMeta::blitSource(lastFrame);
 
 	while (!exitCond)
 	{
@@ -1037,15 +1347,23 @@ void Graphics::repaintWait(const AtomicFlag &exitCond, bool checkReset)
 		if (checkReset)
 			shState->checkReset();
 
-		FBO::clear();
-		p->metaBlitBufferFlippedScaled();
-		SDL_GL_SwapWindow(p->threadData->window);
+		if (p->threadData->config.headless)
+		{
+			/* Nothing to repaint; don't spin at full speed */
+			SDL_Delay(10);
+		}
+		else
+		{
+			p->blitBufferToScreen(lastFrame);
+
+			if (!p->presenter)
+				SDL_GL_SwapWindow(p->threadData->window);
+		}
+
 		p->fpsLimiter.delay();
 
 		p->threadData->ethread->notifyFrame();
 	}
-
-	GLMeta::blitEnd();
 }
 
 void Graphics::addDisposable(Disposable *d)
@@ -0,0 +1,529 @@
+/*
+** imageloader.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "imageloader.h"
+
+#include "filesystem.h"
+#include "config.h"
+#include "exception.h"
+#include "boost-hash.h"
+#include "sdl-util.h"
+#include "debugwriter.h"
+
+#include <SDL_image.h>
+#include <SDL_surface.h>
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+static void ensureFormat(SDL_Surface *&surf)
+{
+	if (surf->format->format == SDL_PIXELFORMAT_ABGR8888)
+		return;
+
+	SDL_Surface *conv = SDL_ConvertSurfaceFormat(surf, SDL_PIXELFORMAT_ABGR8888, 0);
+	SDL_FreeSurface(surf);
+	surf = conv;
+}
+
+/* FNV-1a */
+static uint64_t hashBytes(const void *data, size_t size)
+{
+	const uint8_t *bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = 14695981039346656037ULL;
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+#define CACHE_FORMAT_VER 1
+
+/* Larger dimensions are taken for a corrupt header when
+ * reading, so images exceeding them aren't cached at all */
+#define CACHE_MAX_DIM 0x4000
+
+/* Image cache file layout: this header,
+ * followed by the ABGR8888 pixel rows */
+struct CacheHeader
+{
+	char magic[4];
+	uint32_t formVer;
+	uint32_t width;
+	uint32_t height;
+
+	/* Size and hash of the encoded file
+	 * the pixels were decoded from */
+	uint64_t srcSize;
+	uint64_t srcHash;
+};
+
+static const char cacheMagic[4] = { 'M', 'K', 'X', 'I' };
+
+static void buildCachePath(const std::string &dir, const char *filename,
+                           const char *ext, char *out, size_t outSize)
+{
+	std::string key(filename);
+	key += '.';
+	key += ext ? ext : "";
+
+	snprintf(out, outSize, "%s/%016llx.mkxpimg", dir.c_str(),
+	         (unsigned long long) hashBytes(key.data(), key.size()));
+}
+
+static SDL_Surface *readCached(const char *path, uint64_t srcSize, uint64_t srcHash)
+{
+	FILE *f = fopen(path, "rb");
+
+	if (!f)
+		return 0;
+
+	CacheHeader hd;
+
+	if (fread(&hd, sizeof(hd), 1, f) < 1 ||
+	    memcmp(hd.magic, cacheMagic, sizeof(cacheMagic)) != 0 ||
+	    hd.formVer != CACHE_FORMAT_VER ||
+	    hd.srcSize != srcSize || hd.srcHash != srcHash ||
+	    hd.width == 0 || hd.height == 0 ||
+	    hd.width > CACHE_MAX_DIM || hd.height > CACHE_MAX_DIM)
+	{
+		fclose(f);
+		return 0;
+	}
+
+	int bpp;
+	Uint32 rMask, gMask, bMask, aMask;
+	SDL_PixelFormatEnumToMasks(SDL_PIXELFORMAT_ABGR8888,
+	                           &bpp, &rMask, &gMask, &bMask, &aMask);
+
+	SDL_Surface *surf =
+		SDL_CreateRGBSurface(0, hd.width, hd.height, bpp, rMask, gMask, bMask, aMask);
+
+	if (!surf)
+	{
+		fclose(f);
+		return 0;
+	}
+
+	const size_t rowBytes = hd.width * 4;
+	bool ok = true;
+
+	for (int y = 0; y < surf->h && ok; ++y)
+		ok = fread((uint8_t*) surf->pixels + y*surf->pitch, rowBytes, 1, f) == 1;
+
+	fclose(f);
+
+	if (!ok)
+	{
+		SDL_FreeSurface(surf);
+		return 0;
+	}
+
+	return surf;
+}
+
+static void writeCached(const char *path, SDL_Surface *surf,
+                        uint64_t srcSize, uint64_t srcHash)
+{
+	/* Wouldn't be read back anyway (eg. mega bitmaps) */
+	if (surf->w > CACHE_MAX_DIM || surf->h > CACHE_MAX_DIM)
+		return;
+
+	/* Written under a temporary name, so a partially written
+	 * file (full disk, crash) is never picked up */
+	char tmpPath[1100];
+	snprintf(tmpPath, sizeof(tmpPath), "%s.%lu", path, SDL_ThreadID());
+
+	FILE *f = fopen(tmpPath, "wb");
+
+	if (!f)
+		return;
+
+	CacheHeader hd;
+	memcpy(hd.magic, cacheMagic, sizeof(cacheMagic));
+	hd.formVer = CACHE_FORMAT_VER;
+	hd.width = surf->w;
+	hd.height = surf->h;
+	hd.srcSize = srcSize;
+	hd.srcHash = srcHash;
+
+	const size_t rowBytes = surf->w * 4;
+	bool ok = fwrite(&hd, sizeof(hd), 1, f) == 1;
+
+	for (int y = 0; y < surf->h && ok; ++y)
+		ok = fwrite((const uint8_t*) surf->pixels + y*surf->pitch, rowBytes, 1, f) == 1;
+
+	ok = (fclose(f) == 0) && ok;
+
+	if (ok)
+	{
+		/* Windows doesn't rename onto existing files */
+		remove(path);
+		ok = rename(tmpPath, path) == 0;
+	}
+
+	if (!ok)
+		remove(tmpPath);
+}
+
+struct ImageOpenHandler : FileSystem::OpenHandler
+{
+	SDL_Surface *surf;
+
+	const char *filename;
+	const std::string &cacheDir;
+
+	ImageOpenHandler(const char *filename, const std::string &cacheDir)
+	    : surf(0),
+	      filename(filename),
+	      cacheDir(cacheDir)
+	{}
+
+	bool tryRead(SDL_RWops &ops, const char *ext)
+	{
+		if (cacheDir.empty())
+		{
+			surf = IMG_LoadTyped_RW(&ops, 1, ext);
+
+			if (surf)
+				ensureFormat(surf);
+
+			return surf != 0;
+		}
+
+		/* The encoded file is read either way, as cached
+		 * pixels are only used if it hasn't changed since */
+		std::string data;
+		Sint64 size = SDL_RWsize(&ops);
+
+		if (size > 0)
+		{
+			data.resize(size);
+			data.resize(SDL_RWread(&ops, &data[0], 1, size));
+		}
+
+		SDL_RWclose(&ops);
+
+		if (data.empty())
+			return false;
+
+		char path[1024];
+		buildCachePath(cacheDir, filename, ext, path, sizeof(path));
+
+		const uint64_t srcHash = hashBytes(data.data(), data.size());
+		surf = readCached(path, data.size(), srcHash);
+
+		if (surf)
+			return true;
+
+		surf = IMG_LoadTyped_RW(SDL_RWFromConstMem(data.data(), data.size()), 1, ext);
+
+		if (!surf)
+			return false;
+
+		ensureFormat(surf);
+
+		if (surf)
+			writeCached(path, surf, data.size(), srcHash);
+
+		return surf != 0;
+	}
+};
+
+static SDL_Surface *decodeImage(FileSystem &fs, const std::string &cacheDir,
+                                const char *filename)
+{
+	ImageOpenHandler handler(filename, cacheDir);
+	fs.openRead(handler, filename);
+
+	return handler.surf;
+}
+
+static size_t surfaceBytes(SDL_Surface *surf)
+{
+	return (size_t) surf->pitch * surf->h;
+}
+
+struct ImageLoaderPrivate
+{
+	enum JobState
+	{
+		Queued,
+		Decoding,
+		Decoded
+	};
+
+	struct Job
+	{
+		std::string filename;
+		JobState state;
+		SDL_Surface *surf;
+	};
+
+	FileSystem &fs;
+
+	/* Where decoded images are kept across runs,
+	 * empty if that is disabled */
+	std::string cacheDir;
+
+	size_t threadCount;
+	size_t budget;
+
+	std::vector<SDL_Thread*> threads;
+
+	/* Guards everything below */
+	SDL_mutex *mutex;
+	/* Signaled when a job is queued, or on quit */
+	SDL_cond *queuedCond;
+	/* Signaled when a job is done decoding */
+	SDL_cond *doneCond;
+
+	BoostHash<std::string, Job*> jobs;
+	std::deque<Job*> queue;
+
+	/* Decoded images, oldest first */
+	std::list<Job*> decoded;
+	size_t decodedBytes;
+
+	bool quit;
+
+	ImageLoaderPrivate(const Config &conf, FileSystem &fs)
+	    : fs(fs),
+	      cacheDir(conf.imageCache),
+	      threadCount(std::max(conf.preloadThreads, 0)),
+	      budget((size_t) std::max(conf.preloadBudget, 0) * 1024 * 1024),
+	      mutex(SDL_CreateMutex()),
+	      queuedCond(SDL_CreateCond()),
+	      doneCond(SDL_CreateCond()),
+	      decodedBytes(0),
+	      quit(false)
+	{}
+
+	~ImageLoaderPrivate()
+	{
+		SDL_LockMutex(mutex);
+		quit = true;
+		SDL_CondBroadcast(queuedCond);
+		SDL_UnlockMutex(mutex);
+
+		for (size_t i = 0; i < threads.size(); ++i)
+			SDL_WaitThread(threads[i], 0);
+
+		BoostHash<std::string, Job*>::const_iterator iter;
+		for (iter = jobs.cbegin(); iter != jobs.cend(); ++iter)
+		{
+			if (iter->second->surf)
+				SDL_FreeSurface(iter->second->surf);
+
+			delete iter->second;
+		}
+
+		SDL_DestroyCond(doneCond);
+		SDL_DestroyCond(queuedCond);
+		SDL_DestroyMutex(mutex);
+	}
+
+	/* Threads are only started on the first preload, after
+	 * the filesystem has long been set up; games that never
+	 * preload don't pay for them. Called with the mutex held */
+	void startThreads()
+	{
+		for (size_t i = 0; i < threadCount; ++i)
+		{
+			SDL_Thread *thread = createSDLThread
+				<ImageLoaderPrivate, &ImageLoaderPrivate::run>(this, "imageload");
+
+			if (!thread)
+			{
+				Debug() << "Failed to start image loading thread:" << SDL_GetError();
+				break;
+			}
+
+			threads.push_back(thread);
+		}
+	}
+
+	/* Forgets about 'job' entirely. Called with the mutex held */
+	void drop(Job *job)
+	{
+		if (job->surf)
+		{
+			decoded.remove(job);
+			decodedBytes -= surfaceBytes(job->surf);
+		}
+
+		jobs.remove(job->filename);
+		delete job;
+	}
+
+	void run()
+	{
+		SDL_LockMutex(mutex);
+
+		while (true)
+		{
+			while (queue.empty() && !quit)
+				SDL_CondWait(queuedCond, mutex);
+
+			if (quit)
+				break;
+
+			Job *job = queue.front();
+			queue.pop_front();
+			job->state = Decoding;
+
+			SDL_UnlockMutex(mutex);
+
+			SDL_Surface *surf = 0;
+
+			try
+			{
+				surf = decodeImage(fs, cacheDir, job->filename.c_str());
+			}
+			catch (const Exception &)
+			{
+				/* Bitmap's own attempt will report the error */
+			}
+
+			SDL_LockMutex(mutex);
+
+			job->state = Decoded;
+
+			if (surf)
+			{
+				job->surf = surf;
+				decoded.push_back(job);
+				decodedBytes += surfaceBytes(surf);
+
+				while (decodedBytes > budget)
+					drop(decoded.front());
+			}
+			else
+			{
+				drop(job);
+			}
+
+			SDL_CondBroadcast(doneCond);
+		}
+
+		SDL_UnlockMutex(mutex);
+	}
+};
+
+ImageLoader::ImageLoader(const Config &conf, FileSystem &fs)
+{
+	p = new ImageLoaderPrivate(conf, fs);
+}
+
+ImageLoader::~ImageLoader()
+{
+	delete p;
+}
+
+SDL_Surface *ImageLoader::decode(const char *filename)
+{
+	return decodeImage(p->fs, p->cacheDir, filename);
+}
+
+void ImageLoader::preload(const char *filename)
+{
+	if (p->threadCount == 0)
+		return;
+
+	const std::string key(filename);
+
+	SDL_LockMutex(p->mutex);
+
+	if (!p->jobs.contains(key))
+	{
+		ImageLoaderPrivate::Job *job = new ImageLoaderPrivate::Job;
+		job->filename = key;
+		job->state = ImageLoaderPrivate::Queued;
+		job->surf = 0;
+
+		p->jobs.insert(key, job);
+		p->queue.push_back(job);
+
+		if (p->threads.empty())
+			p->startThreads();
+
+		SDL_CondSignal(p->queuedCond);
+	}
+
+	SDL_UnlockMutex(p->mutex);
+}
+
+SDL_Surface *ImageLoader::take(const char *filename)
+{
+	if (p->threadCount == 0)
+		return 0;
+
+	const std::string key(filename);
+	SDL_Surface *surf = 0;
+
+	SDL_LockMutex(p->mutex);
+
+	while (p->jobs.contains(key))
+	{
+		ImageLoaderPrivate::Job *job = p->jobs.value(key);
+
+		/* Almost done, cheaper than starting over */
+		if (job->state == ImageLoaderPrivate::Decoding)
+		{
+			SDL_CondWait(p->doneCond, p->mutex);
+			continue;
+		}
+
+		/* Decoding it right here beats waiting
+		 * for the jobs queued before it */
+		if (job->state == ImageLoaderPrivate::Queued)
+		{
+			p->queue.erase(std::find(p->queue.begin(), p->queue.end(), job));
+			p->drop(job);
+			break;
+		}
+
+		/* Ownership moves to the caller */
+		surf = job->surf;
+		p->decoded.remove(job);
+		p->decodedBytes -= surfaceBytes(surf);
+		p->jobs.remove(key);
+		delete job;
+
+		break;
+	}
+
+	SDL_UnlockMutex(p->mutex);
+
+	return surf;
+}
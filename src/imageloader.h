@@ -0,0 +1,65 @@
+/*
+** imageloader.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGELOADER_H
+#define IMAGELOADER_H
+
+struct SDL_Surface;
+struct Config;
+struct ImageLoaderPrivate;
+class FileSystem;
+
+/* Decodes image files ahead of time on worker threads, so
+ * that creating a Bitmap from a preloaded file only has to
+ * upload the pixels on the RGSS thread. Decoded images are
+ * kept until taken, or dropped (oldest first) once they
+ * exceed the configured memory budget.
+ * Optionally, decoded pixels are also stored on disk, and
+ * read back instead of decoding the same file again in
+ * later runs */
+class ImageLoader
+{
+public:
+	ImageLoader(const Config &conf, FileSystem &fs);
+	~ImageLoader();
+
+	/* Queues 'filename' for decoding, unless it
+	 * already is queued or decoded */
+	void preload(const char *filename);
+
+	/* Hands over the decoded image of 'filename' and forgets
+	 * about it. Waits if it is being decoded right now.
+	 * Returns null if it wasn't preloaded, hasn't been started
+	 * on yet, or failed to decode */
+	SDL_Surface *take(const char *filename);
+
+	/* Reads and decodes 'filename' into an ABGR8888 surface,
+	 * going through the image cache directory if one is set.
+	 * Returns null if the image can't be decoded (see
+	 * SDL_GetError()), throws if the file doesn't exist.
+	 * Safe to call from any thread */
+	SDL_Surface *decode(const char *filename);
+
+private:
+	ImageLoaderPrivate *p;
+};
+
+#endif // IMAGELOADER_H
@@ -107,11 +107,13 @@ int rgssThreadFun(void *userdata)
 
 	gl.ClearColor(0, 0, 0, 1);
 	gl.Clear(GL_COLOR_BUFFER_BIT);
-	SDL_GL_SwapWindow(win);
+
+	if (!conf.headless)
+		SDL_GL_SwapWindow(win);
 
 	printGLInfo();
 
-	bool vsync = conf.vsync || conf.syncToRefreshrate;
+	bool vsync = (conf.vsync || conf.syncToRefreshrate) && !conf.headless;
 	SDL_GL_SetSwapInterval(vsync ? 1 : 0);
 
 	GLDebugLogger dLogger;
@@ -233,6 +235,27 @@ int main(int argc, char *argv[])
 
 	conf.readGameINI();
 
+	/* In headless mode, default to SDL's windowless EGL driver
+	 * and OpenAL Soft's null backend; both can still be
+	 * overridden through the environment */
+	if (conf.headless)
+	{
+		SDL_setenv("SDL_VIDEODRIVER", "offscreen", 0);
+		SDL_setenv("ALSOFT_DRIVERS", "null", 0);
+
+		SDL_QuitSubSystem(SDL_INIT_VIDEO);
+
+		if (SDL_InitSubSystem(SDL_INIT_VIDEO) < 0)
+		{
+			showInitError(std::string("Error initializing headless video: ") + SDL_GetError());
+			SDL_Quit();
+
+			return 0;
+		}
+
+		Debug() << "Headless mode, video driver:" << SDL_GetCurrentVideoDriver();
+	}
+
 	if (conf.windowTitle.empty())
 		conf.windowTitle = conf.game.title;
 
@@ -275,6 +298,11 @@ int main(int argc, char *argv[])
 	if (conf.fullscreen)
 		winFlags |= SDL_WINDOW_FULLSCREEN_DESKTOP;
 
+	/* The window only serves as a GL surface for
+	 * the offscreen driver; never show it */
+	if (conf.headless)
+		winFlags = SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN;
+
 	win = SDL_CreateWindow(conf.windowTitle.c_str(),
 	                       SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
 	                       conf.defScreenW, conf.defScreenH, winFlags);
@@ -33,8 +33,7 @@
 #include "etc-internal.h"
 #include "shader.h"
 #include "glstate.h"
-
-#include <sigc++/connection.h>
+#include "preparequeue.h"
 
 static float fwrap(float value, float range)
 {
@@ -42,7 +41,7 @@ static float fwrap(float value, float range)
 	return res < 0 ? res + range : res;
 }
 
-struct PlanePrivate
+struct PlanePrivate : public Preparable
 {
 	Bitmap *bitmap;
 
@@ -60,9 +59,15 @@ struct PlanePrivate
 
 	SimpleQuadArray qArray;
 
-	EtcTemps tmp;
+	/* For mega bitmaps, the quads are grouped by bitmap
+	 * tile, with this many quads in each group */
+	size_t megaTileQuads;
+
+	/* The quads were set up to have the
+	 * sampler repeat the bitmap texture */
+	bool samplerRepeat;
 
-	sigc::connection prepareCon;
+	EtcTemps tmp;
 
 	PlanePrivate()
 	    : bitmap(0),
@@ -72,23 +77,48 @@ struct PlanePrivate
 	      tone(&tmp.tone),
 	      ox(0), oy(0),
 	      zoomX(1), zoomY(1),
-	      quadSourceDirty(false)
+	      quadSourceDirty(false),
+	      megaTileQuads(0),
+	      samplerRepeat(false)
 	{
-		prepareCon = shState->prepareDraw.connect
-		        (sigc::mem_fun(this, &PlanePrivate::prepare));
-
 		qArray.resize(1);
 	}
 
-	~PlanePrivate()
+	void invalidateQuadSource()
 	{
-		prepareCon.disconnect();
+		quadSourceDirty = true;
+		schedulePrepare();
+	}
+
+	/* Only a texture holding nothing but the bitmap can be
+	 * repeated by the sampler; mega bitmaps, atlased ones and
+	 * ones in a larger pooled texture are tiled with quads */
+	bool canSamplerRepeat() const
+	{
+		if (!gl.npot_repeat)
+			return false;
+
+		if (nullOrDisposed(bitmap))
+			return true;
+
+		if (bitmap->isMega())
+			return false;
+
+		const TEXFBO &tex = bitmap->backingTex();
+
+		return tex.texWidth == bitmap->width() && tex.texHeight == bitmap->height();
 	}
 
 	void updateQuadSource()
 	{
-		if (gl.npot_repeat)
+		megaTileQuads = 0;
+		samplerRepeat = canSamplerRepeat();
+
+		if (samplerRepeat)
 		{
+			qArray.resize(1);
+			Quad::setPosRect(&qArray.vertices[0], FloatRect(sceneGeo.rect));
+
 			FloatRect srcRect;
 			srcRect.x = (sceneGeo.orig.x + ox) / zoomX;
 			srcRect.y = (sceneGeo.orig.y + oy) / zoomY;
@@ -120,6 +150,34 @@ struct PlanePrivate
 		size_t tilesX = ceil((vpw - sw + wox) / sw) + 1;
 		size_t tilesY = ceil((vph - sh + woy) / sh) + 1;
 
+		if (bitmap->isMega())
+		{
+			megaTileQuads = tilesX * tilesY;
+			qArray.resize(megaTileQuads * bitmap->megaTileCount());
+
+			SVertex *vert = &qArray.vertices[0];
+
+			for (size_t t = 0; t < bitmap->megaTileCount(); ++t)
+			{
+				const IntRect tileRect = bitmap->megaTileRect(t);
+				FloatRect tex(0, 0, tileRect.w, tileRect.h);
+
+				for (size_t y = 0; y < tilesY; ++y)
+					for (size_t x = 0; x < tilesX; ++x)
+					{
+						FloatRect pos(x*sw - wox + tileRect.x*zoomX,
+						              y*sh - woy + tileRect.y*zoomY,
+						              tileRect.w*zoomX, tileRect.h*zoomY);
+
+						vert += Quad::setTexPosRect(vert, tex, pos) * 4;
+					}
+			}
+
+			qArray.commit();
+
+			return;
+		}
+
 		FloatRect tex = bitmap->rect();
 
 		qArray.resize(tilesX * tilesY);
@@ -161,9 +219,9 @@ DEF_ATTR_RD_SIMPLE(Plane, ZoomX,     float,   p->zoomX)
 DEF_ATTR_RD_SIMPLE(Plane, ZoomY,     float,   p->zoomY)
 DEF_ATTR_RD_SIMPLE(Plane, BlendType, int,     p->blendType)
 
-DEF_ATTR_SIMPLE(Plane, Opacity,   int,     p->opacity)
-DEF_ATTR_SIMPLE(Plane, Color,     Color&, *p->color)
-DEF_ATTR_SIMPLE(Plane, Tone,      Tone&,  *p->tone)
+DEF_ATTR_NOTIFY(Plane, Opacity,   int,     p->opacity, shState->markDirty())
+DEF_ATTR_NOTIFY(Plane, Color,     Color&, *p->color,   shState->markDirty())
+DEF_ATTR_NOTIFY(Plane, Tone,      Tone&,  *p->tone,    shState->markDirty())
 
 Plane::~Plane()
 {
@@ -175,11 +233,8 @@ void Plane::setBitmap(Bitmap *value)
 	guardDisposed();
 
 	p->bitmap = value;
-
-	if (!value)
-		return;
-
-	value->ensureNonMega();
+	p->invalidateQuadSource();
+	shState->markDirty();
 }
 
 void Plane::setOX(int value)
@@ -190,7 +245,9 @@ void Plane::setOX(int value)
 	        return;
 
 	p->ox = value;
-	p->quadSourceDirty = true;
+	p->invalidateQuadSource();
+
+	shState->markDirty();
 }
 
 void Plane::setOY(int value)
@@ -201,7 +258,9 @@ void Plane::setOY(int value)
 	        return;
 
 	p->oy = value;
-	p->quadSourceDirty = true;
+	p->invalidateQuadSource();
+
+	shState->markDirty();
 }
 
 void Plane::setZoomX(float value)
@@ -212,7 +271,9 @@ void Plane::setZoomX(float value)
 	        return;
 
 	p->zoomX = value;
-	p->quadSourceDirty = true;
+	p->invalidateQuadSource();
+
+	shState->markDirty();
 }
 
 void Plane::setZoomY(float value)
@@ -223,13 +284,17 @@ void Plane::setZoomY(float value)
 	        return;
 
 	p->zoomY = value;
-	p->quadSourceDirty = true;
+	p->invalidateQuadSource();
+
+	shState->markDirty();
 }
 
 void Plane::setBlendType(int value)
 {
 	guardDisposed();
 
+	shState->markDirty();
+
 	switch (value)
 	{
 	default :
@@ -287,26 +352,38 @@ void Plane::draw()
 
 	glState.blendMode.pushSet(p->blendType);
 
-	p->bitmap->bindTex(*base);
+	/* The bitmap might have moved to a different texture */
+	if (p->samplerRepeat != p->canSamplerRepeat())
+		p->updateQuadSource();
+
+	if (p->megaTileQuads > 0)
+	{
+		for (size_t t = 0; t < p->bitmap->megaTileCount(); ++t)
+		{
+			p->bitmap->megaTile(t).bindTex(*base);
+			p->qArray.draw(t * p->megaTileQuads, p->megaTileQuads);
+		}
+	}
+	else
+	{
+		p->bitmap->bindTex(*base);
 
-	if (gl.npot_repeat)
-		TEX::setRepeat(true);
+		if (p->samplerRepeat)
+			TEX::setRepeat(true);
 
-	p->qArray.draw();
+		p->qArray.draw();
 
-	if (gl.npot_repeat)
-		TEX::setRepeat(false);
+		if (p->samplerRepeat)
+			TEX::setRepeat(false);
+	}
 
 	glState.blendMode.pop();
 }
 
 void Plane::onGeometryChange(const Scene::Geometry &geo)
 {
-	if (gl.npot_repeat)
-		Quad::setPosRect(&p->qArray.vertices[0], FloatRect(geo.rect));
-
 	p->sceneGeo = geo;
-	p->quadSourceDirty = true;
+	p->invalidateQuadSource();
 }
 
 void Plane::releaseResources()
@@ -0,0 +1,101 @@
+/*
+** preparequeue.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "preparequeue.h"
+
+#include "sharedstate.h"
+
+#include <assert.h>
+
+Preparable::Preparable()
+    : prepareLink(this),
+      selfQueued(false)
+{}
+
+void Preparable::schedulePrepare(bool first)
+{
+	shState->prepareQueue().enqueue(*this, first);
+}
+
+PrepareQueue::PrepareQueue()
+    : current(0),
+      active(0)
+{}
+
+PrepareQueue::~PrepareQueue()
+{
+	/* Unhook anything still queued so the links
+	 * don't point into us once we're gone */
+	for (int i = 0; i < 2; ++i)
+		while (!lists[i].isEmpty())
+			lists[i].remove(*lists[i].begin());
+}
+
+void PrepareQueue::enqueue(Preparable &elem, bool first)
+{
+	/* Already queued (in either list) */
+	if (elem.prepareLink.next)
+		return;
+
+	/* Elements notified from within process() join the list
+	 * being processed, or their changes (and the markDirty()
+	 * that came with them) would only make it to the screen
+	 * with the next composite, if there is one at all */
+	const bool sameCall = active && active != &elem;
+	elem.selfQueued = (active == &elem);
+
+	IntruList<Preparable> &list = lists[sameCall ? current ^ 1 : current];
+
+	if (first)
+		list.prepend(elem.prepareLink);
+	else
+		list.append(elem.prepareLink);
+}
+
+void PrepareQueue::process()
+{
+	IntruList<Preparable> &list = lists[current];
+	current ^= 1;
+
+	assert(lists[current].isEmpty());
+
+	while (!list.isEmpty())
+	{
+		IntruListLink<Preparable> *link = list.begin();
+		list.remove(*link);
+
+		active = link->data;
+		active->prepare();
+	}
+
+	active = 0;
+
+#ifndef NDEBUG
+	/* Only elements that rescheduled themselves may wait for the
+	 * next call. Anything else, eg. a FlashMap or TilemapVX notified
+	 * by a Table edit, has to be prepared by now, as a frame where
+	 * nothing else changes wouldn't be composited again */
+	IntruList<Preparable> &next = lists[current];
+
+	for (IntruListLink<Preparable> *link = next.begin(); link != next.end(); link = link->next)
+		assert(link->data->selfQueued);
+#endif
+}
@@ -0,0 +1,79 @@
+/*
+** preparequeue.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PREPAREQUEUE_H
+#define PREPAREQUEUE_H
+
+#include "intrulist.h"
+
+/* Anything that has to update GL state (vertex buffers,
+ * textures) before the screen is composited. Instead of
+ * being polled every frame, it enqueues itself via
+ * schedulePrepare() whenever its state changes, and gets
+ * its prepare() called once before the next composite */
+class Preparable
+{
+public:
+	Preparable();
+	virtual ~Preparable() {}
+
+	virtual void prepare() = 0;
+
+	/* Cheap to call repeatedly; a queued element is
+	 * only prepared once. With 'first', it goes ahead
+	 * of everything queued so far, so elements it
+	 * notifies during prepare() that are queued already
+	 * see the change in the same pass (see process()) */
+	void schedulePrepare(bool first = false);
+
+private:
+	friend class PrepareQueue;
+
+	IntruListLink<Preparable> prepareLink;
+
+	/* Queued from within its own prepare() */
+	bool selfQueued;
+};
+
+class PrepareQueue
+{
+public:
+	PrepareQueue();
+	~PrepareQueue();
+
+	void enqueue(Preparable &elem, bool first = false);
+
+	/* Prepares and dequeues every element queued so far,
+	 * including ones scheduled by another element's prepare()
+	 * during this call. Elements that schedule themselves
+	 * again from within their own prepare() are kept for
+	 * the next call */
+	void process();
+
+private:
+	IntruList<Preparable> lists[2];
+	int current;
+
+	/* Element whose prepare() is running, if any */
+	Preparable *active;
+};
+
+#endif // PREPAREQUEUE_H
@@ -21,6 +21,8 @@
 
 #include "scene.h"
 #include "sharedstate.h"
+#include "frametrace.h"
+#include "spritebatch.h"
 
 Scene::Scene()
 {}
@@ -36,48 +38,79 @@ Scene::~Scene()
 	}
 }
 
-void Scene::insert(SceneElement &element)
+Scene::ElementKey::ElementKey(const SceneElement &e)
+    : z(e.z),
+      spriteY(e.spriteY),
+      creationStamp(e.creationStamp)
+{}
+
+bool Scene::ElementKey::operator<(const ElementKey &o) const
 {
-	IntruListLink<SceneElement> *iter;
+	/* Element draw order is decided by their Z value.
+	 * If two Z values are equal, the later created object
+	 * has priority */
 
-	for (iter = elements.begin(); iter != elements.end(); iter = iter->next)
+	if (z <= o.z)
 	{
-		SceneElement *e = iter->data;
-
-		if (element < *e)
+		if (z == o.z)
 		{
-			elements.insertBefore(element.link, *iter);
-			return;
+			if (rgssVer >= 2)
+			{
+				/* RGSS2: If two sprites' Z values collide,
+				 * their Y coordinates decide draw order. Only
+				 * on equal Y does the creation time take effect */
+				if (spriteY != o.spriteY)
+					return (spriteY < o.spriteY);
+			}
+
+			return (creationStamp < o.creationStamp);
 		}
+
+		return true;
 	}
 
-	elements.append(element.link);
+	return false;
 }
 
-void Scene::insertAfter(SceneElement &element, SceneElement &after)
+void Scene::insert(SceneElement &element)
 {
-	IntruListLink<SceneElement> *iter;
+	shState->markDirty();
 
-	for (iter = &after.link; iter != elements.end(); iter = iter->next)
-	{
-		SceneElement *e = iter->data;
+	ElementIndex::iterator iter =
+		index.insert(std::make_pair(ElementKey(element), &element)).first;
+	element.indexIter = iter;
 
-		if (element < *e)
-		{
-			elements.insertBefore(element.link, *iter);
-			return;
-		}
-	}
+	/* Link in front of the next higher priority element */
+	if (++iter == index.end())
+		elements.append(element.link);
+	else
+		elements.insertBefore(element.link, iter->second->link);
+}
 
-	elements.append(element.link);
+void Scene::insertAfter(SceneElement &element, SceneElement &)
+{
+	/* With the index, finding the insertion point no longer
+	 * benefits from a starting hint; the draw order is the
+	 * same as long as 'element' sorts after 'after' */
+	insert(element);
 }
 
 void Scene::reinsert(SceneElement &element)
 {
-	elements.remove(element.link);
+	remove(element);
 	insert(element);
 }
 
+void Scene::remove(SceneElement &element)
+{
+	/* Not linked */
+	if (!element.link.next)
+		return;
+
+	elements.remove(element.link);
+	index.erase(element.indexIter);
+}
+
 void Scene::notifyGeometryChange()
 {
 	IntruListLink<SceneElement> *iter;
@@ -90,15 +123,31 @@ void Scene::notifyGeometryChange()
 
 void Scene::composite()
 {
+	FrameTrace &trace = shState->frameTrace();
+	TraceScope scope(trace, "Scene::composite");
+
+	SpriteBatch &batch = shState->spriteBatch();
+
 	IntruListLink<SceneElement> *iter;
 
 	for (iter = elements.begin(); iter != elements.end(); iter = iter->next)
 	{
 		SceneElement *e = iter->data;
 
-		if (e->visible)
-			e->draw();
+		if (!e->visible)
+			continue;
+
+		if (e->drawBatched(batch))
+			continue;
+
+		/* Anything queued so far is below this element */
+		batch.flush();
+
+		TraceScope elemScope(trace, "SceneElement::draw", "z", e->z);
+		e->draw();
 	}
+
+	batch.flush();
 }
 
 
@@ -158,35 +207,11 @@ void SceneElement::setVisible(bool value)
 {
 	aboutToAccess();
 
-	visible = value;
-}
-
-bool SceneElement::operator<(const SceneElement &o) const
-{
-	/* Element draw order is decided by their Z value.
-	 * If two Z values are equal, the later created object
-	 * has priority */
-
-	if (z <= o.z)
-	{
-		if (z == o.z)
-		{
-			if (rgssVer >= 2)
-			{
-				/* RGSS2: If two sprites' Z values collide,
-				 * their Y coordinates decide draw order. Only
-				 * on equal Y does the creation time take effect */
-				if (spriteY != o.spriteY)
-					return (spriteY < o.spriteY);
-			}
-
-			return (creationStamp < o.creationStamp);
-		}
-
-		return true;
-	}
+	if (visible == value)
+		return;
 
-	return false;
+	visible = value;
+	shState->markDirty();
 }
 
 void SceneElement::setSpriteY(int value)
@@ -197,6 +222,9 @@ void SceneElement::setSpriteY(int value)
 
 void SceneElement::unlink()
 {
-	if (scene)
-		scene->elements.remove(link);
+	if (!scene)
+		return;
+
+	scene->remove(*this);
+	shState->markDirty();
 }
@@ -27,7 +27,10 @@
 #include "etc.h"
 #include "etc-internal.h"
 
+#include <map>
+
 class SceneElement;
+class SpriteBatch;
 class Viewport;
 class WindowVX;
 class Window;
@@ -62,14 +65,35 @@ public:
 	const Geometry &getGeometry() const { return geometry; }
 
 protected:
+	/* Display priority of an element; elements with
+	 * lower priority are drawn earlier */
+	struct ElementKey
+	{
+		int z;
+		int spriteY;
+		unsigned int creationStamp;
+
+		ElementKey(const SceneElement &e);
+
+		bool operator<(const ElementKey &o) const;
+	};
+
+	typedef std::map<ElementKey, SceneElement*> ElementIndex;
+
 	void insert(SceneElement &element);
 	void insertAfter(SceneElement &element, SceneElement &after);
 	void reinsert(SceneElement &element);
+	void remove(SceneElement &element);
 
 	/* Notify all elements that geometry has changed */
 	void notifyGeometryChange();
 
+	/* Elements in draw order. The index mirrors it sorted
+	 * by priority so that (re)insertions can find their
+	 * neighbour in logarithmic time instead of walking
+	 * the whole list */
 	IntruList<SceneElement> elements;
+	ElementIndex index;
 	Geometry geometry;
 
 	friend class SceneElement;
@@ -107,22 +131,26 @@ protected:
 	 * cleanup (and therefore you should expect dirty state).
 	 * Do NOT touch the FBO::Draw binding. If you have to do work
 	 * immediately before drawing that touches this (such as flushing
-	 * Bitmaps), use the 'prepareDraw' signal in SharedState that
-	 * will fire immediately before each frame draw.
+	 * Bitmaps), derive from Preparable and schedule a prepare;
+	 * queued elements are prepared immediately before each frame draw.
 	 */
 	virtual void draw() = 0;
 
+	/* Queues this element's geometry into 'batch' instead of
+	 * drawing it, if it can be expressed that way. Returns
+	 * false if it has to be drawn via 'draw()' after all */
+	virtual bool drawBatched(SpriteBatch &) { return false; }
+
 	// FIXME: This should be a signal
 	virtual void onGeometryChange(const Scene::Geometry &) {}
 
-	/* Compares two elements in terms of their display priority;
-	 * elements with lower priority are drawn earlier */
-	bool operator<(const SceneElement &o) const;
-
 	void setSpriteY(int value);
 	void unlink();
 
 	IntruListLink<SceneElement> link;
+	/* Own entry in the scene's index while linked; the key
+	 * stored there is what it was sorted by on insertion */
+	Scene::ElementIndex::iterator indexIter;
 	const unsigned int creationStamp;
 	int z;
 	bool visible;
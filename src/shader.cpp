@@ -34,8 +34,11 @@
 #include "trans.frag.xxd"
 #include "transSimple.frag.xxd"
 #include "bitmapBlit.frag.xxd"
+#include "bitmapBlitBatch.frag.xxd"
+#include "textBlit.frag.xxd"
+#include "glyph.frag.xxd"
 #include "plane.frag.xxd"
-#include "gray.frag.xxd"
+#include "viewportEffect.frag.xxd"
 #include "flatColor.frag.xxd"
 #include "simple.frag.xxd"
 #include "simpleColor.frag.xxd"
@@ -46,6 +49,7 @@
 #include "simple.vert.xxd"
 #include "simpleColor.vert.xxd"
 #include "sprite.vert.xxd"
+#include "spriteWave.vert.xxd"
 #include "tilemap.vert.xxd"
 #include "blur.frag.xxd"
 #include "simpleMatrix.vert.xxd"
@@ -250,6 +254,7 @@ void ShaderBase::GLProjMat::apply(const Vec2i &value)
 void ShaderBase::init()
 {
 	GET_U(texSizeInv);
+	GET_U(texOrigin);
 	GET_U(translation);
 
 	projMat.u_mat = gl.GetUniformLocation(program, "projMat");
@@ -261,9 +266,15 @@ void ShaderBase::applyViewportProj()
 	projMat.set(Vec2i(vp.w, vp.h));
 }
 
-void ShaderBase::setTexSize(const Vec2i &value)
+void ShaderBase::setTexSize(const Vec2i &value, const Vec2i &origin)
 {
 	gl.Uniform2f(u_texSizeInv, 1.f / value.x, 1.f / value.y);
+
+	if (origin == texOrigin)
+		return;
+
+	gl.Uniform2f(u_texOrigin, origin.x, origin.y);
+	texOrigin = origin;
 }
 
 void ShaderBase::setTranslation(const Vec2i &value)
@@ -318,6 +329,14 @@ SimpleAlphaShader::SimpleAlphaShader()
 }
 
 
+GlyphShader::GlyphShader()
+{
+	INIT_SHADER(simpleColor, glyph, GlyphShader);
+
+	ShaderBase::init();
+}
+
+
 SimpleSpriteShader::SimpleSpriteShader()
 {
 	INIT_SHADER(sprite, simple, SimpleSpriteShader);
@@ -363,6 +382,7 @@ TransShader::TransShader()
 	GET_U(currentScene);
 	GET_U(frozenScene);
 	GET_U(transMap);
+	GET_U(transMapRect);
 	GET_U(prog);
 	GET_U(vague);
 }
@@ -382,6 +402,12 @@ void TransShader::setTransMap(TEX::ID tex)
 	setTexUniform(u_transMap, 3, tex);
 }
 
+void TransShader::setTransMapRect(const Vec2i &texSize, const IntRect &rect)
+{
+	setVec4Uniform(u_transMapRect, Vec4((float) rect.x / texSize.x, (float) rect.y / texSize.y,
+	                                    (float) rect.w / texSize.x, (float) rect.h / texSize.y));
+}
+
 void TransShader::setProg(float value)
 {
 	gl.Uniform1f(u_prog, value);
@@ -424,6 +450,14 @@ SpriteShader::SpriteShader()
 {
 	INIT_SHADER(sprite, sprite, SpriteShader);
 
+	init();
+}
+
+SpriteShader::SpriteShader(Variant)
+{}
+
+void SpriteShader::init()
+{
 	ShaderBase::init();
 
 	GET_U(spriteMat);
@@ -465,6 +499,34 @@ void SpriteShader::setBushOpacity(float value)
 }
 
 
+WaveSpriteShader::WaveSpriteShader()
+    : SpriteShader(Variant())
+{
+	INIT_SHADER(spriteWave, sprite, WaveSpriteShader);
+
+	SpriteShader::init();
+
+	GET_U(waveAmp);
+	GET_U(waveFreq);
+	GET_U(wavePhase);
+}
+
+void WaveSpriteShader::setWaveAmp(float value)
+{
+	gl.Uniform1f(u_waveAmp, value);
+}
+
+void WaveSpriteShader::setWaveFreq(float value)
+{
+	gl.Uniform1f(u_waveFreq, value);
+}
+
+void WaveSpriteShader::setWavePhase(float value)
+{
+	gl.Uniform1f(u_wavePhase, value);
+}
+
+
 PlaneShader::PlaneShader()
 {
 	INIT_SHADER(simple, plane, PlaneShader);
@@ -498,18 +560,30 @@ void PlaneShader::setOpacity(float value)
 }
 
 
-GrayShader::GrayShader()
+ViewportEffectShader::ViewportEffectShader()
 {
-	INIT_SHADER(simple, gray, GrayShader);
+	INIT_SHADER(simple, viewportEffect, ViewportEffectShader);
 
 	ShaderBase::init();
 
-	GET_U(gray);
+	GET_U(tone);
+	GET_U(color);
+	GET_U(flash);
+}
+
+void ViewportEffectShader::setTone(const Vec4 &value)
+{
+	setVec4Uniform(u_tone, value);
 }
 
-void GrayShader::setGray(float value)
+void ViewportEffectShader::setColor(const Vec4 &value)
 {
-	gl.Uniform1f(u_gray, value);
+	setVec4Uniform(u_color, value);
+}
+
+void ViewportEffectShader::setFlash(const Vec4 &value)
+{
+	setVec4Uniform(u_flash, value);
 }
 
 
@@ -608,6 +682,14 @@ BltShader::BltShader()
 {
 	INIT_SHADER(simple, bitmapBlit, BltShader);
 
+	init();
+}
+
+BltShader::BltShader(Variant)
+{}
+
+void BltShader::init()
+{
 	ShaderBase::init();
 
 	GET_U(source);
@@ -635,3 +717,38 @@ void BltShader::setOpacity(float value)
 {
 	gl.Uniform1f(u_opacity, value);
 }
+
+
+BltBatchShader::BltBatchShader()
+{
+	INIT_SHADER(simpleColor, bitmapBlitBatch, BltBatchShader);
+
+	ShaderBase::init();
+
+	GET_U(source);
+	GET_U(destination);
+	GET_U(destOrigin);
+	GET_U(destSizeInv);
+}
+
+void BltBatchShader::setSource()
+{
+	gl.Uniform1i(u_source, 0);
+}
+
+void BltBatchShader::setDestination(const TEX::ID value,
+                                    const Vec2i &origin, const Vec2i &size)
+{
+	setTexUniform(u_destination, 1, value);
+	gl.Uniform2f(u_destOrigin, origin.x, origin.y);
+	gl.Uniform2f(u_destSizeInv, 1.f / size.x, 1.f / size.y);
+}
+
+
+TextBltShader::TextBltShader()
+    : BltShader(Variant())
+{
+	INIT_SHADER(simple, textBlit, TextBltShader);
+
+	BltShader::init();
+}
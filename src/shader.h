@@ -78,13 +78,19 @@ public:
 	 * and loads it into the shaders uniform */
 	void applyViewportProj();
 
-	void setTexSize(const Vec2i &value);
+	/* 'origin' is the offset of the sampled image inside
+	 * the texture (non-zero for atlased bitmaps); shaders
+	 * that don't need it simply ignore it */
+	void setTexSize(const Vec2i &value, const Vec2i &origin = Vec2i());
 	void setTranslation(const Vec2i &value);
 
 protected:
 	void init();
 
-	GLint u_texSizeInv, u_translation;
+	GLint u_texSizeInv, u_texOrigin, u_translation;
+
+	/* Avoids a uniform update in the common (zero) case */
+	Vec2i texOrigin;
 };
 
 class FlatColorShader : public ShaderBase
@@ -121,6 +127,14 @@ public:
 	SimpleAlphaShader();
 };
 
+/* Draws glyph quads from the glyph cache's atlas,
+ * tinted with the vertex color */
+class GlyphShader : public ShaderBase
+{
+public:
+	GlyphShader();
+};
+
 class SimpleSpriteShader : public ShaderBase
 {
 public:
@@ -152,11 +166,14 @@ public:
 	void setCurrentScene(TEX::ID tex);
 	void setFrozenScene(TEX::ID tex);
 	void setTransMap(TEX::ID tex);
+	/* 'rect' is the area of the transition bitmap
+	 * inside a texture of 'texSize' */
+	void setTransMapRect(const Vec2i &texSize, const IntRect &rect);
 	void setProg(float value);
 	void setVague(float value);
 
 private:
-	GLint u_currentScene, u_frozenScene, u_transMap, u_prog, u_vague;
+	GLint u_currentScene, u_frozenScene, u_transMap, u_transMapRect, u_prog, u_vague;
 };
 
 class SimpleTransShader : public ShaderBase
@@ -184,10 +201,32 @@ public:
 	void setBushDepth(float value);
 	void setBushOpacity(float value);
 
+protected:
+	/* Used by variants that link their own program */
+	struct Variant {};
+	SpriteShader(Variant);
+
+	void init();
+
 private:
 	GLint u_spriteMat, u_tone, u_opacity, u_color, u_bushDepth, u_bushOpacity;
 };
 
+/* Sprite shader displacing a pre-tessellated
+ * strip horizontally for the wave effect */
+class WaveSpriteShader : public SpriteShader
+{
+public:
+	WaveSpriteShader();
+
+	void setWaveAmp(float value);
+	void setWaveFreq(float value);
+	void setWavePhase(float value);
+
+private:
+	GLint u_waveAmp, u_waveFreq, u_wavePhase;
+};
+
 class PlaneShader : public ShaderBase
 {
 public:
@@ -202,15 +241,17 @@ private:
 	GLint u_tone, u_color, u_flash, u_opacity;
 };
 
-class GrayShader : public ShaderBase
+class ViewportEffectShader : public ShaderBase
 {
 public:
-	GrayShader();
+	ViewportEffectShader();
 
-	void setGray(float value);
+	void setTone(const Vec4 &value);
+	void setColor(const Vec4 &value);
+	void setFlash(const Vec4 &value);
 
 private:
-	GLint u_gray;
+	GLint u_tone, u_color, u_flash;
 };
 
 class TilemapShader : public ShaderBase
@@ -299,10 +340,40 @@ public:
 	void setSubRect(const FloatRect &value);
 	void setOpacity(float value);
 
+protected:
+	/* Used by variants that link their own program */
+	struct Variant {};
+	BltShader(Variant);
+
+	void init();
+
 private:
 	GLint u_source, u_destination, u_subRect, u_opacity;
 };
 
+/* Blt shader for batched blits, see Bitmap::beginBatch().
+ * The destination is a copy of the target area starting
+ * at 'origin'; the opacity comes from the vertex color */
+class BltBatchShader : public ShaderBase
+{
+public:
+	BltBatchShader();
+
+	void setSource();
+	void setDestination(const TEX::ID value,
+	                    const Vec2i &origin, const Vec2i &size);
+
+private:
+	GLint u_source, u_destination, u_destOrigin, u_destSizeInv;
+};
+
+/* Blt shader for sources with premultiplied alpha */
+class TextBltShader : public BltShader
+{
+public:
+	TextBltShader();
+};
+
 /* Global object containing all available shaders */
 struct ShaderSet
 {
@@ -310,17 +381,21 @@ struct ShaderSet
 	SimpleShader simple;
 	SimpleColorShader simpleColor;
 	SimpleAlphaShader simpleAlpha;
+	GlyphShader glyph;
 	SimpleSpriteShader simpleSprite;
 	AlphaSpriteShader alphaSprite;
 	SpriteShader sprite;
+	WaveSpriteShader waveSprite;
 	PlaneShader plane;
-	GrayShader gray;
+	ViewportEffectShader viewportEffect;
 	TilemapShader tilemap;
 	FlashMapShader flashMap;
 	TransShader trans;
 	SimpleTransShader simpleTrans;
 	HueShader hue;
 	BltShader blt;
+	BltBatchShader bltBatch;
+	TextBltShader textBlt;
 	SimpleMatrixShader simpleMatrix;
 	BlurShader blur;
 	TilemapVXShader tilemapVX;
@@ -29,11 +29,19 @@
 #include "glstate.h"
 #include "shader.h"
 #include "texpool.h"
+#include "vram.h"
+#include "bitmapatlas.h"
+#include "glyphcache.h"
+#include "textlayoutcache.h"
+#include "imageloader.h"
+#include "frametrace.h"
 #include "font.h"
 #include "eventthread.h"
 #include "gl-util.h"
 #include "global-ibo.h"
 #include "quad.h"
+#include "spritebatch.h"
+#include "preparequeue.h"
 #include "binding.h"
 #include "exception.h"
 #include "sharedmidistate.h"
@@ -82,9 +90,15 @@ struct SharedStatePrivate
 	ShaderSet shaders;
 
 	TexPool texPool;
+	BitmapAtlas bitmapAtlas;
+	ImageLoader imageLoader;
+
+	FrameTrace frameTrace;
 
 	SharedFontState fontState;
 	Font *defaultFont;
+	GlyphCache glyphCache;
+	TextLayoutCache textLayoutCache;
 
 	TEX::ID globalTex;
 	int globalTexW, globalTexH;
@@ -96,7 +110,12 @@ struct SharedStatePrivate
 
 	Quad gpQuad;
 
+	SpriteBatch spriteBatch;
+
+	PrepareQueue prepareQueue;
+
 	unsigned int stampCounter;
+	unsigned int dirtyGen;
 
 	SharedStatePrivate(RGSSThreadData *threadData)
 	    : bindingData(0),
@@ -110,8 +129,15 @@ struct SharedStatePrivate
 	      input(*threadData),
 	      audio(*threadData),
 	      _glState(threadData->config),
+	      texPool(threadData->config),
+	      bitmapAtlas(threadData->config, _glState.caps.maxTexSize),
+	      imageLoader(threadData->config, fileSystem),
+	      frameTrace(threadData->config),
 	      fontState(threadData->config),
-	      stampCounter(0)
+	      glyphCache(_glState.caps.maxTexSize),
+	      textLayoutCache(threadData->config),
+	      stampCounter(0),
+	      dirtyGen(0)
 	{
 		/* Shaders have been compiled in ShaderSet's constructor */
 		if (gl.ReleaseShaderCompiler)
@@ -137,6 +163,8 @@ struct SharedStatePrivate
 
 		fileSystem.initFontSets(fontState);
 
+		VRAM::setBudget((size_t) std::max(config.vramBudget, 0) * 1024 * 1024);
+
 		globalTexW = 128;
 		globalTexH = 64;
 
@@ -144,12 +172,12 @@ struct SharedStatePrivate
 		TEX::bind(globalTex);
 		TEX::setRepeat(false);
 		TEX::setSmooth(false);
-		TEX::allocEmpty(globalTexW, globalTexH);
+		TEX::allocEmpty(globalTex, globalTexW, globalTexH, VRAM::Scratch);
 		globalTexDirty = false;
 
 		TEXFBO::init(gpTexFBO);
 		/* Reuse starting values */
-		TEXFBO::allocEmpty(gpTexFBO, globalTexW, globalTexH);
+		TEXFBO::allocEmpty(gpTexFBO, globalTexW, globalTexH, VRAM::Scratch);
 		TEXFBO::linkFBO(gpTexFBO);
 
 		/* RGSS3 games will call setup_midi, so there's
@@ -231,8 +259,15 @@ GSATT(Audio&, audio)
 GSATT(GLState&, _glState)
 GSATT(ShaderSet&, shaders)
 GSATT(TexPool&, texPool)
+GSATT(BitmapAtlas&, bitmapAtlas)
+GSATT(ImageLoader&, imageLoader)
+GSATT(FrameTrace&, frameTrace)
 GSATT(Quad&, gpQuad)
+GSATT(SpriteBatch&, spriteBatch)
+GSATT(PrepareQueue&, prepareQueue)
 GSATT(SharedFontState&, fontState)
+GSATT(GlyphCache&, glyphCache)
+GSATT(TextLayoutCache&, textLayoutCache)
 GSATT(SharedMidiState&, midiState)
 
 void SharedState::setBindingData(void *data)
@@ -256,7 +291,7 @@ void SharedState::bindTex()
 
 	if (p->globalTexDirty)
 	{
-		TEX::allocEmpty(p->globalTexW, p->globalTexH);
+		TEX::allocEmpty(p->globalTex, p->globalTexW, p->globalTexH, VRAM::Scratch);
 		p->globalTexDirty = false;
 	}
 }
@@ -284,20 +319,20 @@ TEXFBO &SharedState::gpTexFBO(int minW, int minH)
 
 	if (minW > p->gpTexFBO.width)
 	{
-		p->gpTexFBO.width = findNextPow2(minW);
+		p->gpTexFBO.width = p->gpTexFBO.texWidth = findNextPow2(minW);
 		needResize = true;
 	}
 
 	if (minH > p->gpTexFBO.height)
 	{
-		p->gpTexFBO.height = findNextPow2(minH);
+		p->gpTexFBO.height = p->gpTexFBO.texHeight = findNextPow2(minH);
 		needResize = true;
 	}
 
 	if (needResize)
 	{
 		TEX::bind(p->gpTexFBO.tex);
-		TEX::allocEmpty(p->gpTexFBO.width, p->gpTexFBO.height);
+		TEX::allocEmpty(p->gpTexFBO.tex, p->gpTexFBO.width, p->gpTexFBO.height, VRAM::Scratch);
 	}
 
 	return p->gpTexFBO;
@@ -315,7 +350,7 @@ void SharedState::requestAtlasTex(int w, int h, TEXFBO &out)
 	else
 	{
 		TEXFBO::init(tex);
-		TEXFBO::allocEmpty(tex, w, h);
+		TEXFBO::allocEmpty(tex, w, h, VRAM::Tilemaps);
 		TEXFBO::linkFBO(tex);
 	}
 
@@ -362,6 +397,16 @@ unsigned int SharedState::genTimeStamp()
 	return p->stampCounter++;
 }
 
+void SharedState::markDirty()
+{
+	++p->dirtyGen;
+}
+
+unsigned int SharedState::dirtyGeneration() const
+{
+	return p->dirtyGen;
+}
+
 SharedState::SharedState(RGSSThreadData *threadData)
 {
 	p = new SharedStatePrivate(threadData);
@@ -34,6 +34,8 @@ struct GlobalIBO;
 struct SDL_Window;
 struct TEXFBO;
 struct Quad;
+class SpriteBatch;
+class PrepareQueue;
 struct ShaderSet;
 
 class Scene;
@@ -44,6 +46,11 @@ class Input;
 class Audio;
 class GLState;
 class TexPool;
+class BitmapAtlas;
+class GlyphCache;
+class TextLayoutCache;
+class ImageLoader;
+class FrameTrace;
 class Font;
 class SharedFontState;
 struct GlobalIBO;
@@ -76,16 +83,30 @@ struct SharedState
 	ShaderSet &shaders() const;
 
 	TexPool &texPool() const;
+	BitmapAtlas &bitmapAtlas() const;
+	ImageLoader &imageLoader() const;
+
+	FrameTrace &frameTrace() const;
 
 	SharedFontState &fontState() const;
 	Font &defaultFont() const;
+	GlyphCache &glyphCache() const;
+	TextLayoutCache &textLayoutCache() const;
 
 	SharedMidiState &midiState() const;
 
-	sigc::signal<void> prepareDraw;
+	PrepareQueue &prepareQueue() const;
 
 	unsigned int genTimeStamp();
 
+	/* Generation counter of the rendered screen contents.
+	 * Anything that changes what ends up on screen (including
+	 * animation steps) must call markDirty(); if the generation
+	 * hasn't moved since the last frame, Graphics re-presents
+	 * that frame instead of compositing it again */
+	void markDirty();
+	unsigned int dirtyGeneration() const;
+
 	/* Returns global quad IBO, and ensures it has indices
 	 * for at least minSize quads */
 	void ensureQuadIBO(size_t minSize);
@@ -98,6 +119,7 @@ struct SharedState
 	TEXFBO &gpTexFBO(int minW, int minH);
 
 	Quad &gpQuad() const;
+	SpriteBatch &spriteBatch() const;
 
 	/* Basically just a simple "TexPool"
 	 * replacement for Tilemap atlas use */
@@ -33,6 +33,8 @@
 #include "shader.h"
 #include "glstate.h"
 #include "quadarray.h"
+#include "spritebatch.h"
+#include "preparequeue.h"
 
 #include <math.h>
 #ifndef M_PI
@@ -43,7 +45,7 @@
 
 #include <sigc++/connection.h>
 
-struct SpritePrivate
+struct SpritePrivate : public Preparable
 {
 	Bitmap *bitmap;
 
@@ -79,6 +81,8 @@ struct SpritePrivate
 
 		/* Wave effect is active (amp != 0) */
 		bool active;
+		/* qArray is displaced by the wave shader (amp > 0) */
+		bool displaced;
 		/* qArray needs updating */
 		bool dirty;
 		SimpleQuadArray qArray;
@@ -86,8 +90,6 @@ struct SpritePrivate
 
 	EtcTemps tmp;
 
-	sigc::connection prepareCon;
-
 	SpritePrivate()
 	    : bitmap(0),
 	      srcRect(&tmp.rect),
@@ -106,20 +108,18 @@ struct SpritePrivate
 
 		updateSrcRectCon();
 
-		prepareCon = shState->prepareDraw.connect
-		        (sigc::mem_fun(this, &SpritePrivate::prepare));
-
 		wave.amp = 0;
 		wave.length = 180;
 		wave.speed = 360;
 		wave.phase = 0.0f;
+		wave.active = false;
+		wave.displaced = false;
 		wave.dirty = false;
 	}
 
 	~SpritePrivate()
 	{
 		srcRectCon.disconnect();
-		prepareCon.disconnect();
 	}
 
 	void recomputeBushDepth()
@@ -135,6 +135,64 @@ struct SpritePrivate
 		efBushDepth = 1.0f - texBushDepth / bitmap->height();
 	}
 
+	/* The shader compares bush depth against coordinates
+	 * normalized to the backing texture, which differs
+	 * from the bitmap for atlased ones */
+	float texBushDepth() const
+	{
+		const TEXFBO &tex = bitmap->backingTex();
+		const Vec2i orig = bitmap->texOrigin();
+
+		if (orig.y == 0 && tex.texHeight == bitmap->height())
+			return efBushDepth;
+
+		return (efBushDepth * bitmap->height() + orig.y) / tex.texHeight;
+	}
+
+	/* Mega bitmaps are drawn one tile at a time, each
+	 * quad covering the tile's part of the source rect */
+	void drawMega(ShaderBase &shader, SpriteShader *bushShader)
+	{
+		IntRect src(srcRect->x, srcRect->y,
+		            clamp<int>(srcRect->width, 0, bitmap->width() - srcRect->x),
+		            clamp<int>(srcRect->height, 0, bitmap->height() - srcRect->y));
+
+		Quad &quad = shState->gpQuad();
+		quad.setColor(Vec4(1, 1, 1, 1));
+
+		for (size_t i = 0; i < bitmap->megaTileCount(); ++i)
+		{
+			const IntRect tileRect = bitmap->megaTileRect(i);
+			IntRect part;
+
+			if (!SDL_IntersectRect(&src, &tileRect, &part))
+				continue;
+
+			FloatRect texRect(part.x - tileRect.x, part.y - tileRect.y, part.w, part.h);
+			FloatRect posRect(part.x - src.x, part.y - src.y, part.w, part.h);
+
+			if (mirrored)
+			{
+				texRect = texRect.hFlipped();
+				posRect.x = src.w - (posRect.x + posRect.w);
+			}
+
+			Bitmap &tile = bitmap->megaTile(i);
+			tile.bindTex(shader);
+
+			if (bushShader)
+			{
+				const TEXFBO &tex = tile.backingTex();
+				float bushY = efBushDepth * bitmap->height() - tileRect.y;
+
+				bushShader->setBushDepth((bushY + tile.texOrigin().y) / tex.texHeight);
+			}
+
+			quad.setTexPosRect(texRect, posRect);
+			quad.draw();
+		}
+	}
+
 	void onSrcRectChange()
 	{
 		FloatRect rect = srcRect->toFloatRect();
@@ -154,6 +212,7 @@ struct SpritePrivate
 		recomputeBushDepth();
 
 		wave.dirty = true;
+		schedulePrepare();
 	}
 
 	void updateSrcRectCon()
@@ -202,15 +261,14 @@ struct SpritePrivate
 		isVisible = SDL_HasIntersection(&self, &sceneRect);
 	}
 
-	void emitWaveChunk(SVertex *&vert, float phase, int width,
+	/* The horizontal displacement is applied by the wave
+	 * shader, so the chunk's position only carries the
+	 * row its wave offset is computed from */
+	void emitWaveChunk(SVertex *&vert, int width,
 	                   float zoomY, int chunkY, int chunkLength)
 	{
-		float wavePos = phase + (chunkY / (float) wave.length) * (float) (M_PI * 2);
-		float chunkX = sin(wavePos) * wave.amp;
-
 		FloatRect tex(0, chunkY / zoomY, width, chunkLength / zoomY);
-		FloatRect pos = tex;
-		pos.x = chunkX;
+		FloatRect pos(0, chunkY, width, 0);
 
 		Quad::setTexPosRect(vert, tex, pos);
 		vert += 4;
@@ -221,13 +279,11 @@ struct SpritePrivate
 		if (nullOrDisposed(bitmap))
 			return;
 
-		if (wave.amp == 0)
-		{
-			wave.active = false;
-			return;
-		}
+		wave.active = (wave.amp != 0);
+		wave.displaced = (wave.amp > 0);
 
-		wave.active = true;
+		if (!wave.active)
+			return;
 
 		int width = srcRect->width;
 		int height = srcRect->height;
@@ -272,20 +328,34 @@ struct SpritePrivate
 		wave.qArray.resize(!!firstLength + chunks + !!lastLength);
 		SVertex *vert = &wave.qArray.vertices[0];
 
-		float phase = (wave.phase * (float) M_PI) / 180.0f;
-
 		if (firstLength > 0)
-			emitWaveChunk(vert, phase, width, zoomY, 0, firstLength);
+			emitWaveChunk(vert, width, zoomY, 0, firstLength);
 
 		for (int i = 0; i < chunks; ++i)
-			emitWaveChunk(vert, phase, width, zoomY, firstLength + i * 8, 8);
+			emitWaveChunk(vert, width, zoomY, firstLength + i * 8, 8);
 
 		if (lastLength > 0)
-			emitWaveChunk(vert, phase, width, zoomY, firstLength + chunks * 8, lastLength);
+			emitWaveChunk(vert, width, zoomY, firstLength + chunks * 8, lastLength);
 
 		wave.qArray.commit();
 	}
 
+	bool hasRenderEffect(bool flashing) const
+	{
+		return color->hasEffect() ||
+		       tone->hasEffect()  ||
+		       flashing           ||
+		       bushDepth != 0;
+	}
+
+	/* Visibility and wave vertices only change
+	 * along with the sprite's own state */
+	void onStateChange()
+	{
+		schedulePrepare();
+		shState->markDirty();
+	}
+
 	void prepare()
 	{
 		if (wave.dirty)
@@ -328,11 +398,11 @@ DEF_ATTR_RD_SIMPLE(Sprite, WaveLength, int,     p->wave.length)
 DEF_ATTR_RD_SIMPLE(Sprite, WaveSpeed,  int,     p->wave.speed)
 DEF_ATTR_RD_SIMPLE(Sprite, WavePhase,  float,   p->wave.phase)
 
-DEF_ATTR_SIMPLE(Sprite, BushOpacity, int,     p->bushOpacity)
-DEF_ATTR_SIMPLE(Sprite, Opacity,     int,     p->opacity)
-DEF_ATTR_SIMPLE(Sprite, SrcRect,     Rect&,  *p->srcRect)
-DEF_ATTR_SIMPLE(Sprite, Color,       Color&, *p->color)
-DEF_ATTR_SIMPLE(Sprite, Tone,        Tone&,  *p->tone)
+DEF_ATTR_NOTIFY(Sprite, BushOpacity, int,     p->bushOpacity, shState->markDirty())
+DEF_ATTR_NOTIFY(Sprite, Opacity,     int,     p->opacity,     p->onStateChange())
+DEF_ATTR_NOTIFY(Sprite, SrcRect,     Rect&,  *p->srcRect,     shState->markDirty())
+DEF_ATTR_NOTIFY(Sprite, Color,       Color&, *p->color,       shState->markDirty())
+DEF_ATTR_NOTIFY(Sprite, Tone,        Tone&,  *p->tone,        shState->markDirty())
 
 void Sprite::setBitmap(Bitmap *bitmap)
 {
@@ -342,12 +412,11 @@ void Sprite::setBitmap(Bitmap *bitmap)
 		return;
 
 	p->bitmap = bitmap;
+	p->onStateChange();
 
 	if (nullOrDisposed(bitmap))
 		return;
 
-	bitmap->ensureNonMega();
-
 	*p->srcRect = bitmap->rect();
 	p->onSrcRectChange();
 	p->quad.setPosRect(p->srcRect->toFloatRect());
@@ -363,6 +432,8 @@ void Sprite::setX(int value)
 		return;
 
 	p->trans.setPosition(Vec2(value, getY()));
+
+	p->onStateChange();
 }
 
 void Sprite::setY(int value)
@@ -379,6 +450,8 @@ void Sprite::setY(int value)
 		p->wave.dirty = true;
 		setSpriteY(value);
 	}
+
+	p->onStateChange();
 }
 
 void Sprite::setOX(int value)
@@ -389,6 +462,8 @@ void Sprite::setOX(int value)
 		return;
 
 	p->trans.setOrigin(Vec2(value, getOY()));
+
+	p->onStateChange();
 }
 
 void Sprite::setOY(int value)
@@ -399,6 +474,8 @@ void Sprite::setOY(int value)
 		return;
 
 	p->trans.setOrigin(Vec2(getOX(), value));
+
+	p->onStateChange();
 }
 
 void Sprite::setZoomX(float value)
@@ -409,6 +486,8 @@ void Sprite::setZoomX(float value)
 		return;
 
 	p->trans.setScale(Vec2(value, getZoomY()));
+
+	p->onStateChange();
 }
 
 void Sprite::setZoomY(float value)
@@ -423,6 +502,8 @@ void Sprite::setZoomY(float value)
 
 	if (rgssVer >= 2)
 		p->wave.dirty = true;
+
+	p->onStateChange();
 }
 
 void Sprite::setAngle(float value)
@@ -433,6 +514,8 @@ void Sprite::setAngle(float value)
 		return;
 
 	p->trans.setRotation(value);
+
+	p->onStateChange();
 }
 
 void Sprite::setMirror(bool mirrored)
@@ -444,6 +527,8 @@ void Sprite::setMirror(bool mirrored)
 
 	p->mirrored = mirrored;
 	p->onSrcRectChange();
+
+	shState->markDirty();
 }
 
 void Sprite::setBushDepth(int value)
@@ -455,12 +540,16 @@ void Sprite::setBushDepth(int value)
 
 	p->bushDepth = value;
 	p->recomputeBushDepth();
+
+	shState->markDirty();
 }
 
 void Sprite::setBlendType(int type)
 {
 	guardDisposed();
 
+	shState->markDirty();
+
 	switch (type)
 	{
 	default :
@@ -476,6 +565,31 @@ void Sprite::setBlendType(int type)
 	}
 }
 
+void Sprite::setWaveAmp(int value)
+{
+	guardDisposed();
+
+	if (p->wave.amp == value)
+		return;
+
+	/* A positive amplitude only feeds the wave shader,
+	 * the strip itself stays the same */
+	bool retessellate = (p->wave.amp <= 0 || value <= 0);
+
+	p->wave.amp = value;
+
+	if (retessellate)
+	{
+		p->wave.dirty = true;
+		p->onStateChange();
+	}
+	else
+	{
+		shState->markDirty();
+	}
+}
+
+/* These are only read by the wave shader at draw time */
 #define DEF_WAVE_SETTER(Name, name, type) \
 	void Sprite::setWave##Name(type value) \
 	{ \
@@ -483,10 +597,9 @@ void Sprite::setBlendType(int type)
 		if (p->wave.name == value) \
 			return; \
 		p->wave.name = value; \
-		p->wave.dirty = true; \
+		shState->markDirty(); \
 	}
 
-DEF_WAVE_SETTER(Amp,    amp,    int)
 DEF_WAVE_SETTER(Length, length, int)
 DEF_WAVE_SETTER(Speed,  speed,  int)
 DEF_WAVE_SETTER(Phase,  phase,  float)
@@ -510,7 +623,11 @@ void Sprite::update()
 	Flashable::update();
 
 	p->wave.phase += p->wave.speed / 180;
-	p->wave.dirty = true;
+
+	/* Only a displaced wave animates, and
+	 * it does so entirely in the wave shader */
+	if (p->wave.amp > 0 && p->wave.speed != 0)
+		shState->markDirty();
 }
 
 /* SceneElement */
@@ -519,27 +636,47 @@ void Sprite::draw()
 	if (!p->isVisible)
 		return;
 
+	/* Disposing the bitmap doesn't schedule a prepare */
+	if (p->bitmap->isDisposed())
+		return;
+
 	if (emptyFlashFlag)
 		return;
 
 	ShaderBase *base;
+	SpriteShader *bushShader = 0;
 
-	bool renderEffect = p->color->hasEffect() ||
-	                    p->tone->hasEffect()  ||
-	                    flashing              ||
-	                    p->bushDepth != 0;
+	bool renderEffect = p->hasRenderEffect(flashing);
+	bool waveShaded = p->wave.active && p->wave.displaced && !p->bitmap->isMega();
 
-	if (renderEffect)
+	if (renderEffect || waveShaded)
 	{
-		SpriteShader &shader = shState->shaders().sprite;
+		SpriteShader *spriteShader = &shState->shaders().sprite;
+
+		if (waveShaded)
+		{
+			WaveSpriteShader &waveShader = shState->shaders().waveSprite;
+			waveShader.bind();
+
+			waveShader.setWaveAmp(p->wave.amp);
+			waveShader.setWaveFreq((float) (M_PI * 2) / p->wave.length);
+			waveShader.setWavePhase((p->wave.phase * (float) M_PI) / 180.0f);
+
+			spriteShader = &waveShader;
+		}
+		else
+		{
+			spriteShader->bind();
+		}
+
+		SpriteShader &shader = *spriteShader;
 
-		shader.bind();
 		shader.applyViewportProj();
 		shader.setSpriteMat(p->trans.getMatrix());
 
 		shader.setTone(p->tone->norm);
 		shader.setOpacity(p->opacity.norm);
-		shader.setBushDepth(p->efBushDepth);
+		shader.setBushDepth(p->texBushDepth());
 		shader.setBushOpacity(p->bushOpacity.norm);
 
 		/* When both flashing and effective color are set,
@@ -550,6 +687,7 @@ void Sprite::draw()
 		shader.setColor(*blend);
 
 		base = &shader;
+		bushShader = &shader;
 	}
 	else if (p->opacity != 255)
 	{
@@ -573,16 +711,58 @@ void Sprite::draw()
 
 	glState.blendMode.pushSet(p->blendType);
 
-	p->bitmap->bindTex(*base);
-
-	if (p->wave.active)
-		p->wave.qArray.draw();
+	if (p->bitmap->isMega())
+	{
+		/* Waves aren't applied to mega bitmaps */
+		p->drawMega(*base, bushShader);
+	}
 	else
-		p->quad.draw();
+	{
+		p->bitmap->bindTex(*base);
+
+		if (p->wave.active)
+			p->wave.qArray.draw();
+		else
+			p->quad.draw();
+	}
 
 	glState.blendMode.pop();
 }
 
+bool Sprite::drawBatched(SpriteBatch &batch)
+{
+	/* Nothing to draw, nothing to flush for */
+	if (!p->isVisible || p->bitmap->isDisposed())
+		return true;
+
+	if (emptyFlashFlag)
+		return true;
+
+	if (p->wave.active || p->hasRenderEffect(flashing) || p->bitmap->isMega())
+		return false;
+
+	/* Apply the sprite matrix on the CPU so
+	 * the quad can share a draw call */
+	const float *mat = p->trans.getMatrix();
+	const Vec2i texOrig = p->bitmap->texOrigin();
+	Vertex vert[4];
+
+	for (int i = 0; i < 4; ++i)
+	{
+		const Vec2 &pos = p->quad.vert[i].pos;
+		const Vec2 &texPos = p->quad.vert[i].texPos;
+
+		vert[i].pos = Vec2(mat[0] * pos.x + mat[4] * pos.y + mat[12],
+		                   mat[1] * pos.x + mat[5] * pos.y + mat[13]);
+		vert[i].texPos = Vec2(texPos.x + texOrig.x, texPos.y + texOrig.y);
+		vert[i].color = Vec4(1, 1, 1, p->opacity.norm);
+	}
+
+	batch.add(*p->bitmap, p->blendType, vert);
+
+	return true;
+}
+
 void Sprite::onGeometryChange(const Scene::Geometry &geo)
 {
 	/* Offset at which the sprite will be drawn
@@ -591,6 +771,8 @@ void Sprite::onGeometryChange(const Scene::Geometry &geo)
 
 	p->sceneRect.setSize(geo.rect.size());
 	p->sceneOrig = geo.orig;
+
+	p->schedulePrepare();
 }
 
 void Sprite::releaseResources()
@@ -73,6 +73,7 @@ private:
 	SpritePrivate *p;
 
 	void draw();
+	bool drawBatched(SpriteBatch &batch);
 	void onGeometryChange(const Scene::Geometry &);
 
 	void releaseResources();
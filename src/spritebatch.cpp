@@ -0,0 +1,110 @@
+/*
+** spritebatch.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "spritebatch.h"
+
+#include "sharedstate.h"
+#include "global-ibo.h"
+#include "glstate.h"
+#include "shader.h"
+#include "bitmap.h"
+#include "frametrace.h"
+#include "util.h"
+
+/* Vertex indices have to fit into index_t */
+#define MAX_QUADS 4096
+
+SpriteBatch::SpriteBatch()
+    : blendType(BlendNormal)
+{
+	vbo = VBO::gen();
+
+	GLMeta::vaoFillInVertexData<Vertex>(vao);
+	vao.vbo = vbo;
+	vao.ibo = shState->globalIBO().ibo;
+
+	GLMeta::vaoInit(vao);
+
+	vertices.reserve(64 * 4);
+}
+
+SpriteBatch::~SpriteBatch()
+{
+	GLMeta::vaoFini(vao);
+	VBO::del(vbo);
+}
+
+void SpriteBatch::add(const Bitmap &bitmap, BlendType blendType,
+                      const Vertex vert[4])
+{
+	const TEXFBO &tex = bitmap.backingTex();
+
+	if (tex.tex != this->tex.tex || blendType != this->blendType ||
+	    vertices.size() == MAX_QUADS * 4)
+	{
+		flush();
+
+		this->tex = tex;
+		this->blendType = blendType;
+	}
+
+	vertices.insert(vertices.end(), vert, vert + 4);
+}
+
+void SpriteBatch::flush()
+{
+	if (vertices.empty())
+		return;
+
+	const size_t quadCount = vertices.size() / 4;
+
+	TraceScope scope(shState->frameTrace(), "SpriteBatch::flush",
+	                 "quads", (int) quadCount);
+
+	shState->ensureQuadIBO(quadCount);
+
+	/* Respecify the whole buffer every time so the driver
+	 * can hand out fresh storage instead of waiting for
+	 * the previous batch's draw to finish */
+	VBO::bind(vbo);
+	VBO::uploadData(vertices.size() * sizeof(Vertex),
+	                dataPtr(vertices), GL_STREAM_DRAW);
+	VBO::unbind();
+
+	SimpleAlphaShader &shader = shState->shaders().simpleAlpha;
+	shader.bind();
+	shader.applyViewportProj();
+	shader.setTranslation(Vec2i());
+
+	TEX::bind(tex.tex);
+	shader.setTexSize(Vec2i(tex.texWidth, tex.texHeight));
+
+	glState.blendMode.pushSet(blendType);
+
+	GLMeta::vaoBind(vao);
+	gl.DrawElements(GL_TRIANGLES, quadCount * 6, _GL_INDEX_TYPE, 0);
+	GLMeta::vaoUnbind(vao);
+
+	glState.blendMode.pop();
+
+	vertices.clear();
+	TEXFBO::clear(tex);
+}
@@ -0,0 +1,67 @@
+/*
+** spritebatch.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPRITEBATCH_H
+#define SPRITEBATCH_H
+
+#include "vertex.h"
+#include "gl-util.h"
+#include "gl-meta.h"
+#include "etc.h"
+#include "etc-internal.h"
+
+#include <vector>
+
+class Bitmap;
+
+/* Collects quads of consecutive scene elements that sample the
+ * same texture with the same blend type and need nothing beyond
+ * per-vertex opacity, and draws them from one streamed VBO in a
+ * single call. Vertex positions are expected in scene space,
+ * texture coordinates relative to the bitmap's backing texture
+ * (ie. including its atlas offset) */
+class SpriteBatch
+{
+public:
+	SpriteBatch();
+	~SpriteBatch();
+
+	/* Pending quads are flushed first if they
+	 * were queued with a different texture or
+	 * blend type */
+	void add(const Bitmap &bitmap, BlendType blendType,
+	         const Vertex vert[4]);
+
+	/* Draws all pending quads. Has to be called before
+	 * anything else is drawn into the current target */
+	void flush();
+
+private:
+	std::vector<Vertex> vertices;
+
+	VBO::ID vbo;
+	GLMeta::VAO vao;
+
+	TEXFBO tex;
+	BlendType blendType;
+};
+
+#endif // SPRITEBATCH_H
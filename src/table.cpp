@@ -26,17 +26,20 @@
 
 #include "serial-util.h"
 #include "exception.h"
+#include "sharedstate.h"
 #include "util.h"
 
 /* Init normally */
 Table::Table(int x, int y /*= 1*/, int z /*= 1*/)
     : xs(x), ys(y), zs(z),
-      data(x*y*z)
+      data(x*y*z),
+      dirty(z)
 {}
 
 Table::Table(const Table &other)
     : xs(other.xs), ys(other.ys), zs(other.zs),
-      data(other.data)
+      data(other.data),
+      dirty(other.zs)
 {}
 
 int16_t Table::get(int x, int y, int z) const
@@ -53,9 +56,14 @@ void Table::set(int16_t value, int x, int y, int z)
 		return;
 	}
 
-	data[xs*ys*z + xs*y + x] = value;
+	int16_t &cell = data[xs*ys*z + xs*y + x];
 
-	modified();
+	if (cell == value)
+		return;
+
+	cell = value;
+
+	markDirty(IntRect(x, y, 1, 1), z);
 }
 
 void Table::resize(int x, int y, int z)
@@ -76,7 +84,11 @@ void Table::resize(int x, int y, int z)
 	ys = y;
 	zs = z;
 
-	return;
+	/* Cells moved around, so all of them count as written */
+	dirty.assign(zs, IntRect());
+
+	for (int k = 0; k < zs; ++k)
+		markDirty(IntRect(0, 0, xs, ys), k);
 }
 
 void Table::resize(int x, int y)
@@ -89,6 +101,77 @@ void Table::resize(int x)
 	resize(x, ys, zs);
 }
 
+IntRect Table::dirtyRect(int z) const
+{
+	return dirty[z];
+}
+
+IntRect Table::dirtyArea() const
+{
+	int x1 = xs, y1 = ys, x2 = 0, y2 = 0;
+
+	for (size_t k = 0; k < dirty.size(); ++k)
+	{
+		const IntRect &rect = dirty[k];
+
+		if (rect.w == 0)
+			continue;
+
+		x1 = std::min<int>(x1, rect.x);
+		y1 = std::min<int>(y1, rect.y);
+		x2 = std::max<int>(x2, rect.x + rect.w);
+		y2 = std::max<int>(y2, rect.y + rect.h);
+	}
+
+	if (x1 >= x2 || y1 >= y2)
+		return IntRect();
+
+	return IntRect(x1, y1, x2 - x1, y2 - y1);
+}
+
+void Table::commit()
+{
+	if (dirtyArea().w == 0)
+		return;
+
+	modified();
+
+	dirty.assign(zs, IntRect());
+}
+
+void Table::prepare()
+{
+	commit();
+}
+
+void Table::markDirty(const IntRect &rect, int z)
+{
+	IntRect &box = dirty[z];
+
+	if (box.w == 0)
+	{
+		box = rect;
+	}
+	else
+	{
+		const int x2 = std::max<int>(box.x + box.w, rect.x + rect.w);
+		const int y2 = std::max<int>(box.y + box.h, rect.y + rect.h);
+
+		box.x = std::min<int>(box.x, rect.x);
+		box.y = std::min<int>(box.y, rect.y);
+		box.w = x2 - box.x;
+		box.h = y2 - box.y;
+	}
+
+	/* Nobody to notify */
+	if (modified.empty())
+		return;
+
+	/* Ahead of the tilemaps reacting to it */
+	schedulePrepare(true);
+	shState->markDirty();
+}
+
 /* Serializable */
 int Table::serialSize() const
 {
@@ -23,12 +23,17 @@
 #define TABLE_H
 
 #include "serializable.h"
+#include "preparequeue.h"
+#include "etc-internal.h"
 
 #include <stdint.h>
 #include <sigc++/signal.h>
 #include <vector>
 
-class Table : public Serializable
+/* Writes are collected into a dirty rectangle per layer, and
+ * 'modified' is emitted at most once per frame for all of them
+ * (before the screen is composited), or on commit() */
+class Table : public Serializable, public Preparable
 {
 public:
 	Table(int x, int y = 1, int z = 1);
@@ -47,6 +52,17 @@ public:
 	void resize(int x, int y);
 	void resize(int x);
 
+	/* Bounding box of the cells written to in layer 'z'
+	 * since the last commit (empty if there are none) */
+	IntRect dirtyRect(int z) const;
+
+	/* Bounding box of the written cells over all layers */
+	IntRect dirtyArea() const;
+
+	/* Emits 'modified' if any cells were written
+	 * since the last commit, and forgets about them */
+	void commit();
+
 	int serialSize() const;
 	void serialize(char *buffer) const;
 	static Table *deserialize(const char *data, int len);
@@ -62,11 +78,19 @@ public:
 		return data[xs*ys*z + xs*y + x];
 	}
 
+	/* Handlers can query the written cells via dirtyRect() */
 	sigc::signal<void> modified;
 
+	void prepare();
+
 private:
+	void markDirty(const IntRect &rect, int z);
+
 	int xs, ys, zs;
 	std::vector<int16_t> data;
+
+	/* One per layer */
+	std::vector<IntRect> dirty;
 };
 
 #endif // TABLE_H
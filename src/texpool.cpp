@@ -21,125 +21,220 @@
 
 #include "texpool.h"
 #include "exception.h"
+#include "config.h"
 #include "sharedstate.h"
 #include "glstate.h"
 #include "boost-hash.h"
-#include "debugwriter.h"
+#include "intrulist.h"
+#include "util.h"
+#include "vram.h"
 
-#include <list>
 #include <utility>
 #include <assert.h>
-#include <string.h>
 
 typedef std::pair<uint16_t, uint16_t> Size;
 
-static uint32_t byteCount(Size &s)
+static size_t byteCount(const Size &s)
 {
-	return s.first * s.second * 4;
+	return (size_t) s.first * s.second * 4;
 }
 
-struct CacheNode
+struct PoolNode
 {
 	TEXFBO obj;
-	std::list<TEXFBO>::iterator prioIter;
 
-	bool operator==(const CacheNode &o) const
-	{
-		return obj == o.obj;
-	}
+	/* Position in release order, and in the bucket of
+	 * textures of the same (allocated) size */
+	IntruListLink<PoolNode> prioLink;
+	IntruListLink<PoolNode> bucketLink;
+
+	PoolNode(const TEXFBO &obj)
+	    : obj(obj),
+	      prioLink(this),
+	      bucketLink(this)
+	{}
 };
 
-typedef std::list<CacheNode> CNodeList;
+typedef IntruList<PoolNode> NodeList;
 
 struct TexPoolPrivate
 {
-	/* Contains all cached TexFBOs, grouped by size */
-	BoostHash<Size, CNodeList> poolHash;
+	/* Contains all cached TexFBOs, grouped by allocated size,
+	 * most recently released first */
+	BoostHash<Size, NodeList*> poolHash;
 
 	/* Contains all cached TexFBOs, sorted by release time */
-	std::list<TEXFBO> priorityQueue;
+	NodeList priorityQueue;
 
 	/* Maximal allowed cache memory */
-	const uint32_t maxMemSize;
+	const size_t maxMemSize;
 
-	/* Current amound of memory consumed by the cache */
-	uint32_t memSize;
+	/* Round requests up to size classes */
+	const bool sizeClasses;
 
-	/* Current amount of TexFBOs cached */
-	uint16_t objCount;
+	/* Current amount of memory consumed by the cache */
+	size_t memSize;
 
 	/* Has this pool been disabled? */
 	bool disabled;
 
-	TexPoolPrivate(uint32_t maxMemSize)
-	    : maxMemSize(maxMemSize),
+	TexPool::Stats stats;
+
+	TexPoolPrivate(const Config &conf)
+	    : maxMemSize((size_t) std::max(conf.texturePoolSize, 0) * 1024 * 1024),
+	      sizeClasses(conf.texturePoolSizeClasses),
 	      memSize(0),
-	      objCount(0),
 	      disabled(false)
-	{}
+	{
+		stats = TexPool::Stats();
+	}
+
+	NodeList &bucket(const Size &size)
+	{
+		NodeList *&list = poolHash[size];
+
+		if (!list)
+			list = new NodeList;
+
+		return *list;
+	}
+
+	/* Takes 'node' out of the pool and frees it,
+	 * returning the texture it held */
+	TEXFBO take(PoolNode *node)
+	{
+		TEXFBO obj = node->obj;
+
+		priorityQueue.remove(node->prioLink);
+		bucket(Size(obj.texWidth, obj.texHeight)).remove(node->bucketLink);
+
+		memSize -= byteCount(Size(obj.texWidth, obj.texHeight));
+		stats.count--;
+
+		delete node;
+
+		return obj;
+	}
+
+	/* Deletes least recently released objects until
+	 * 'bytes' are freed or the pool is empty */
+	void evict(size_t bytes)
+	{
+		size_t freed = 0;
+
+		while (freed < bytes && !priorityQueue.isEmpty())
+		{
+			TEXFBO last = take(priorityQueue.tail());
+			freed += byteCount(Size(last.texWidth, last.texHeight));
+			TEXFBO::fini(last);
+
+			stats.evictions++;
+		}
+	}
+
+	/* Clears the part of 'obj' outside of its logical size,
+	 * so samplers straying past the bitmap's edge don't pick
+	 * up a previous user's pixels */
+	static void clearMargin(TEXFBO &obj)
+	{
+		if (obj.width == obj.texWidth && obj.height == obj.texHeight)
+			return;
+
+		FBO::bind(obj.fbo);
+
+		glState.clearColor.pushSet(Vec4());
+		glState.scissorTest.pushSet(true);
+
+		/* Right strip, then the bottom one below the bitmap */
+		glState.scissorBox.pushSet(IntRect(obj.width, 0, obj.texWidth - obj.width, obj.texHeight));
+		FBO::clear();
+		glState.scissorBox.set(IntRect(0, obj.height, obj.width, obj.texHeight - obj.height));
+		FBO::clear();
+		glState.scissorBox.pop();
+
+		glState.scissorTest.pop();
+		glState.clearColor.pop();
+	}
+
+	/* Steps of an eighth of the next power of two, so
+	 * at most ~25% of each dimension goes unused */
+	static int sizeClass(int value, int maxSize)
+	{
+		const int step = std::max(findNextPow2(value) / 8, 16);
+		const int rounded = (value + step - 1) / step * step;
+
+		return rounded <= maxSize ? rounded : value;
+	}
 };
 
-TexPool::TexPool(uint32_t maxMemSize)
+TexPool::TexPool(const Config &conf)
 {
-	p = new TexPoolPrivate(maxMemSize);
+	p = new TexPoolPrivate(conf);
 }
 
 TexPool::~TexPool()
 {
-	std::list<TEXFBO>::iterator iter;
-
-	for (iter = p->priorityQueue.begin();
-	     iter != p->priorityQueue.end();
-	     ++iter)
+	while (!p->priorityQueue.isEmpty())
 	{
-		TEXFBO obj = *iter;
+		TEXFBO obj = p->take(p->priorityQueue.tail());
 		TEXFBO::fini(obj);
-		--p->objCount;
 	}
 
-	assert(p->objCount == 0);
+	assert(p->stats.count == 0);
+
+	BoostHash<Size, NodeList*>::const_iterator iter;
+
+	for (iter = p->poolHash.cbegin(); iter != p->poolHash.cend(); ++iter)
+		delete iter->second;
 
 	delete p;
 }
 
 TEXFBO TexPool::request(int width, int height)
 {
-	CacheNode cnode;
+	int maxSize = glState.caps.maxTexSize;
+	if (width > maxSize || height > maxSize)
+		throw Exception(Exception::MKXPError,
+		                "Texture dimensions [%d, %d] exceed hardware capabilities",
+		                width, height);
+
 	Size size(width, height);
 
+	if (p->sizeClasses)
+		size = Size(TexPoolPrivate::sizeClass(width, maxSize),
+		            TexPoolPrivate::sizeClass(height, maxSize));
+
 	/* See if we can statisfy request from cache */
-	CNodeList &bucket = p->poolHash[size];
+	NodeList &bucket = p->bucket(size);
+	TEXFBO obj;
 
-	if (!bucket.empty())
+	if (!bucket.isEmpty())
 	{
 		/* Found one! */
-		cnode = bucket.back();
-		bucket.pop_back();
+		obj = p->take(bucket.begin()->data);
+		VRAM::setCategory(obj.tex.gl, VRAM::Bitmaps);
 
-		p->priorityQueue.erase(cnode.prioIter);
-
-		p->memSize -= byteCount(size);
-		--p->objCount;
+		p->stats.hits++;
+	}
+	else
+	{
+		/* Nope, create it instead, making room
+		 * within the memory budget first */
+		p->evict(VRAM::excess(byteCount(size)));
 
-//		Debug() << "TexPool: <?+> (" << width << height << ")";
+		TEXFBO::init(obj);
+		TEXFBO::allocEmpty(obj, size.first, size.second, VRAM::Bitmaps);
+		TEXFBO::linkFBO(obj);
 
-		return cnode.obj;
+		p->stats.misses++;
 	}
 
-	int maxSize = glState.caps.maxTexSize;
-	if (width > maxSize || height > maxSize)
-		throw Exception(Exception::MKXPError,
-		                "Texture dimensions [%d, %d] exceed hardware capabilities",
-		                width, height);
-
-	/* Nope, create it instead */
-	TEXFBO::init(cnode.obj);
-	TEXFBO::allocEmpty(cnode.obj, width, height);
-	TEXFBO::linkFBO(cnode.obj);
+	obj.width = width;
+	obj.height = height;
 
-//	Debug() << "TexPool: <?-> (" << width << height << ")";
+	p->clearMargin(obj);
 
-	return cnode.obj;
+	return obj;
 }
 
 void TexPool::release(TEXFBO &obj)
@@ -153,59 +248,49 @@ void TexPool::release(TEXFBO &obj)
 	if (p->disabled)
 	{
 		/* If we're disabled, delete without caching */
-//		Debug() << "TexPool: <!#> (" << obj.width << obj.height << ")";
 		TEXFBO::fini(obj);
 		return;
 	}
 
-	Size size(obj.width, obj.height);
+	Size size(obj.texWidth, obj.texHeight);
 
-	uint32_t newMemSize = p->memSize + byteCount(size);
-
-	/* If caching this object would spill over the allowed memory budget,
-	 * delete least used objects until we're good again */
-	while (newMemSize > p->maxMemSize)
+	/* Too big to be cached at all */
+	if (byteCount(size) > p->maxMemSize)
 	{
-		if (p->objCount == 0)
-			break;
-
-//		Debug() << "TexPool: <!~> Size:" << p->memSize;
-
-		/* Retrieve object with lowest priority for deletion */
-		CacheNode last;
-		last.obj = p->priorityQueue.back();
-		Size removedSize(last.obj.width, last.obj.height);
-
-		CNodeList &bucket = p->poolHash[removedSize];
-
-		std::list<CacheNode>::iterator toRemove =
-		        std::find(bucket.begin(), bucket.end(), last);
-		assert(toRemove != bucket.end());
-		bucket.erase(toRemove);
-
-		p->priorityQueue.pop_back();
+		TEXFBO::fini(obj);
+		return;
+	}
 
-		TEXFBO::fini(last.obj);
+	/* If caching this object would spill over the allowed memory budget,
+	 * delete least recently released objects until we're good again */
+	if (p->memSize + byteCount(size) > p->maxMemSize)
+		p->evict(p->memSize + byteCount(size) - p->maxMemSize);
 
-		newMemSize -= byteCount(removedSize);
-		--p->objCount;
+	/* Same if we're above the global budget, and
+	 * don't cache anything while that doesn't help */
+	p->evict(VRAM::excess());
 
-//		Debug() << "TexPool: <!-> (" << last.obj.width << last.obj.height << ")";
+	if (VRAM::excess() > 0)
+	{
+		TEXFBO::fini(obj);
+		return;
 	}
 
-	p->memSize = newMemSize;
-
 	/* Retain object */
-	p->priorityQueue.push_front(obj);
-	CacheNode cnode;
-	cnode.obj = obj;
-	cnode.prioIter = p->priorityQueue.begin();
-	CNodeList &bucket = p->poolHash[size];
-	bucket.push_back(cnode);
+	PoolNode *node = new PoolNode(obj);
 
-	++p->objCount;
+	VRAM::setCategory(obj.tex.gl, VRAM::TexturePool);
 
-//	Debug() << "TexPool: <!+> (" << obj.width << obj.height << ") Current size:" << p->memSize;
+	p->priorityQueue.prepend(node->prioLink);
+	p->bucket(size).prepend(node->bucketLink);
+
+	p->memSize += byteCount(size);
+	p->stats.count++;
+}
+
+void TexPool::trim(size_t bytes)
+{
+	p->evict(bytes);
 }
 
 void TexPool::disable()
@@ -213,4 +298,10 @@ void TexPool::disable()
 	p->disabled = true;
 }
 
+TexPool::Stats TexPool::stats() const
+{
+	Stats result = p->stats;
+	result.bytes = p->memSize;
 
+	return result;
+}
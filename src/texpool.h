@@ -24,19 +24,46 @@
 
 #include "gl-util.h"
 
+#include <stddef.h>
+
+struct Config;
 struct TexPoolPrivate;
 
+/* Keeps released textures around (up to a memory budget) to
+ * hand them out again for later requests of the same size.
+ * Optionally, requests are rounded up to size classes so that
+ * similarly sized textures can be reused for each other; the
+ * returned TEXFBO then carries the requested size, and the
+ * allocated one in texWidth/texHeight */
 class TexPool
 {
 public:
-	TexPool(uint32_t maxMemSize = 20000000 /* 20 MB */);
+	struct Stats
+	{
+		/* Requests served from the pool / by a new texture */
+		size_t hits, misses;
+
+		/* Pooled textures deleted to stay within budget */
+		size_t evictions;
+
+		size_t count;
+		size_t bytes;
+	};
+
+	TexPool(const Config &conf);
 	~TexPool();
 
 	TEXFBO request(int width, int height);
 	void release(TEXFBO &obj);
 
+	/* Deletes pooled textures, least recently released
+	 * first, until 'bytes' are freed or none are left */
+	void trim(size_t bytes);
+
 	void disable();
 
+	Stats stats() const;
+
 private:
 	TexPoolPrivate *p;
 };
@@ -0,0 +1,68 @@
+/*
+** textlayoutcache.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "textlayoutcache.h"
+
+#include "config.h"
+
+#include <SDL_ttf.h>
+
+TextLayoutCache::TextLayoutCache(const Config &conf)
+    : capacity(conf.textLayoutCache > 0 ? conf.textLayoutCache : 0),
+      hitCount(0),
+      missCount(0)
+{}
+
+TextLayout &TextLayoutCache::get(_TTF_Font *font, const char *str)
+{
+	const Key key(std::make_pair(font, TTF_GetFontStyle(font)), str);
+
+	if (index.contains(key))
+	{
+		++hitCount;
+
+		EntryList::iterator iter = index.value(key);
+		entries.splice(entries.begin(), entries, iter);
+
+		return iter->layout;
+	}
+
+	++missCount;
+
+	if (capacity == 0)
+	{
+		scratch = TextLayout();
+		return scratch;
+	}
+
+	if (entries.size() >= capacity)
+	{
+		index.remove(entries.back().key);
+		entries.pop_back();
+	}
+
+	Entry entry;
+	entry.key = key;
+	entries.push_front(entry);
+	index.insert(key, entries.begin());
+
+	return entries.front().layout;
+}
@@ -0,0 +1,116 @@
+/*
+** textlayoutcache.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TEXTLAYOUTCACHE_H
+#define TEXTLAYOUTCACHE_H
+
+#include "boost-hash.h"
+
+#include <string>
+#include <vector>
+#include <list>
+#include <utility>
+#include <stdint.h>
+
+struct _TTF_Font;
+struct Config;
+
+/* What Bitmap works out about a string before measuring
+ * or drawing it. Everything is filled in by the users as
+ * needed, the cache only keeps it around */
+struct TextLayout
+{
+	/* Set once the fields below 'text' are valid */
+	bool prepared;
+
+	/* The string as drawn (line breaks turned into spaces) */
+	std::string text;
+	bool allSpace;
+
+	/* Extents for Bitmap#text_size; negative until measured */
+	int width, height;
+
+	/* The text decoded for the glyph cache */
+	enum GlyphState
+	{
+		GlyphsUnknown,
+		GlyphsDecoded,
+		GlyphsUnsupported
+	};
+
+	GlyphState glyphState;
+	std::vector<uint16_t> chars;
+
+	/* Pen position of each character, and the line
+	 * height; the pen is empty until first laid out */
+	std::vector<int> pen;
+	int lineHeight;
+
+	TextLayout()
+	    : prepared(false),
+	      allSpace(false),
+	      width(-1), height(-1),
+	      glyphState(GlyphsUnknown),
+	      lineHeight(0)
+	{}
+};
+
+/* Bounded LRU cache of TextLayouts, keyed on the font handle
+ * (family and size), its style (bold / italic) and the string */
+class TextLayoutCache
+{
+public:
+	TextLayoutCache(const Config &conf);
+
+	/* Returns the (possibly fresh) layout of 'str' set in
+	 * 'font'. The reference stays valid until the next call */
+	TextLayout &get(_TTF_Font *font, const char *str);
+
+	unsigned int hits() const { return hitCount; }
+	unsigned int misses() const { return missCount; }
+	size_t size() const { return entries.size(); }
+
+private:
+	/* ((font, style), string) */
+	typedef std::pair<std::pair<_TTF_Font*, int>, std::string> Key;
+
+	struct Entry
+	{
+		Key key;
+		TextLayout layout;
+	};
+
+	typedef std::list<Entry> EntryList;
+
+	/* Most recently used first */
+	EntryList entries;
+	BoostHash<Key, EntryList::iterator> index;
+
+	size_t capacity;
+
+	/* Handed out when the cache is disabled */
+	TextLayout scratch;
+
+	unsigned int hitCount;
+	unsigned int missCount;
+};
+
+#endif // TEXTLAYOUTCACHE_H
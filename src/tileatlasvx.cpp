@@ -266,6 +266,10 @@ static void doBlit(Bitmap *bm, const IntRect &src, const Vec2i &dst)
 	if (!SDL_IntersectRect(&_src, &bmr, &_src))
 		return;
 
+	const Vec2i orig = bm->texOrigin();
+	_src.x += orig.x;
+	_src.y += orig.y;
+
 	GLMeta::blitRectangle(_src, _dst);
 }
 
@@ -273,6 +277,12 @@ void build(TEXFBO &tf, Bitmap *bitmaps[BM_COUNT])
 {
 	assert(tf.width == ATLASVX_W && tf.height == ATLASVX_H);
 
+	/* Draw deferred writes of the sources before starting
+	 * our own blit sequence */
+	for (size_t i = 0; i < BM_COUNT; ++i)
+		if (!nullOrDisposed(bitmaps[i]))
+			bitmaps[i]->backingTex();
+
 	GLMeta::blitBegin(tf);
 
 	glState.clearColor.pushSet(Vec4());
@@ -292,7 +302,7 @@ void build(TEXFBO &tf, Bitmap *bitmaps[BM_COUNT])
 #define EXEC_BLITS(part) \
 	if (!nullOrDisposed(bm = bitmaps[BM_##part])) \
 	{ \
-		GLMeta::blitSource(bm->getGLTypes()); \
+		GLMeta::blitSource(bm->backingTex()); \
 		for (size_t i = 0; i < blits##part##N; ++i) \
 		{\
 			const IntRect &src = blits##part[i].src; \
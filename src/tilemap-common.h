@@ -32,9 +32,11 @@
 #include "vertex.h"
 #include "quad.h"
 #include "etc-internal.h"
+#include "preparequeue.h"
 
 #include <stdint.h>
 #include <assert.h>
+#include <algorithm>
 #include <vector>
 
 #include <sigc++/connection.h>
@@ -61,6 +63,36 @@ tableGetWrapped(const Table &t, int x, int y, int z = 0)
 	             z);
 }
 
+/* Whether 'len' cells from 'pos' on, repeating every 'size'
+ * cells, cover any of the 'hitLen' cells from 'hitPos' on */
+static inline bool
+spanWrappedHits(int pos, int len, int size, int hitPos, int hitLen)
+{
+	if (len <= 0 || hitLen <= 0)
+		return false;
+
+	if (len >= size)
+		return true;
+
+	const int start = wrap(pos, size);
+	const int end = start + len;
+
+	if (start < hitPos + hitLen && hitPos < std::min(end, size))
+		return true;
+
+	/* The part past the table edge starts over at 0 */
+	return end > size && hitPos < end - size;
+}
+
+/* Whether the map cells in 'mapRect' (which repeat the table
+ * in every direction) cover any of the table cells in 'rect' */
+static inline bool
+tableAreaVisible(const Table &t, const IntRect &mapRect, const IntRect &rect)
+{
+	return spanWrappedHits(mapRect.x, mapRect.w, t.xSize(), rect.x, rect.w)
+	    && spanWrappedHits(mapRect.y, mapRect.h, t.ySize(), rect.y, rect.h);
+}
+
 /* Calculate the tile x/y on which this pixel x/y lies */
 static inline Vec2i
 getTilePos(const Vec2i &pixelPos)
@@ -112,8 +144,11 @@ atSelectSubPos(FloatRect &pos, int i)
 
 struct FlashMap
 {
-	FlashMap()
-		: dirty(false),
+	/* 'owner' calls prepare() on us, and gets
+	 * scheduled whenever we need rebuilding */
+	FlashMap(Preparable &owner)
+		: owner(owner),
+	      dirty(false),
 	      data(0),
 	      allocQuads(0)
 	{
@@ -144,6 +179,8 @@ struct FlashMap
 		data = value;
 		dataCon.disconnect();
 		dirty = true;
+		owner.schedulePrepare();
+		shState->markDirty();
 
 		if (!data)
 			return;
@@ -194,6 +231,8 @@ private:
 	void setDirty()
 	{
 		dirty = true;
+		owner.schedulePrepare();
+		shState->markDirty();
 	}
 
 	size_t quadCount() const
@@ -263,6 +302,8 @@ private:
 		shState->ensureQuadIBO(quadCount());
 	}
 
+	Preparable &owner;
+
 	bool dirty;
 
 	Table *data;
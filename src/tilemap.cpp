@@ -43,10 +43,11 @@
 
 #include <string.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <algorithm>
 #include <vector>
 
-#include <SDL_surface.h>
+#include <SDL_rect.h>
 
 extern const StaticRect autotileRects[];
 
@@ -63,11 +64,17 @@ static const int atAreaH = autotileH * autotileCount;
 
 static const int tsLaneW = tilesetW / 2;
 
-/* Map viewport size */
-static const int viewpW = 21;
-static const int viewpH = 16;
+/* The ground layer and priorities 1-5 */
+static const int layerKinds = 6;
 
-static const size_t zlayersMax = viewpH + 5;
+/* Most quads a single draw call can index */
+static const size_t maxDrawQuads = (INDEX_T_MAX - 1) / 6;
+
+/* Division rounding towards negative infinity */
+static int floorDiv(int value, int divisor)
+{
+	return (value - wrap(value, divisor)) / divisor;
+}
 
 /* Vocabulary:
  *
@@ -149,8 +156,34 @@ static const size_t zlayersMax = viewpH + 5;
  *   This rectangle describes the subregion of the map that is
  *   actually translated to vertices and stored on the GPU ready
  *   for rendering. Whenever, ox/oy are modified, its position is
- *   adjusted if necessary and the data is regenerated. Its size
- *   is fixed. This is NOT related to the RGSS Viewport class!
+ *   adjusted if necessary and the data is updated. Its size
+ *   follows the size of the scene the tilemap is drawn in (in
+ *   tiles, plus one for partially visible ones), and only changes
+ *   along with it. This is NOT related to the RGSS Viewport class!
+ *   Vertex positions are in map pixels, so data already on the
+ *   GPU stays valid when the map viewport moves.
+ *
+ * Ring layout:
+ *   Each map cell gets fixed slots in the shared buffer, one for
+ *   the ground layer and one per priority, sized for the largest
+ *   tile stack seen (unused quads are left degenerate). Cells are
+ *   placed by their map position modulo the viewport size, so a
+ *   cell moving into view takes over the slots of the one moving
+ *   out, and a scroll step only uploads the new row or column.
+ *   Priority slots are grouped by zlayer into blocks, also placed
+ *   by map row modulo the zlayer count, so zlayers stay in order
+ *   in the buffer (and can be batched) except where it wraps.
+ *   If the slots would get too big, the layers are packed tightly
+ *   instead, and regenerated on every scroll step.
+ *
+ * Whole map layout:
+ *   Small enough maps (see 'staticTilemapSize') are generated
+ *   as a whole, once: ground quads row by row, then priority
+ *   quads by zlayer as if the map viewport sat at the map's
+ *   origin ('bands'). Scrolling then only changes which bands
+ *   the zlayers draw and where. Where the map wraps around in
+ *   view, the affected ranges are drawn again, shifted by the
+ *   map size.
  *
  */
 
@@ -178,17 +211,26 @@ static const uint8_t flashAlpha[] =
 
 static elementsN(flashAlpha);
 
+/* Quads in the shared buffer drawn as one, 'shiftY'
+ * map heights further down (whole map layout only) */
+struct QuadRange
+{
+	size_t first;
+	size_t count;
+	int shiftY;
+
+	QuadRange(size_t first, size_t count, int shiftY)
+	    : first(first), count(count), shiftY(shiftY)
+	{}
+};
+
 struct GroundLayer : public ViewportElement
 {
-	GLsizei vboCount;
 	TilemapPrivate *p;
 
 	GroundLayer(TilemapPrivate *p, Viewport *viewport);
 
-	void updateVboCount();
-
 	void draw();
-	void drawInt();
 
 	void onGeometryChange(const Scene::Geometry &geo);
 
@@ -198,24 +240,25 @@ struct GroundLayer : public ViewportElement
 struct ZLayer : public ViewportElement
 {
 	size_t index;
-	GLintptr vboOffset;
-	GLsizei vboCount;
 	TilemapPrivate *p;
 
+	/* Where this layer's quads are; more than one range
+	 * where the map wraps around in the whole map layout */
+	std::vector<QuadRange> ranges;
+
 	/* If this layer is part of a batch and not
 	 * the head, it is 'muted' via this flag */
 	bool batchedFlag;
 
 	/* If this layer is a batch head, this variable
-	 * holds the element count of the entire batch */
-	GLsizei vboBatchCount;
+	 * holds the quad count of the entire batch */
+	size_t batchCount;
 
 	ZLayer(TilemapPrivate *p, Viewport *viewport);
 
 	void setIndex(int value);
 
 	void draw();
-	void drawInt();
 
 	static int calculateZ(TilemapPrivate *p, int index);
 
@@ -225,7 +268,7 @@ struct ZLayer : public ViewportElement
 	ABOUT_TO_ACCESS_NOOP
 };
 
-struct TilemapPrivate
+struct TilemapPrivate : public Preparable
 {
 	Viewport *viewport;
 
@@ -258,18 +301,62 @@ struct TilemapPrivate
 		std::vector<uint8_t> animatedATs;
 	} atlas;
 
-	/* Map viewport position */
+	/* Map viewport position and size */
 	Vec2i viewpPos;
+	int viewpW, viewpH;
+
+	/* One per map viewport row, plus the ones
+	 * holding the higher priorities of the last */
+	size_t zlayerCount;
 
 	/* Ground layer vertices */
 	SVVector groundVert;
 
 	/* ZLayer vertices */
-	SVVector zlayerVert[zlayersMax];
+	std::vector<SVVector> zlayerVert;
 
 	/* Base quad indices of each zlayer
-	 * in the shared buffer */
-	size_t zlayerBases[zlayersMax+1];
+	 * (or zlayer block) in the shared buffer */
+	std::vector<size_t> zlayerBases;
+
+	/* Quads holding ground layer tiles */
+	size_t groundQuads;
+
+	/* See "Ring layout" */
+	struct
+	{
+		bool active;
+
+		/* Quads reserved per cell for each layer kind */
+		size_t cellCap[layerKinds];
+
+		/* Offset of each priority's slots in a zlayer block */
+		size_t unitBase[layerKinds];
+
+		/* Quads in use per cell (by viewport slot)
+		 * and layer kind, and per zlayer block */
+		std::vector<uint16_t> cellQuads;
+		std::vector<size_t> blockQuads;
+	} ring;
+
+	/* See "Whole map layout" */
+	struct
+	{
+		bool active;
+
+		/* Map size (in tiles) */
+		int w, h;
+
+		/* Base quad indices of each map row's
+		 * ground quads, and of each band */
+		std::vector<size_t> rowBases;
+		std::vector<size_t> bandBases;
+	} whole;
+
+	/* Scratch vertices of one cell and one
+	 * row of cells, per layer kind */
+	SVVector cellVert[layerKinds];
+	SVVector rowVert[layerKinds];
 
 	/* Shared buffers for all tiles */
 	struct
@@ -290,7 +377,7 @@ struct TilemapPrivate
 	struct
 	{
 		GroundLayer *ground;
-		ZLayer* zlayers[zlayersMax];
+		std::vector<ZLayer*> zlayers;
 		/* Used layers out of 'zlayers' (rest is hidden) */
 		size_t activeLayers;
 		Scene::Geometry sceneGeo;
@@ -300,8 +387,11 @@ struct TilemapPrivate
 	bool atlasSizeDirty;
 	/* Affected by: autotiles(.changed), tileset(.changed), allocateAtlas */
 	bool atlasDirty;
-	/* Affected by: mapData(.changed), priorities(.changed) */
+	/* Affected by: mapData, priorities(.changed) */
 	bool buffersDirty;
+	/* Affected by: mapData(.changed), holds the written cells */
+	bool cellsDirty;
+	IntRect dirtyCells;
 	/* Affected by: ox, oy */
 	bool mapViewportDirty;
 	/* Affected by: oy */
@@ -319,19 +409,22 @@ struct TilemapPrivate
 	/* Dispose watches */
 	sigc::connection autotilesDispCon[autotileCount];
 
-	/* Draw prepare call */
-	sigc::connection prepareCon;
-
 	TilemapPrivate(Viewport *viewport)
 	    : viewport(viewport),
 	      tileset(0),
 	      mapData(0),
 	      priorities(0),
 	      visible(true),
+	      viewpW(0),
+	      viewpH(0),
+	      zlayerCount(0),
+	      groundQuads(0),
+	      flashMap(*this),
 	      flashAlphaIdx(0),
 	      atlasSizeDirty(false),
 	      atlasDirty(false),
 	      buffersDirty(false),
+	      cellsDirty(false),
 	      mapViewportDirty(false),
 	      zOrderDirty(false),
 	      tilemapReady(false)
@@ -345,6 +438,13 @@ struct TilemapPrivate
 		tiles.frameIdx = 0;
 		tiles.aniIdx = 0;
 
+		ring.active = false;
+		memset(ring.cellCap, 0, sizeof(ring.cellCap));
+		memset(ring.unitBase, 0, sizeof(ring.unitBase));
+
+		whole.active = false;
+		whole.w = whole.h = 0;
+
 		/* Init tile buffers */
 		tiles.vbo = VBO::gen();
 
@@ -355,12 +455,11 @@ struct TilemapPrivate
 		GLMeta::vaoInit(tiles.vao);
 
 		elem.ground = new GroundLayer(this, viewport);
+		elem.activeLayers = 0;
 
-		for (size_t i = 0; i < zlayersMax; ++i)
-			elem.zlayers[i] = new ZLayer(this, viewport);
+		resizeMapViewport(elem.sceneGeo.rect.size());
 
-		prepareCon = shState->prepareDraw.connect
-		        (sigc::mem_fun(this, &TilemapPrivate::prepare));
+		schedulePrepare();
 
 		updateFlashMapViewport();
 	}
@@ -369,7 +468,7 @@ struct TilemapPrivate
 	{
 		/* Destroy elements */
 		delete elem.ground;
-		for (size_t i = 0; i < zlayersMax; ++i)
+		for (size_t i = 0; i < elem.zlayers.size(); ++i)
 			delete elem.zlayers[i];
 
 		shState->releaseAtlasTex(atlas.gl);
@@ -387,8 +486,6 @@ struct TilemapPrivate
 		}
 		mapDataCon.disconnect();
 		prioritiesCon.disconnect();
-
-		prepareCon.disconnect();
 	}
 
 	void updateFlashMapViewport()
@@ -396,6 +493,32 @@ struct TilemapPrivate
 		flashMap.setViewport(IntRect(viewpPos, Vec2i(viewpW, viewpH)));
 	}
 
+	/* Map viewport size covering a scene of 'size' */
+	static Vec2i mapViewportSize(const Vec2i &size)
+	{
+		return Vec2i((size.x + 31) / 32 + 1, (size.y + 31) / 32 + 1);
+	}
+
+	/* Sizes the map viewport for a scene of 'sceneSize', adding
+	 * zlayer elements as needed. The buffers need a rebuild after */
+	void resizeMapViewport(const Vec2i &sceneSize)
+	{
+		const Vec2i size = mapViewportSize(sceneSize);
+
+		viewpW = size.x;
+		viewpH = size.y;
+		zlayerCount = viewpH + 5;
+
+		zlayerVert.resize(zlayerCount);
+
+		while (elem.zlayers.size() < zlayerCount)
+		{
+			ZLayer *layer = new ZLayer(this, viewport);
+			layer->setVisible(false);
+			elem.zlayers.push_back(layer);
+		}
+	}
+
 	void updateAtlasInfo()
 	{
 		if (nullOrDisposed(tileset))
@@ -427,7 +550,7 @@ struct TilemapPrivate
 			if (nullOrDisposed(autotiles[i]))
 				continue;
 
-			if (autotiles[i]->megaSurface())
+			if (autotiles[i]->isMega())
 				continue;
 
 			usableATs.push_back(i);
@@ -448,16 +571,49 @@ struct TilemapPrivate
 	void invalidateAtlasSize()
 	{
 		atlasSizeDirty = true;
+		shState->markDirty();
 	}
 
 	void invalidateAtlasContents()
 	{
 		atlasDirty = true;
+		shState->markDirty();
 	}
 
 	void invalidateBuffers()
 	{
 		buffersDirty = true;
+		shState->markDirty();
+	}
+
+	void onMapDataModified()
+	{
+		const IntRect area = mapData->dirtyArea();
+
+		/* Resized, or written all over */
+		if (area.w == mapData->xSize() && area.h == mapData->ySize())
+		{
+			invalidateBuffers();
+			return;
+		}
+
+		if (!cellsDirty)
+		{
+			dirtyCells = area;
+		}
+		else
+		{
+			const int x2 = std::max(dirtyCells.x + dirtyCells.w, area.x + area.w);
+			const int y2 = std::max(dirtyCells.y + dirtyCells.h, area.y + area.h);
+
+			dirtyCells.x = std::min(dirtyCells.x, area.x);
+			dirtyCells.y = std::min(dirtyCells.y, area.y);
+			dirtyCells.w = x2 - dirtyCells.x;
+			dirtyCells.h = y2 - dirtyCells.y;
+		}
+
+		cellsDirty = true;
+		shState->markDirty();
 	}
 
 	/* Checks for the minimum amount of data needed to display */
@@ -491,6 +647,19 @@ struct TilemapPrivate
 
 		TileAtlas::BlitVec blits = TileAtlas::calcBlits(atlas.efTilesetH, atlas.size);
 
+		/* Sources are only read, so they can stay in the bitmap atlas
+		 * or keep sharing their texture. Fetching the backing textures
+		 * up front also draws any deferred writes before our own
+		 * blit sequence starts */
+		for (size_t i = 0; i < atlas.usableATs.size(); ++i)
+			autotiles[atlas.usableATs[i]]->backingTex();
+
+		if (tileset->isMega())
+			for (size_t t = 0; t < tileset->megaTileCount(); ++t)
+				tileset->megaTile(t).backingTex();
+		else
+			tileset->backingTex();
+
 		/* Clear atlas */
 		FBO::bind(atlas.gl.fbo);
 		glState.clearColor.pushSet(Vec4());
@@ -512,19 +681,20 @@ struct TilemapPrivate
 			int blitW = std::min(autotile->width(), atAreaW);
 			int blitH = std::min(autotile->height(), atAreaH);
 
-			GLMeta::blitSource(autotile->getGLTypes());
+			const Vec2i orig = autotile->texOrigin();
+			GLMeta::blitSource(autotile->backingTex());
 
 			if (blitW <= autotileW && tiles.animated)
 			{
 				/* Static autotile */
 				for (int j = 0; j < 4; ++j)
-					GLMeta::blitRectangle(IntRect(0, 0, blitW, blitH),
+					GLMeta::blitRectangle(IntRect(orig.x, orig.y, blitW, blitH),
 					                      Vec2i(autotileW*j, atInd*autotileH));
 			}
 			else
 			{
 				/* Animated autotile */
-				GLMeta::blitRectangle(IntRect(0, 0, blitW, blitH),
+				GLMeta::blitRectangle(IntRect(orig.x, orig.y, blitW, blitH),
 				                      Vec2i(0, atInd*autotileH));
 			}
 		}
@@ -532,74 +702,51 @@ struct TilemapPrivate
 		GLMeta::blitEnd();
 
 		/* Blit tileset */
-		if (tileset->megaSurface())
+		if (tileset->isMega())
 		{
-			/* Mega surface tileset */
-			SDL_Surface *tsSurf = tileset->megaSurface();
-
-			if (shState->config().subImageFix)
+			/* Mega tileset; lanes may cross tile borders */
+			for (size_t t = 0; t < tileset->megaTileCount(); ++t)
 			{
-				/* Implementation for broken GL drivers */
-				FBO::bind(atlas.gl.fbo);
-				glState.blend.pushSet(false);
-				glState.viewport.pushSet(IntRect(0, 0, atlas.size.x, atlas.size.y));
+				const IntRect tileRect = tileset->megaTileRect(t);
+				const Bitmap &tile = tileset->megaTile(t);
+				const Vec2i orig = tile.texOrigin();
 
-				SimpleShader &shader = shState->shaders().simple;
-				shader.bind();
-				shader.applyViewportProj();
-				shader.setTranslation(Vec2i());
-
-				Quad &quad = shState->gpQuad();
+				GLMeta::blitBegin(atlas.gl);
+				GLMeta::blitSource(tile.backingTex());
 
 				for (size_t i = 0; i < blits.size(); ++i)
 				{
 					const TileAtlas::Blit &blitOp = blits[i];
 
-					Vec2i texSize;
-					shState->ensureTexSize(tsLaneW, blitOp.h, texSize);
-					shState->bindTex();
-					GLMeta::subRectImageUpload(tsSurf->w, blitOp.src.x, blitOp.src.y,
-					                           0, 0, tsLaneW, blitOp.h, tsSurf, GL_RGBA);
-
-					shader.setTexSize(texSize);
-					quad.setTexRect(FloatRect(0, 0, tsLaneW, blitOp.h));
-					quad.setPosRect(FloatRect(blitOp.dst.x, blitOp.dst.y, tsLaneW, blitOp.h));
-
-					quad.draw();
-				}
+					IntRect lane(blitOp.src.x, blitOp.src.y, tsLaneW, blitOp.h);
+					IntRect part;
 
-				GLMeta::subRectImageEnd();
-				glState.viewport.pop();
-				glState.blend.pop();
-			}
-			else
-			{
-				/* Clean implementation */
-				TEX::bind(atlas.gl.tex);
-
-				for (size_t i = 0; i < blits.size(); ++i)
-				{
-					const TileAtlas::Blit &blitOp = blits[i];
+					if (!SDL_IntersectRect(&lane, &tileRect, &part))
+						continue;
 
-					GLMeta::subRectImageUpload(tsSurf->w, blitOp.src.x, blitOp.src.y,
-					                           blitOp.dst.x, blitOp.dst.y, tsLaneW, blitOp.h, tsSurf, GL_RGBA);
+					GLMeta::blitRectangle(IntRect(orig.x + part.x - tileRect.x,
+					                              orig.y + part.y - tileRect.y, part.w, part.h),
+					                      Vec2i(blitOp.dst.x + part.x - lane.x,
+					                            blitOp.dst.y + part.y - lane.y));
 				}
 
-				GLMeta::subRectImageEnd();
+				GLMeta::blitEnd();
 			}
-
 		}
 		else
 		{
 			/* Regular tileset */
+			const Vec2i orig = tileset->texOrigin();
+
 			GLMeta::blitBegin(atlas.gl);
-			GLMeta::blitSource(tileset->getGLTypes());
+			GLMeta::blitSource(tileset->backingTex());
 
 			for (size_t i = 0; i < blits.size(); ++i)
 			{
 				const TileAtlas::Blit &blitOp = blits[i];
 
-				GLMeta::blitRectangle(IntRect(blitOp.src.x, blitOp.src.y, tsLaneW, blitOp.h),
+				GLMeta::blitRectangle(IntRect(orig.x + blitOp.src.x, orig.y + blitOp.src.y,
+				                              tsLaneW, blitOp.h),
 				                      blitOp.dst);
 			}
 
@@ -652,38 +799,32 @@ struct TilemapPrivate
 		}
 	}
 
-	void handleTile(int x, int y, int z)
+	/* Reads the tile at map cell (mx, my, z) into 'tileInd' and
+	 * returns its priority, or -1 if there's nothing to draw */
+	int sampleTile(int mx, int my, int z, int &tileInd)
 	{
-		int tileInd =
-			tableGetWrapped(*mapData, x + viewpPos.x, y + viewpPos.y, z);
+		tileInd = tableGetWrapped(*mapData, mx, my, z);
 
 		/* Check for empty space */
 		if (tileInd < 48)
-			return;
-
-		int prio = samplePriority(tileInd);
-
-		/* Check for faulty data */
-		if (prio == -1)
-			return;
+			return -1;
 
-		SVVector *targetArray;
+		/* -1 for faulty data */
+		return samplePriority(tileInd);
+	}
 
-		/* Prio 0 tiles are all part of the same ground layer */
-		if (prio == 0)
-		{
-			targetArray = &groundVert;
-		}
-		else
-		{
-			int layerInd = y + prio;
-			targetArray = &zlayerVert[layerInd];
-		}
+	static size_t tileQuadCount(int tileInd)
+	{
+		/* Autotiles are pieced together from 4 quads */
+		return tileInd < 48*8 ? 4 : 1;
+	}
 
+	void handleTile(int mx, int my, int tileInd, SVVector *targetArray)
+	{
 		/* Check for autotile */
 		if (tileInd < 48*8)
 		{
-			handleAutotile(x, y, tileInd, targetArray);
+			handleAutotile(mx, my, tileInd, targetArray);
 			return;
 		}
 
@@ -693,7 +834,7 @@ struct TilemapPrivate
 
 		Vec2i texPos = TileAtlas::tileToAtlasCoor(tileX, tileY, atlas.efTilesetH, atlas.size.y);
 		FloatRect texRect((float) texPos.x+0.5f, (float) texPos.y+0.5f, 31, 31);
-		FloatRect posRect(x*32, y*32, 32, 32);
+		FloatRect posRect(mx*32, my*32, 32, 32);
 
 		SVertex v[4];
 		Quad::setTexPosRect(v, texRect, posRect);
@@ -702,11 +843,30 @@ struct TilemapPrivate
 			targetArray->push_back(v[i]);
 	}
 
+	/* Generates the quads of map cell (mx, my) into 'cellVert',
+	 * sorted by layer kind (= priority) */
+	void buildCell(int mx, int my)
+	{
+		for (int k = 0; k < layerKinds; ++k)
+			cellVert[k].clear();
+
+		for (int z = 0; z < mapData->zSize(); ++z)
+		{
+			int tileInd;
+			int prio = sampleTile(mx, my, z, tileInd);
+
+			if (prio == -1)
+				continue;
+
+			handleTile(mx, my, tileInd, &cellVert[prio]);
+		}
+	}
+
 	void clearQuadArrays()
 	{
 		groundVert.clear();
 
-		for (size_t i = 0; i < zlayersMax; ++i)
+		for (size_t i = 0; i < zlayerVert.size(); ++i)
 			zlayerVert[i].clear();
 	}
 
@@ -716,8 +876,20 @@ struct TilemapPrivate
 
 		for (int x = 0; x < viewpW; ++x)
 			for (int y = 0; y < viewpH; ++y)
-				for (int z = 0; z < mapData->zSize(); ++z)
-					handleTile(x, y, z);
+			{
+				buildCell(viewpPos.x + x, viewpPos.y + y);
+
+				/* Prio 0 tiles are all part of the same ground layer */
+				groundVert.insert(groundVert.end(), cellVert[0].begin(), cellVert[0].end());
+
+				for (int prio = 1; prio < layerKinds; ++prio)
+				{
+					SVVector &layer = zlayerVert[y + prio];
+					layer.insert(layer.end(), cellVert[prio].begin(), cellVert[prio].end());
+				}
+			}
+
+		groundQuads = groundVert.size() / 4;
 	}
 
 	static size_t quadDataSize(size_t quadCount)
@@ -725,9 +897,65 @@ struct TilemapPrivate
 		return quadCount * sizeof(SVertex) * 4;
 	}
 
-	size_t zlayerSize(size_t index)
+	/* Position of zlayer 'index' in the shared buffer */
+	size_t zlayerBlock(size_t index) const
+	{
+		return ring.active ? wrap(viewpPos.y + (int) index, zlayerCount) : index;
+	}
+
+	size_t zlayerSize(size_t index) const
 	{
-		return zlayerBases[index+1] - zlayerBases[index];
+		const size_t block = zlayerBlock(index);
+
+		return zlayerBases[block+1] - zlayerBases[block];
+	}
+
+	/* Collects the quads of zlayer 'index' into 'out' */
+	void zlayerRanges(size_t index, std::vector<QuadRange> &out) const
+	{
+		out.clear();
+
+		if (!whole.active)
+		{
+			const size_t block = zlayerBlock(index);
+			out.push_back(QuadRange(zlayerBases[block], zlayerSize(index), 0));
+
+			return;
+		}
+
+		/* The band of every map repetition
+		 * that reaches into this zlayer */
+		const int band = viewpPos.y + (int) index;
+
+		for (int b = wrap(band, whole.h); b < whole.h + 5; b += whole.h)
+		{
+			const size_t first = whole.bandBases[b];
+			const size_t count = whole.bandBases[b+1] - first;
+
+			if (count > 0)
+				out.push_back(QuadRange(first, count, (band - b) / whole.h));
+		}
+	}
+
+	/* Quads actually holding tiles */
+	size_t zlayerQuads(size_t index) const
+	{
+		if (whole.active)
+		{
+			size_t quads = 0;
+
+			const int band = viewpPos.y + (int) index;
+
+			for (int b = wrap(band, whole.h); b < whole.h + 5; b += whole.h)
+				quads += whole.bandBases[b+1] - whole.bandBases[b];
+
+			return quads;
+		}
+
+		if (ring.active)
+			return ring.blockQuads[zlayerBlock(index)];
+
+		return zlayerVert[index].size() / 4;
 	}
 
 	void uploadBuffers()
@@ -736,20 +964,22 @@ struct TilemapPrivate
 		size_t groundQuadCount = groundVert.size() / 4;
 		size_t quadCount = groundQuadCount;
 
-		for (size_t i = 0; i < zlayersMax; ++i)
+		zlayerBases.resize(zlayerCount+1);
+
+		for (size_t i = 0; i < zlayerCount; ++i)
 		{
 			zlayerBases[i] = quadCount;
 			quadCount += zlayerVert[i].size() / 4;
 		}
 
-		zlayerBases[zlayersMax] = quadCount;
+		zlayerBases[zlayerCount] = quadCount;
 
 		VBO::bind(tiles.vbo);
 		VBO::allocEmpty(quadDataSize(quadCount));
 
 		VBO::uploadSubData(0, quadDataSize(groundQuadCount), dataPtr(groundVert));
 
-		for (size_t i = 0; i < zlayersMax; ++i)
+		for (size_t i = 0; i < zlayerCount; ++i)
 		{
 			if (zlayerVert[i].empty())
 				continue;
@@ -761,7 +991,491 @@ struct TilemapPrivate
 		VBO::unbind();
 
 		/* Ensure global IBO size */
-		shState->ensureQuadIBO(quadCount);
+		ensureQuadIBO(quadCount);
+	}
+
+	/* Larger ranges are drawn in parts, see drawQuads() */
+	static void ensureQuadIBO(size_t quadCount)
+	{
+		shState->ensureQuadIBO(std::min(quadCount, maxDrawQuads));
+	}
+
+	/* Largest amount of quads a single cell of the
+	 * map viewport adds to each layer kind */
+	void measureCells(size_t *caps)
+	{
+		for (int k = 0; k < layerKinds; ++k)
+			caps[k] = 0;
+
+		for (int x = 0; x < viewpW; ++x)
+			for (int y = 0; y < viewpH; ++y)
+			{
+				size_t quads[layerKinds] = { 0 };
+
+				for (int z = 0; z < mapData->zSize(); ++z)
+				{
+					int tileInd;
+					int prio = sampleTile(viewpPos.x + x, viewpPos.y + y, z, tileInd);
+
+					if (prio != -1)
+						quads[prio] += tileQuadCount(tileInd);
+				}
+
+				for (int k = 0; k < layerKinds; ++k)
+					caps[k] = std::max(caps[k], quads[k]);
+			}
+	}
+
+	/* Whether the slots stay small enough that drawing
+	 * their degenerate padding doesn't matter much */
+	bool ringFits(const size_t *caps) const
+	{
+		size_t blockSize = 0;
+
+		for (int prio = 1; prio < layerKinds; ++prio)
+			blockSize += viewpW * caps[prio];
+
+		size_t quadCount = viewpH * viewpW * caps[0] + zlayerCount * blockSize;
+
+		return quadCount <= (size_t) (viewpW * viewpH) * 32;
+	}
+
+	void setupRing(const size_t *caps)
+	{
+		size_t blockSize = 0;
+
+		for (int k = 0; k < layerKinds; ++k)
+			ring.cellCap[k] = caps[k];
+
+		for (int prio = 1; prio < layerKinds; ++prio)
+		{
+			ring.unitBase[prio] = blockSize;
+			blockSize += viewpW * caps[prio];
+		}
+
+		zlayerBases.resize(zlayerCount+1);
+		zlayerBases[0] = viewpH * viewpW * caps[0];
+
+		for (size_t i = 1; i <= zlayerCount; ++i)
+			zlayerBases[i] = zlayerBases[i-1] + blockSize;
+
+		ring.active = true;
+	}
+
+	/* First quad of map row 'my' in the ring area of 'kind' */
+	size_t ringUnit(int my, int kind) const
+	{
+		if (kind == 0)
+			return wrap(my, viewpH) * viewpW * ring.cellCap[0];
+
+		return zlayerBases[wrap(my + kind, zlayerCount)] + ring.unitBase[kind];
+	}
+
+	size_t ringSlot(int mx, int my, int kind) const
+	{
+		return ringUnit(my, kind) + wrap(mx, viewpW) * ring.cellCap[kind];
+	}
+
+	bool cellFitsRing() const
+	{
+		for (int k = 0; k < layerKinds; ++k)
+			if (cellVert[k].size() / 4 > ring.cellCap[k])
+				return false;
+
+		return true;
+	}
+
+	void setCellQuads(int mx, int my, int kind, size_t count)
+	{
+		const size_t slot = wrap(my, viewpH) * viewpW + wrap(mx, viewpW);
+		uint16_t &cell = ring.cellQuads[slot * layerKinds + kind];
+		size_t &total = (kind == 0) ? groundQuads
+		                            : ring.blockQuads[wrap(my + kind, zlayerCount)];
+
+		total = total - cell + count;
+		cell = count;
+	}
+
+	/* Generates the whole map viewport into the
+	 * ring layout and uploads it in one go */
+	void buildRing()
+	{
+		const size_t quadCount = zlayerBases[zlayerCount];
+
+		clearQuadArrays();
+		ring.cellQuads.assign(viewpH * viewpW * layerKinds, 0);
+		ring.blockQuads.assign(zlayerCount, 0);
+		groundQuads = 0;
+
+		/* Unused slots stay zeroed, making for degenerate quads */
+		SVVector vert(quadCount * 4);
+
+		for (int x = 0; x < viewpW; ++x)
+			for (int y = 0; y < viewpH; ++y)
+			{
+				const int mx = viewpPos.x + x;
+				const int my = viewpPos.y + y;
+
+				buildCell(mx, my);
+
+				for (int k = 0; k < layerKinds; ++k)
+				{
+					std::copy(cellVert[k].begin(), cellVert[k].end(),
+					          vert.begin() + ringSlot(mx, my, k) * 4);
+					setCellQuads(mx, my, k, cellVert[k].size() / 4);
+				}
+			}
+
+		VBO::bind(tiles.vbo);
+		VBO::uploadData(quadDataSize(quadCount), dataPtr(vert));
+		VBO::unbind();
+
+		ensureQuadIBO(quadCount);
+	}
+
+	bool wholeMapFits() const
+	{
+		const int w = mapData->xSize();
+		const int h = mapData->ySize();
+
+		if (w == 0 || h == 0)
+			return false;
+
+		return w * h <= shState->config().staticTilemapSize;
+	}
+
+	/* Generates the entire map into the
+	 * whole map layout and uploads it */
+	void buildWhole()
+	{
+		whole.w = mapData->xSize();
+		whole.h = mapData->ySize();
+
+		/* Band b holds the priority quads of map
+		 * rows b-5 to b-1 that share zlayer b */
+		std::vector<SVVector> bands(whole.h + 5);
+		SVVector vert;
+
+		whole.rowBases.resize(whole.h+1);
+
+		for (int y = 0; y < whole.h; ++y)
+		{
+			whole.rowBases[y] = vert.size() / 4;
+
+			for (int x = 0; x < whole.w; ++x)
+			{
+				buildCell(x, y);
+
+				vert.insert(vert.end(), cellVert[0].begin(), cellVert[0].end());
+
+				for (int prio = 1; prio < layerKinds; ++prio)
+				{
+					SVVector &band = bands[y + prio];
+					band.insert(band.end(), cellVert[prio].begin(), cellVert[prio].end());
+				}
+			}
+		}
+
+		whole.rowBases[whole.h] = groundQuads = vert.size() / 4;
+		whole.bandBases.resize(whole.h+6);
+
+		for (size_t b = 0; b < bands.size(); ++b)
+		{
+			whole.bandBases[b] = vert.size() / 4;
+			vert.insert(vert.end(), bands[b].begin(), bands[b].end());
+		}
+
+		const size_t quadCount = vert.size() / 4;
+		whole.bandBases[whole.h+5] = quadCount;
+
+		VBO::bind(tiles.vbo);
+		VBO::uploadData(quadDataSize(quadCount), dataPtr(vert));
+		VBO::unbind();
+
+		ensureQuadIBO(quadCount);
+
+		whole.active = true;
+	}
+
+	/* Regenerates the map viewport from scratch */
+	void rebuildBuffers()
+	{
+		whole.active = false;
+		ring.active = false;
+
+		if (wholeMapFits())
+		{
+			clearQuadArrays();
+			buildWhole();
+
+			return;
+		}
+
+		size_t caps[layerKinds];
+		measureCells(caps);
+
+		/* Keep room for cells seen before, so that
+		 * scrolling back to them needs no rebuild */
+		size_t grownCaps[layerKinds];
+
+		for (int k = 0; k < layerKinds; ++k)
+			grownCaps[k] = std::max(caps[k], ring.cellCap[k]);
+
+		if (ringFits(grownCaps))
+			setupRing(grownCaps);
+		else if (ringFits(caps))
+			setupRing(caps);
+
+		if (ring.active)
+		{
+			buildRing();
+		}
+		else
+		{
+			/* Too many stacked tiles per cell; pack
+			 * the layers tightly and rebuild on scroll */
+			buildQuadArray();
+			uploadBuffers();
+		}
+	}
+
+	/* Uploads the quads in 'cellVert' for map cell (mx, my) */
+	void storeCell(int mx, int my)
+	{
+		for (int k = 0; k < layerKinds; ++k)
+		{
+			const size_t cap = ring.cellCap[k];
+
+			if (cap == 0)
+				continue;
+
+			setCellQuads(mx, my, k, cellVert[k].size() / 4);
+
+			/* Pad with degenerate quads */
+			cellVert[k].resize(cap * 4);
+			VBO::uploadSubData(quadDataSize(ringSlot(mx, my, k)),
+			                   quadDataSize(cap), dataPtr(cellVert[k]));
+		}
+	}
+
+	/* Generates and uploads map row 'my'. Returns false if
+	 * a cell doesn't fit the ring, leaving the row unfinished */
+	bool storeRow(int my)
+	{
+		for (int k = 0; k < layerKinds; ++k)
+			rowVert[k].assign(viewpW * ring.cellCap[k] * 4, SVertex());
+
+		for (int x = 0; x < viewpW; ++x)
+		{
+			const int mx = viewpPos.x + x;
+
+			buildCell(mx, my);
+
+			if (!cellFitsRing())
+				return false;
+
+			for (int k = 0; k < layerKinds; ++k)
+			{
+				std::copy(cellVert[k].begin(), cellVert[k].end(),
+				          rowVert[k].begin() + wrap(mx, viewpW) * ring.cellCap[k] * 4);
+				setCellQuads(mx, my, k, cellVert[k].size() / 4);
+			}
+		}
+
+		for (int k = 0; k < layerKinds; ++k)
+		{
+			if (ring.cellCap[k] == 0)
+				continue;
+
+			VBO::uploadSubData(quadDataSize(ringUnit(my, k)),
+			                   quadDataSize(viewpW * ring.cellCap[k]), dataPtr(rowVert[k]));
+		}
+
+		return true;
+	}
+
+	/* Empties the zlayer quads of map row 'my'. Its ground
+	 * quads are overwritten by the row taking its place */
+	void clearRow(int my)
+	{
+		for (int prio = 1; prio < layerKinds; ++prio)
+		{
+			const size_t cap = ring.cellCap[prio];
+
+			if (cap == 0)
+				continue;
+
+			for (int x = 0; x < viewpW; ++x)
+				setCellQuads(viewpPos.x + x, my, prio, 0);
+
+			rowVert[prio].assign(viewpW * cap * 4, SVertex());
+			VBO::uploadSubData(quadDataSize(ringUnit(my, prio)),
+			                   quadDataSize(viewpW * cap), dataPtr(rowVert[prio]));
+		}
+	}
+
+	/* Moves the map viewport to 'pos', only generating the
+	 * rows and columns coming into view. Returns false if
+	 * the buffers have to be rebuilt instead */
+	bool scrollRing(const Vec2i &pos)
+	{
+		const Vec2i delta = pos - viewpPos;
+
+		if (abs(delta.x) >= viewpW || abs(delta.y) >= viewpH)
+			return false;
+
+		bool fits = true;
+
+		VBO::bind(tiles.vbo);
+
+		/* The column leaving the viewport shares
+		 * its slots with the one coming in */
+		while (fits && viewpPos.x != pos.x)
+		{
+			int mx;
+
+			if (pos.x > viewpPos.x)
+				mx = viewpPos.x++ + viewpW;
+			else
+				mx = --viewpPos.x;
+
+			for (int y = 0; y < viewpH && fits; ++y)
+			{
+				buildCell(mx, viewpPos.y + y);
+				fits = cellFitsRing();
+
+				if (fits)
+					storeCell(mx, viewpPos.y + y);
+			}
+		}
+
+		/* Rows moving in land in different zlayer blocks
+		 * than the ones moving out, which are cleared */
+		while (fits && viewpPos.y != pos.y)
+		{
+			int my;
+
+			if (pos.y > viewpPos.y)
+			{
+				clearRow(viewpPos.y);
+				my = viewpPos.y++ + viewpH;
+			}
+			else
+			{
+				clearRow(viewpPos.y + viewpH - 1);
+				my = --viewpPos.y;
+			}
+
+			fits = storeRow(my);
+		}
+
+		VBO::unbind();
+
+		viewpPos = pos;
+
+		return fits;
+	}
+
+	/* Regenerates map rows y1 to y2 (inclusive) in the whole
+	 * map layout. Returns false if their quad count changed,
+	 * so that the following ones would have to move */
+	bool updateWholeRows(int y1, int y2)
+	{
+		/* Bands y1+1 to y2+5 hold the priority quads
+		 * of rows y1-4 to y2+4, see buildWhole() */
+		const int firstBand = y1 + 1;
+		std::vector<SVVector> bands(y2 - y1 + 5);
+		SVVector ground;
+
+		for (int y = std::max(y1 - 4, 0); y <= std::min(y2 + 4, whole.h - 1); ++y)
+			for (int x = 0; x < whole.w; ++x)
+			{
+				buildCell(x, y);
+
+				if (y >= y1 && y <= y2)
+					ground.insert(ground.end(), cellVert[0].begin(), cellVert[0].end());
+
+				for (int prio = 1; prio < layerKinds; ++prio)
+				{
+					const int b = y + prio - firstBand;
+
+					if (b < 0 || b >= (int) bands.size())
+						continue;
+
+					bands[b].insert(bands[b].end(), cellVert[prio].begin(), cellVert[prio].end());
+				}
+			}
+
+		const size_t bandFirst = whole.bandBases[firstBand];
+		SVVector above;
+
+		for (size_t b = 0; b < bands.size(); ++b)
+			above.insert(above.end(), bands[b].begin(), bands[b].end());
+
+		const size_t groundFirst = whole.rowBases[y1];
+
+		if (ground.size() / 4 != whole.rowBases[y2+1] - groundFirst)
+			return false;
+
+		if (above.size() / 4 != whole.bandBases[y2+6] - bandFirst)
+			return false;
+
+		VBO::bind(tiles.vbo);
+		VBO::uploadSubData(quadDataSize(groundFirst), quadDataSize(ground.size() / 4), dataPtr(ground));
+		VBO::uploadSubData(quadDataSize(bandFirst), quadDataSize(above.size() / 4), dataPtr(above));
+		VBO::unbind();
+
+		return true;
+	}
+
+	/* Regenerates the cells in view that are in 'area' (in
+	 * table cells) in the ring layout. Returns false if one
+	 * doesn't fit its slots anymore */
+	bool updateRingCells(const IntRect &area)
+	{
+		bool fits = true;
+
+		VBO::bind(tiles.vbo);
+
+		for (int y = 0; y < viewpH && fits; ++y)
+			for (int x = 0; x < viewpW && fits; ++x)
+			{
+				const int mx = viewpPos.x + x;
+				const int my = viewpPos.y + y;
+
+				if (!tableAreaVisible(*mapData, IntRect(mx, my, 1, 1), area))
+					continue;
+
+				buildCell(mx, my);
+				fits = cellFitsRing();
+
+				if (fits)
+					storeCell(mx, my);
+			}
+
+		VBO::unbind();
+
+		return fits;
+	}
+
+	/* Brings the cells written to since the last
+	 * rebuild up to date, as far as they matter */
+	void updateDirtyCells()
+	{
+		const IntRect mapViewp(viewpPos, Vec2i(viewpW, viewpH));
+		bool done = false;
+
+		if (whole.active)
+			done = updateWholeRows(dirtyCells.y, dirtyCells.y + dirtyCells.h - 1);
+		else if (!tableAreaVisible(*mapData, mapViewp, dirtyCells))
+			done = true;
+		else if (ring.active)
+			done = updateRingCells(dirtyCells);
+
+		if (!done)
+			rebuildBuffers();
+
+		updateSceneElements();
 	}
 
 	void bindShader(ShaderBase *&shaderVar)
@@ -782,17 +1496,86 @@ struct TilemapPrivate
 		shaderVar->applyViewportProj();
 	}
 
+	/* Vertex positions are in map pixels */
+	Vec2i drawOffset() const
+	{
+		return dispPos - viewpPos * 32;
+	}
+
 	void bindAtlas(ShaderBase &shader)
 	{
 		TEX::bind(atlas.gl.tex);
 		shader.setTexSize(atlas.size);
 	}
 
-	void updateActiveElements(std::vector<int> &zlayerInd)
+	/* Draws 'count' quads of the shared buffer from 'first' on,
+	 * in as many parts as the index type requires */
+	void drawQuads(size_t first, size_t count)
+	{
+		while (count > 0)
+		{
+			const size_t part = std::min(count, maxDrawQuads);
+
+			GLMeta::vaoSetBase(tiles.vao, first * 4);
+			gl.DrawElements(GL_TRIANGLES, part * 6, _GL_INDEX_TYPE, (GLvoid*) 0);
+
+			first += part;
+			count -= part;
+		}
+	}
+
+	/* In the whole map layout, the range is drawn once for
+	 * every repetition of the map in view horizontally */
+	void drawRange(ShaderBase &shader, const QuadRange &range)
+	{
+		if (!whole.active)
+		{
+			shader.setTranslation(drawOffset());
+			drawQuads(range.first, range.count);
+
+			return;
+		}
+
+		const int firstRep = floorDiv(viewpPos.x, whole.w);
+		const int lastRep = floorDiv(viewpPos.x + viewpW - 1, whole.w);
+
+		for (int rep = firstRep; rep <= lastRep; ++rep)
+		{
+			const Vec2i shift(rep * whole.w, range.shiftY * whole.h);
+
+			shader.setTranslation(drawOffset() + shift * 32);
+			drawQuads(range.first, range.count);
+		}
+	}
+
+	void drawGround(ShaderBase &shader)
 	{
-		elem.ground->updateVboCount();
+		if (!whole.active)
+		{
+			drawRange(shader, QuadRange(0, zlayerBases[0], 0));
 
-		for (size_t i = 0; i < zlayersMax; ++i)
+			return;
+		}
+
+		/* Visible rows, split where the map wraps around */
+		const int end = viewpPos.y + viewpH;
+
+		for (int y = viewpPos.y; y < end;)
+		{
+			const int row = wrap(y, whole.h);
+			const int rows = std::min(whole.h - row, end - y);
+			const size_t first = whole.rowBases[row];
+
+			drawRange(shader, QuadRange(first, whole.rowBases[row + rows] - first,
+			                            floorDiv(y, whole.h)));
+
+			y += rows;
+		}
+	}
+
+	void updateActiveElements(std::vector<int> &zlayerInd)
+	{
+		for (size_t i = 0; i < elem.zlayers.size(); ++i)
 		{
 			if (i < zlayerInd.size())
 			{
@@ -813,8 +1596,8 @@ struct TilemapPrivate
 		/* Only allocate elements for non-emtpy zlayers */
 		std::vector<int> zlayerInd;
 
-		for (size_t i = 0; i < zlayersMax; ++i)
-			if (zlayerVert[i].size() > 0)
+		for (size_t i = 0; i < zlayerCount; ++i)
+			if (zlayerQuads(i) > 0)
 				zlayerInd.push_back(i);
 
 		updateActiveElements(zlayerInd);
@@ -826,7 +1609,7 @@ struct TilemapPrivate
 	{
 		elem.ground->setVisible(false);
 
-		for (size_t i = 0; i < zlayersMax; ++i)
+		for (size_t i = 0; i < elem.zlayers.size(); ++i)
 			elem.zlayers[i]->setVisible(false);
 	}
 
@@ -852,7 +1635,7 @@ struct TilemapPrivate
 	/* When there are two or more zlayers with no other
 	 * elements between them in the scene list, we can
 	 * render them in a batch (as the zlayer data itself
-	 * is ordered sequentially in VRAM). Every frame, we
+	 * is mostly ordered sequentially in VRAM). Every frame, we
 	 * scan the scene list for such sequential layers and
 	 * batch them up for drawing. The first layer of the batch
 	 * (the "batch head") executes the draw call, all others
@@ -860,16 +1643,24 @@ struct TilemapPrivate
 	 * single sized batches are possible. */
 	void prepareZLayerBatches()
 	{
-		ZLayer *const *zlayers = elem.zlayers;
+		const std::vector<ZLayer*> &zlayers = elem.zlayers;
 
 		for (size_t i = 0; i < elem.activeLayers; ++i)
 		{
 			ZLayer *batchHead = zlayers[i];
 			batchHead->batchedFlag = false;
 
-			GLsizei vboBatchCount = batchHead->vboCount;
+			const QuadRange &head = batchHead->ranges.front();
+			size_t batchCount = head.count;
 			IntruListLink<SceneElement> *iter = &batchHead->link;
 
+			/* Layers drawn in pieces can't join a batch */
+			if (batchHead->ranges.size() > 1)
+			{
+				batchHead->batchCount = batchCount;
+				continue;
+			}
+
 			for (i = i+1; i < elem.activeLayers; ++i)
 			{
 				iter = iter->next;
@@ -881,11 +1672,22 @@ struct TilemapPrivate
 				if (iter != &layer->link)
 					break;
 
-				vboBatchCount += layer->vboCount;
+				if (layer->ranges.size() > 1)
+					break;
+
+				const QuadRange &range = layer->ranges.front();
+
+				/* Zlayers follow each other in the buffer, except
+				 * where the ring or map wraps around. Blocks of empty
+				 * zlayers in between only hold degenerate quads */
+				if (range.first < head.first || range.shiftY != head.shiftY)
+					break;
+
+				batchCount = range.first - head.first + range.count;
 				layer->batchedFlag = true;
 			}
 
-			batchHead->vboBatchCount = vboBatchCount;
+			batchHead->batchCount = batchCount;
 			--i;
 		}
 	}
@@ -894,11 +1696,34 @@ struct TilemapPrivate
 	{
 		const Vec2i combOrigin = origin + elem.sceneGeo.orig;
 		const Vec2i mvpPos = getTilePos(combOrigin);
+		const Vec2i sceneSize = elem.sceneGeo.rect.size();
 
-		if (mvpPos != viewpPos)
+		if (mapViewportSize(sceneSize) != Vec2i(viewpW, viewpH))
 		{
+			resizeMapViewport(sceneSize);
 			viewpPos = mvpPos;
 			buffersDirty = true;
+
+			updateFlashMapViewport();
+		}
+		else if (mvpPos != viewpPos)
+		{
+			if (whole.active && !buffersDirty)
+			{
+				/* Everything is on the GPU already */
+				viewpPos = mvpPos;
+				updateSceneElements();
+			}
+			else if (ring.active && !buffersDirty && scrollRing(mvpPos))
+			{
+				updateSceneElements();
+			}
+			else
+			{
+				viewpPos = mvpPos;
+				buffersDirty = true;
+			}
+
 			updateFlashMapViewport();
 		}
 
@@ -907,6 +1732,11 @@ struct TilemapPrivate
 
 	void prepare()
 	{
+		/* Layer batching depends on whatever else sits in
+		 * the scene list around our layers, which can change
+		 * without us noticing, so stay queued for good */
+		schedulePrepare();
+
 		if (!verifyResources())
 		{
 			if (tilemapReady)
@@ -936,11 +1766,16 @@ struct TilemapPrivate
 
 		if (buffersDirty)
 		{
-			buildQuadArray();
-			uploadBuffers();
+			rebuildBuffers();
 			updateSceneElements();
 			buffersDirty = false;
 		}
+		else if (cellsDirty)
+		{
+			updateDirtyCells();
+		}
+
+		cellsDirty = false;
 
 		flashMap.prepare();
 
@@ -958,20 +1793,14 @@ struct TilemapPrivate
 
 GroundLayer::GroundLayer(TilemapPrivate *p, Viewport *viewport)
     : ViewportElement(viewport, 0),
-      vboCount(0),
       p(p)
 {
 	onGeometryChange(scene->getGeometry());
 }
 
-void GroundLayer::updateVboCount()
-{
-	vboCount = p->zlayerBases[0] * 6;
-}
-
 void GroundLayer::draw()
 {
-	if (p->groundVert.size() == 0)
+	if (p->groundQuads == 0)
 		return;
 
 	ShaderBase *shader;
@@ -981,19 +1810,13 @@ void GroundLayer::draw()
 
 	GLMeta::vaoBind(p->tiles.vao);
 
-	shader->setTranslation(p->dispPos);
-	drawInt();
+	p->drawGround(*shader);
 
 	GLMeta::vaoUnbind(p->tiles.vao);
 
 	p->flashMap.draw(flashAlpha[p->flashAlphaIdx] / 255.f, p->dispPos);
 }
 
-void GroundLayer::drawInt()
-{
-	gl.DrawElements(GL_TRIANGLES, vboCount, _GL_INDEX_TYPE, (GLvoid*) 0);
-}
-
 void GroundLayer::onGeometryChange(const Scene::Geometry &geo)
 {
 	p->updateSceneGeometry(geo);
@@ -1002,10 +1825,9 @@ void GroundLayer::onGeometryChange(const Scene::Geometry &geo)
 ZLayer::ZLayer(TilemapPrivate *p, Viewport *viewport)
     : ViewportElement(viewport, 0),
       index(0),
-      vboOffset(0),
-      vboCount(0),
       p(p),
-      vboBatchCount(0)
+      batchedFlag(false),
+      batchCount(0)
 {}
 
 void ZLayer::setIndex(int value)
@@ -1015,8 +1837,7 @@ void ZLayer::setIndex(int value)
 	z = calculateZ(p, index);
 	scene->reinsert(*this);
 
-	vboOffset = p->zlayerBases[index] * sizeof(index_t) * 6;
-	vboCount = p->zlayerSize(index) * 6;
+	p->zlayerRanges(index, ranges);
 }
 
 void ZLayer::draw()
@@ -1031,15 +1852,20 @@ void ZLayer::draw()
 
 	GLMeta::vaoBind(p->tiles.vao);
 
-	shader->setTranslation(p->dispPos);
-	drawInt();
+	if (ranges.size() == 1)
+	{
+		QuadRange batch = ranges.front();
+		batch.count = batchCount;
 
-	GLMeta::vaoUnbind(p->tiles.vao);
-}
+		p->drawRange(*shader, batch);
+	}
+	else
+	{
+		for (size_t i = 0; i < ranges.size(); ++i)
+			p->drawRange(*shader, ranges[i]);
+	}
 
-void ZLayer::drawInt()
-{
-	gl.DrawElements(GL_TRIANGLES, vboBatchCount, _GL_INDEX_TYPE, (GLvoid*) vboOffset);
+	GLMeta::vaoUnbind(p->tiles.vao);
 }
 
 int ZLayer::calculateZ(TilemapPrivate *p, int index)
@@ -1121,14 +1947,21 @@ void Tilemap::update()
 	if (++p->flashAlphaIdx >= flashAlphaN)
 		p->flashAlphaIdx = 0;
 
+	if (p->flashMap.getData())
+		shState->markDirty();
+
 	/* Animate autotiles */
 	if (!p->tiles.animated)
 		return;
 
+	uint8_t lastFrameIdx = p->tiles.frameIdx;
 	p->tiles.frameIdx = atAnimation[p->tiles.aniIdx];
 
 	if (++p->tiles.aniIdx >= atAnimationN)
 		p->tiles.aniIdx = 0;
+
+	if (p->tiles.frameIdx != lastFrameIdx)
+		shState->markDirty();
 }
 
 Tilemap::Autotiles &Tilemap::getAutotiles()
@@ -1155,6 +1988,7 @@ void Tilemap::setTileset(Bitmap *value)
 		return;
 
 	p->tileset = value;
+	shState->markDirty();
 
 	if (!value)
 		return;
@@ -1175,6 +2009,7 @@ void Tilemap::setMapData(Table *value)
 		return;
 
 	p->mapData = value;
+	shState->markDirty();
 
 	if (!value)
 		return;
@@ -1182,7 +2017,7 @@ void Tilemap::setMapData(Table *value)
 	p->invalidateBuffers();
 	p->mapDataCon.disconnect();
 	p->mapDataCon = value->modified.connect
-	        (sigc::mem_fun(p, &TilemapPrivate::invalidateBuffers));
+	        (sigc::mem_fun(p, &TilemapPrivate::onMapDataModified));
 }
 
 void Tilemap::setFlashData(Table *value)
@@ -1200,6 +2035,7 @@ void Tilemap::setPriorities(Table *value)
 		return;
 
 	p->priorities = value;
+	shState->markDirty();
 
 	if (!value)
 		return;
@@ -1225,6 +2061,8 @@ void Tilemap::setVisible(bool value)
 	p->elem.ground->setVisible(value);
 	for (size_t i = 0; i < p->elem.activeLayers; ++i)
 		p->elem.zlayers[i]->setVisible(value);
+
+	shState->markDirty();
 }
 
 void Tilemap::setOX(int value)
@@ -1236,6 +2074,8 @@ void Tilemap::setOX(int value)
 
 	p->origin.x = value;
 	p->mapViewportDirty = true;
+
+	shState->markDirty();
 }
 
 void Tilemap::setOY(int value)
@@ -1248,6 +2088,8 @@ void Tilemap::setOY(int value)
 	p->origin.y = value;
 	p->zOrderDirty = true;
 	p->mapViewportDirty = true;
+
+	shState->markDirty();
 }
 
 void Tilemap::releaseResources()
@@ -51,7 +51,7 @@ static const uint8_t flashAlpha[] =
 
 static elementsN(flashAlpha);
 
-struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
+struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader, Preparable
 {
 	Bitmap *bitmaps[BM_COUNT];
 
@@ -90,7 +90,6 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	sigc::connection mapDataCon;
 	sigc::connection flagsCon;
 
-	sigc::connection prepareCon;
 	sigc::connection bmChangedCons[BM_COUNT];
 	sigc::connection bmDisposedCons[BM_COUNT];
 
@@ -122,6 +121,7 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	      groundQuads(0),
 	      aboveQuads(0),
 	      frameIdx(0),
+	      flashMap(*this),
 	      flashAlphaIdx(0),
 	      atlasDirty(true),
 	      buffersDirty(false),
@@ -140,9 +140,6 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 		GLMeta::vaoInit(vao);
 
 		onGeometryChange(scene->getGeometry());
-
-		prepareCon = shState->prepareDraw.connect
-			(sigc::mem_fun(this, &TilemapVXPrivate::prepare));
 	}
 
 	virtual ~TilemapVXPrivate()
@@ -152,8 +149,6 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 
 		shState->releaseAtlasTex(atlas);
 
-		prepareCon.disconnect();
-
 		mapDataCon.disconnect();
 		flagsCon.disconnect();
 
@@ -167,11 +162,31 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	void invalidateAtlas()
 	{
 		atlasDirty = true;
+		schedulePrepare();
+		shState->markDirty();
 	}
 
 	void invalidateBuffers()
 	{
 		buffersDirty = true;
+		schedulePrepare();
+		shState->markDirty();
+	}
+
+	void onMapDataModified()
+	{
+		/* Only the tile layers (and the shadow layer on RGSS3)
+		 * are drawn, so writes to further layers (eg. scripts
+		 * keeping their own data there) or outside of the map
+		 * viewport don't change what we have to draw */
+		const int drawnLayers = std::min(mapData->zSize(), rgssVer >= 3 ? 4 : 3);
+
+		for (int z = 0; z < drawnLayers; ++z)
+			if (tableAreaVisible(*mapData, mapViewp, mapData->dirtyRect(z)))
+			{
+				invalidateBuffers();
+				return;
+			}
 	}
 
 	void rebuildAtlas()
@@ -352,6 +367,7 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 
 		buffersDirty = true;
 		mapViewportDirty = true;
+		schedulePrepare();
 	}
 
 	ABOUT_TO_ACCESS_NOOP
@@ -379,7 +395,7 @@ void TilemapVX::BitmapArray::set(int i, Bitmap *bitmap)
 		return;
 
 	p->bitmaps[i] = bitmap;
-	p->atlasDirty = true;
+	p->invalidateAtlas();
 
 	p->bmChangedCons[i].disconnect();
 	p->bmChangedCons[i] = bitmap->modified.connect
@@ -428,11 +444,19 @@ void TilemapVX::update()
 	uint8_t aniIdxA = aniIndicesA[p->frameIdx / 30];
 	uint8_t aniIdxC = aniIndicesC[p->frameIdx / 30];
 
-	p->aniOffset = Vec2(aniIdxA * 2 * 32, aniIdxC * 32);
+	Vec2 aniOffset(aniIdxA * 2 * 32, aniIdxC * 32);
+
+	if (!(aniOffset == p->aniOffset))
+		shState->markDirty();
+
+	p->aniOffset = aniOffset;
 
 	/* Animate flash */
 	if (++p->flashAlphaIdx >= flashAlphaN)
 		p->flashAlphaIdx = 0;
+
+	if (p->flashMap.getData())
+		shState->markDirty();
 }
 
 TilemapVX::BitmapArray &TilemapVX::getBitmapArray()
@@ -468,6 +492,8 @@ void TilemapVX::setViewport(Viewport *value)
 
 	p->setViewport(value);
 	p->above.setViewport(value);
+
+	shState->markDirty();
 }
 
 void TilemapVX::setMapData(Table *value)
@@ -478,11 +504,11 @@ void TilemapVX::setMapData(Table *value)
 		return;
 
 	p->mapData = value;
-	p->buffersDirty = true;
+	p->invalidateBuffers();
 
 	p->mapDataCon.disconnect();
 	p->mapDataCon = value->modified.connect
-		(sigc::mem_fun(p, &TilemapVXPrivate::invalidateBuffers));
+		(sigc::mem_fun(p, &TilemapVXPrivate::onMapDataModified));
 }
 
 void TilemapVX::setFlashData(Table *value)
@@ -500,7 +526,7 @@ void TilemapVX::setFlags(Table *value)
 		return;
 
 	p->flags = value;
-	p->buffersDirty = true;
+	p->invalidateBuffers();
 
 	p->flagsCon.disconnect();
 	p->flagsCon = value->modified.connect
@@ -513,6 +539,8 @@ void TilemapVX::setVisible(bool value)
 
 	p->setVisible(value);
 	p->above.setVisible(value);
+
+	shState->markDirty();
 }
 
 void TilemapVX::setOX(int value)
@@ -524,6 +552,9 @@ void TilemapVX::setOX(int value)
 
 	p->origin.x = value;
 	p->mapViewportDirty = true;
+	p->schedulePrepare();
+
+	shState->markDirty();
 }
 
 void TilemapVX::setOY(int value)
@@ -535,6 +566,9 @@ void TilemapVX::setOY(int value)
 
 	p->origin.y = value;
 	p->mapViewportDirty = true;
+	p->schedulePrepare();
+
+	shState->markDirty();
 }
 
 void TilemapVX::releaseResources()
@@ -144,11 +144,25 @@ inline C *dataPtr(std::vector<C> &v)
 	location = value; \
 }
 
+/* Like DEF_ATTR_SIMPLE_DETAILED, but runs 'notify' after
+ * the value was set */
+#define DEF_ATTR_NOTIFY_DETAILED(klass, name, type, location, notify, keyword1) \
+	DEF_ATTR_RD_SIMPLE_DETAILED(klass, name, type, location, keyword1) \
+	void klass :: set##name(type value) \
+{ \
+	guardDisposed(); \
+	location = value; \
+	notify; \
+}
+
 #define DEF_ATTR_RD_SIMPLE(klass, name, type, location) \
 	DEF_ATTR_RD_SIMPLE_DETAILED(klass, name, type, location, const)
 #define DEF_ATTR_SIMPLE(klass, name, type, location) \
 	DEF_ATTR_SIMPLE_DETAILED(klass, name, type, location, const)
 
+#define DEF_ATTR_NOTIFY(klass, name, type, location, notify) \
+	DEF_ATTR_NOTIFY_DETAILED(klass, name, type, location, notify, const)
+
 #define DEF_ATTR_SIMPLE_STATIC(klass, name, type, location) \
 	DEF_ATTR_SIMPLE_DETAILED(klass, name, type, location, )
 
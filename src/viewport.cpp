@@ -69,6 +69,8 @@ struct ViewportPrivate
 		self->geometry.rect = rect->toIntRect();
 		self->notifyGeometryChange();
 		recomputeOnScreen();
+
+		shState->markDirty();
 	}
 
 	void updateRectCon()
@@ -147,9 +149,9 @@ void Viewport::update()
 DEF_ATTR_RD_SIMPLE(Viewport, OX,   int,   geometry.orig.x)
 DEF_ATTR_RD_SIMPLE(Viewport, OY,   int,   geometry.orig.y)
 
-DEF_ATTR_SIMPLE(Viewport, Rect,  Rect&,  *p->rect)
-DEF_ATTR_SIMPLE(Viewport, Color, Color&, *p->color)
-DEF_ATTR_SIMPLE(Viewport, Tone,  Tone&,  *p->tone)
+DEF_ATTR_NOTIFY(Viewport, Rect,  Rect&,  *p->rect,  shState->markDirty())
+DEF_ATTR_NOTIFY(Viewport, Color, Color&, *p->color, shState->markDirty())
+DEF_ATTR_NOTIFY(Viewport, Tone,  Tone&,  *p->tone,  shState->markDirty())
 
 void Viewport::setOX(int value)
 {
@@ -160,6 +162,8 @@ void Viewport::setOX(int value)
 
 	geometry.orig.x = value;
 	notifyGeometryChange();
+
+	shState->markDirty();
 }
 
 void Viewport::setOY(int value)
@@ -171,6 +175,8 @@ void Viewport::setOY(int value)
 
 	geometry.orig.y = value;
 	notifyGeometryChange();
+
+	shState->markDirty();
 }
 
 void Viewport::initDynAttribs()
@@ -0,0 +1,152 @@
+/*
+** vram.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "vram.h"
+
+#include "boost-hash.h"
+
+namespace VRAM
+{
+
+struct Entry
+{
+	size_t bytes;
+	Category cat;
+};
+
+static BoostHash<GLuint, Entry> entries;
+static size_t catBytes[CategoryCount];
+static size_t totalBytes = 0;
+
+static size_t budgetBytes = 0;
+
+/* Above budget since the last time it was below */
+static bool overBudget = false;
+static bool pressure = false;
+
+static void updatePressure()
+{
+	if (budgetBytes == 0 || totalBytes <= budgetBytes)
+	{
+		overBudget = false;
+		return;
+	}
+
+	if (!overBudget)
+		pressure = true;
+
+	overBudget = true;
+}
+
+const char *categoryName(Category cat)
+{
+	static const char *names[] =
+	{
+		"bitmaps",
+		"texture_pool",
+		"tilemaps",
+		"screen",
+		"scratch",
+		"text"
+	};
+
+	return names[cat];
+}
+
+void allocated(GLuint tex, int width, int height, Category cat)
+{
+	freed(tex);
+
+	Entry entry;
+	entry.bytes = (size_t) width * height * 4;
+	entry.cat = cat;
+
+	entries.insert(tex, entry);
+	catBytes[cat] += entry.bytes;
+	totalBytes += entry.bytes;
+
+	updatePressure();
+}
+
+void freed(GLuint tex)
+{
+	if (!entries.contains(tex))
+		return;
+
+	const Entry entry = entries.value(tex);
+	entries.remove(tex);
+
+	catBytes[entry.cat] -= entry.bytes;
+	totalBytes -= entry.bytes;
+
+	updatePressure();
+}
+
+void setCategory(GLuint tex, Category cat)
+{
+	if (!entries.contains(tex))
+		return;
+
+	Entry &entry = entries[tex];
+
+	catBytes[entry.cat] -= entry.bytes;
+	catBytes[cat] += entry.bytes;
+	entry.cat = cat;
+}
+
+size_t bytes(Category cat)
+{
+	return catBytes[cat];
+}
+
+size_t total()
+{
+	return totalBytes;
+}
+
+void setBudget(size_t bytes)
+{
+	budgetBytes = bytes;
+	updatePressure();
+}
+
+size_t budget()
+{
+	return budgetBytes;
+}
+
+size_t excess(size_t extra)
+{
+	if (budgetBytes == 0 || totalBytes + extra <= budgetBytes)
+		return 0;
+
+	return totalBytes + extra - budgetBytes;
+}
+
+bool takePressure()
+{
+	bool result = pressure && overBudget;
+	pressure = false;
+
+	return result;
+}
+
+}
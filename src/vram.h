@@ -0,0 +1,81 @@
+/*
+** vram.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef VRAM_H
+#define VRAM_H
+
+#include "gl-fun.h"
+
+#include <stddef.h>
+
+/* Accounts for the memory held by texture storage, as
+ * allocated through TEX::allocEmpty, per category of user.
+ * Only ever used from the thread owning the GL context */
+namespace VRAM
+{
+	enum Category
+	{
+		/* Bitmap and window contents, atlas pages */
+		Bitmaps,
+		/* Textures kept by TexPool for reuse */
+		TexturePool,
+		/* Tileset atlases */
+		Tilemaps,
+		/* Render targets, frozen and transition frames */
+		Screen,
+		/* Shared intermediate textures */
+		Scratch,
+		/* Glyph atlas and text render targets */
+		Text,
+
+		CategoryCount
+	};
+
+	/* Name as exposed to scripts */
+	const char *categoryName(Category cat);
+
+	/* Records new storage of 'tex', replacing
+	 * whatever it was allocated with before */
+	void allocated(GLuint tex, int width, int height, Category cat);
+
+	/* Forgets about 'tex' (no-op if it was never allocated) */
+	void freed(GLuint tex);
+
+	/* Moves the bytes of 'tex' to 'cat' */
+	void setCategory(GLuint tex, Category cat);
+
+	size_t bytes(Category cat);
+	size_t total();
+
+	/* Soft cap on total(), 0 meaning none */
+	void setBudget(size_t bytes);
+	size_t budget();
+
+	/* Amount total() would exceed the budget
+	 * by with 'extra' more bytes allocated */
+	size_t excess(size_t extra = 0);
+
+	/* Returns true once each time total() has risen above
+	 * the budget, and only if it still is above it */
+	bool takePressure();
+}
+
+#endif // VRAM_H
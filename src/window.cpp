@@ -33,6 +33,7 @@
 #include "quadarray.h"
 #include "texpool.h"
 #include "glstate.h"
+#include "preparequeue.h"
 
 #include <sigc++/connection.h>
 
@@ -166,7 +167,7 @@ struct QuadChunk
  *   quad array directly to the screen.
  */
 
-struct WindowPrivate
+struct WindowPrivate : public Preparable
 {
 	Bitmap *windowskin;
 
@@ -246,8 +247,6 @@ struct WindowPrivate
 
 	EtcTemps tmp;
 
-	sigc::connection prepareCon;
-
 	WindowPrivate(Viewport *viewport = 0)
 	    : windowskin(0),
 	      contents(0),
@@ -273,15 +272,13 @@ struct WindowPrivate
 		cursorVert.count = 9;
 		pauseAniVert.count = 1;
 
-		prepareCon = shState->prepareDraw.connect
-		        (sigc::mem_fun(this, &WindowPrivate::prepare));
+		schedulePrepare();
 	}
 
 	~WindowPrivate()
 	{
 		shState->texPool().release(baseTex);
 		cursorRectCon.disconnect();
-		prepareCon.disconnect();
 	}
 
 	void markControlVertDirty()
@@ -417,7 +414,7 @@ struct WindowPrivate
 	{
 		/* Discard old buffer */
 		TEX::bind(baseTex.tex);
-		TEX::allocEmpty(baseTex.width, baseTex.height);
+		TEX::allocEmpty(baseTex.tex, baseTex.texWidth, baseTex.texHeight, VRAM::Bitmaps);
 		TEX::unbind();
 
 		FBO::bind(baseTex.fbo);
@@ -563,7 +560,7 @@ struct WindowPrivate
 
 		if (useBaseTex)
 		{
-			shader.setTexSize(Vec2i(baseTex.width, baseTex.height));
+			shader.setTexSize(Vec2i(baseTex.texWidth, baseTex.texHeight));
 
 			TEX::bind(baseTex.tex);
 			baseTexQuad.draw();
@@ -661,7 +658,10 @@ struct WindowPrivate
 		}
 
 		if (updateArray)
+		{
 			controlsQuadArray.commit();
+			shState->markDirty();
+		}
 	}
 
 	void stepAnimations()
@@ -697,9 +697,9 @@ void Window::update()
 	p->stepAnimations();
 }
 
-DEF_ATTR_SIMPLE(Window, X,          int,     p->position.x)
-DEF_ATTR_SIMPLE(Window, Y,          int,     p->position.y)
-DEF_ATTR_SIMPLE(Window, CursorRect, Rect&,  *p->cursorRect)
+DEF_ATTR_NOTIFY(Window, X,          int,     p->position.x, shState->markDirty())
+DEF_ATTR_NOTIFY(Window, Y,          int,     p->position.y, shState->markDirty())
+DEF_ATTR_NOTIFY(Window, CursorRect, Rect&,  *p->cursorRect, shState->markDirty())
 
 DEF_ATTR_RD_SIMPLE(Window, Windowskin,      Bitmap*, p->windowskin)
 DEF_ATTR_RD_SIMPLE(Window, Contents,        Bitmap*, p->contents)
@@ -719,6 +719,7 @@ void Window::setWindowskin(Bitmap *value)
 	guardDisposed();
 
 	p->windowskin = value;
+	shState->markDirty();
 
 	if (nullOrDisposed(value))
 		return;
@@ -735,6 +736,7 @@ void Window::setContents(Bitmap *value)
 
 	p->contents = value;
 	p->controlsVertDirty = true;
+	shState->markDirty();
 
 	if (nullOrDisposed(value))
 		return;
@@ -752,6 +754,9 @@ void Window::setStretch(bool value)
 
 	p->bgStretch = value;
 	p->baseVertDirty = true;
+	p->schedulePrepare();
+
+	shState->markDirty();
 }
 
 void Window::setActive(bool value)
@@ -763,6 +768,8 @@ void Window::setActive(bool value)
 
 	p->active = value;
 	p->cursorAniAlphaIdx = 0;
+
+	shState->markDirty();
 }
 
 void Window::setPause(bool value)
@@ -776,6 +783,8 @@ void Window::setPause(bool value)
 	p->pauseAniAlphaIdx = 0;
 	p->pauseAniQuadIdx = 0;
 	p->controlsVertDirty = true;
+
+	shState->markDirty();
 }
 
 void Window::setWidth(int value)
@@ -787,6 +796,9 @@ void Window::setWidth(int value)
 
 	p->size.x = value;
 	p->baseVertDirty = true;
+	p->schedulePrepare();
+
+	shState->markDirty();
 }
 
 void Window::setHeight(int value)
@@ -798,6 +810,9 @@ void Window::setHeight(int value)
 
 	p->size.y = value;
 	p->baseVertDirty = true;
+	p->schedulePrepare();
+
+	shState->markDirty();
 }
 
 void Window::setOX(int value)
@@ -809,6 +824,8 @@ void Window::setOX(int value)
 
 	p->contentsOffset.x = value;
 	p->controlsVertDirty = true;
+
+	shState->markDirty();
 }
 
 void Window::setOY(int value)
@@ -820,6 +837,8 @@ void Window::setOY(int value)
 
 	p->contentsOffset.y = value;
 	p->controlsVertDirty = true;
+
+	shState->markDirty();
 }
 
 void Window::setOpacity(int value)
@@ -831,6 +850,9 @@ void Window::setOpacity(int value)
 
 	p->opacity = value;
 	p->opacityDirty = true;
+	p->schedulePrepare();
+
+	shState->markDirty();
 }
 
 void Window::setBackOpacity(int value)
@@ -842,6 +864,9 @@ void Window::setBackOpacity(int value)
 
 	p->backOpacity = value;
 	p->opacityDirty = true;
+	p->schedulePrepare();
+
+	shState->markDirty();
 }
 
 void Window::setContentsOpacity(int value)
@@ -853,6 +878,8 @@ void Window::setContentsOpacity(int value)
 
 	p->contentsOpacity = value;
 	p->contentsQuad.setColor(Vec4(1, 1, 1, p->contentsOpacity.norm));
+
+	shState->markDirty();
 }
 
 void Window::initDynAttribs()
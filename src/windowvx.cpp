@@ -31,6 +31,7 @@
 #include "tilequad.h"
 #include "glstate.h"
 #include "shader.h"
+#include "preparequeue.h"
 
 #include <limits>
 #include <algorithm>
@@ -148,7 +149,7 @@ static const uint8_t pauseQuad[] =
 
 static elementsN(pauseQuad);
 
-struct WindowVXPrivate
+struct WindowVXPrivate : public Preparable
 {
 	Bitmap *windowskin;
 
@@ -181,7 +182,6 @@ struct WindowVXPrivate
 
 	sigc::connection cursorRectCon;
 	sigc::connection toneCon;
-	sigc::connection prepareCon;
 
 	EtcTemps tmp;
 
@@ -263,12 +263,11 @@ struct WindowVXPrivate
 			ctrlVertDirty = true;
 		}
 
-		prepareCon = shState->prepareDraw.connect
-			(sigc::mem_fun(this, &WindowVXPrivate::prepare));
-
 		refreshCursorRectCon();
 		refreshToneCon();
 		updateBaseQuad();
+
+		schedulePrepare();
 	}
 
 	~WindowVXPrivate()
@@ -277,17 +276,18 @@ struct WindowVXPrivate
 
 		cursorRectCon.disconnect();
 		toneCon.disconnect();
-		prepareCon.disconnect();
 	}
 
 	void invalidateCursorVert()
 	{
 		cursorVertDirty = true;
+		schedulePrepare();
 	}
 
 	void invalidateBaseTex()
 	{
 		base.texDirty = true;
+		schedulePrepare();
 	}
 
 	void refreshCursorRectCon()
@@ -636,6 +636,8 @@ struct WindowVXPrivate
 		Quad::setColor(pauseVert, Vec4(1, 1, 1, pauseAlpha[pauseAlphaIdx] / 255.0f));
 
 		ctrlVertArrayDirty = true;
+		schedulePrepare();
+		shState->markDirty();
 	}
 
 	void updateCursorAlpha()
@@ -649,21 +651,39 @@ struct WindowVXPrivate
 			Quad::setColor(&cursorVert.vertices[i*4], color);
 
 		cursorVertArrayDirty = true;
+		schedulePrepare();
+		shState->markDirty();
 	}
 
+	/* Only touches the vertices (and schedules a commit)
+	 * when a step actually changes what's displayed */
 	void stepAnimations()
 	{
 		if (active)
+		{
+			const uint8_t prevAlpha = cursorAlpha[cursorAlphaIdx];
+
 			if (++cursorAlphaIdx == cursorAlphaN)
 				cursorAlphaIdx = 0;
 
+			if (cursorAlpha[cursorAlphaIdx] != prevAlpha)
+				updateCursorAlpha();
+		}
+
 		if (pause)
 		{
+			const uint8_t prevAlpha = pauseAlpha[pauseAlphaIdx];
+			const uint8_t prevQuad = pauseQuad[pauseQuadIdx];
+
 			if (pauseAlphaIdx < pauseAlphaN-1)
 				++pauseAlphaIdx;
 
 			if (++pauseQuadIdx == pauseQuadN)
 				pauseQuadIdx = 0;
+
+			if (pauseAlpha[pauseAlphaIdx] != prevAlpha ||
+			    pauseQuad[pauseQuadIdx] != prevQuad)
+				updatePauseQuad();
 		}
 	}
 
@@ -739,7 +759,7 @@ struct WindowVXPrivate
 		if (windowskinValid)
 		{
 			shader.setTranslation(trans);
-			shader.setTexSize(Vec2i(base.tex.width, base.tex.height));
+			shader.setTexSize(Vec2i(base.tex.texWidth, base.tex.texHeight));
 
 			TEX::bind(base.tex.tex);
 			base.quad.draw();
@@ -838,9 +858,6 @@ void WindowVX::update()
 	guardDisposed();
 
 	p->stepAnimations();
-
-	p->updatePauseQuad();
-	p->updateCursorAlpha();
 }
 
 void WindowVX::move(int x, int y, int width, int height)
@@ -862,6 +879,9 @@ void WindowVX::move(int x, int y, int width, int height)
 
 	p->geo = IntRect(Vec2i(x, y), size);
 	p->updateBaseQuad();
+
+	p->schedulePrepare();
+	shState->markDirty();
 }
 
 bool WindowVX::isOpen() const
@@ -878,10 +898,10 @@ bool WindowVX::isClosed() const
 	return p->openness == 0;
 }
 
-DEF_ATTR_SIMPLE(WindowVX, X,          int,     p->geo.x)
-DEF_ATTR_SIMPLE(WindowVX, Y,          int,     p->geo.y)
-DEF_ATTR_SIMPLE(WindowVX, CursorRect, Rect&,  *p->cursorRect)
-DEF_ATTR_SIMPLE(WindowVX, Tone,       Tone&,  *p->tone)
+DEF_ATTR_NOTIFY(WindowVX, X,          int,     p->geo.x,      shState->markDirty())
+DEF_ATTR_NOTIFY(WindowVX, Y,          int,     p->geo.y,      shState->markDirty())
+DEF_ATTR_NOTIFY(WindowVX, CursorRect, Rect&,  *p->cursorRect, shState->markDirty())
+DEF_ATTR_NOTIFY(WindowVX, Tone,       Tone&,  *p->tone,       shState->markDirty())
 
 DEF_ATTR_RD_SIMPLE(WindowVX, Windowskin,      Bitmap*, p->windowskin)
 DEF_ATTR_RD_SIMPLE(WindowVX, Contents,        Bitmap*, p->contents)
@@ -908,6 +928,9 @@ void WindowVX::setWindowskin(Bitmap *value)
 
 	p->windowskin = value;
 	p->base.texDirty = true;
+
+	p->schedulePrepare();
+	shState->markDirty();
 }
 
 void WindowVX::setContents(Bitmap *value)
@@ -918,6 +941,7 @@ void WindowVX::setContents(Bitmap *value)
 		return;
 
 	p->contents = value;
+	shState->markDirty();
 
 	if (nullOrDisposed(value))
 		return;
@@ -925,6 +949,7 @@ void WindowVX::setContents(Bitmap *value)
 	FloatRect rect = p->contents->rect();
 	p->contentsQuad.setTexPosRect(rect, rect);
 	p->ctrlVertDirty = true;
+	p->schedulePrepare();
 }
 
 void WindowVX::setActive(bool value)
@@ -937,6 +962,8 @@ void WindowVX::setActive(bool value)
 	p->active = value;
 	p->cursorAlphaIdx = cursorAlphaResetIdx;
 	p->updateCursorAlpha();
+
+	shState->markDirty();
 }
 
 void WindowVX::setArrowsVisible(bool value)
@@ -948,6 +975,9 @@ void WindowVX::setArrowsVisible(bool value)
 
 	p->arrowsVisible = value;
 	p->ctrlVertDirty = true;
+
+	p->schedulePrepare();
+	shState->markDirty();
 }
 
 void WindowVX::setPause(bool value)
@@ -961,6 +991,9 @@ void WindowVX::setPause(bool value)
 	p->pauseAlphaIdx = 0;
 	p->pauseQuadIdx = 0;
 	p->ctrlVertDirty = true;
+
+	p->schedulePrepare();
+	shState->markDirty();
 }
 
 void WindowVX::setWidth(int value)
@@ -977,6 +1010,9 @@ void WindowVX::setWidth(int value)
 	p->clipRectDirty = true;
 	p->ctrlVertDirty = true;
 	p->updateBaseQuad();
+
+	p->schedulePrepare();
+	shState->markDirty();
 }
 
 void WindowVX::setHeight(int value)
@@ -993,6 +1029,9 @@ void WindowVX::setHeight(int value)
 	p->clipRectDirty = true;
 	p->ctrlVertDirty = true;
 	p->updateBaseQuad();
+
+	p->schedulePrepare();
+	shState->markDirty();
 }
 
 void WindowVX::setOX(int value)
@@ -1004,6 +1043,9 @@ void WindowVX::setOX(int value)
 
 	p->contentsOff.x = value;
 	p->ctrlVertDirty = true;
+
+	p->schedulePrepare();
+	shState->markDirty();
 }
 
 void WindowVX::setOY(int value)
@@ -1015,6 +1057,9 @@ void WindowVX::setOY(int value)
 
 	p->contentsOff.y = value;
 	p->ctrlVertDirty = true;
+
+	p->schedulePrepare();
+	shState->markDirty();
 }
 
 void WindowVX::setPadding(int value)
@@ -1027,6 +1072,9 @@ void WindowVX::setPadding(int value)
 	p->padding = value;
 	p->paddingBottom = value;
 	p->clipRectDirty = true;
+
+	p->schedulePrepare();
+	shState->markDirty();
 }
 
 void WindowVX::setPaddingBottom(int value)
@@ -1038,6 +1086,9 @@ void WindowVX::setPaddingBottom(int value)
 
 	p->paddingBottom = value;
 	p->clipRectDirty = true;
+
+	p->schedulePrepare();
+	shState->markDirty();
 }
 
 void WindowVX::setOpacity(int value)
@@ -1049,6 +1100,8 @@ void WindowVX::setOpacity(int value)
 
 	p->opacity = value;
 	p->base.quad.setColor(Vec4(1, 1, 1, p->opacity.norm));
+
+	shState->markDirty();
 }
 
 void WindowVX::setBackOpacity(int value)
@@ -1060,6 +1113,9 @@ void WindowVX::setBackOpacity(int value)
 
 	p->backOpacity = value;
 	p->base.texDirty = true;
+
+	p->schedulePrepare();
+	shState->markDirty();
 }
 
 void WindowVX::setContentsOpacity(int value)
@@ -1071,6 +1127,8 @@ void WindowVX::setContentsOpacity(int value)
 
 	p->contentsOpacity = value;
 	p->contentsQuad.setColor(Vec4(1, 1, 1, p->contentsOpacity.norm));
+
+	shState->markDirty();
 }
 
 void WindowVX::setOpenness(int value)
@@ -1082,6 +1140,8 @@ void WindowVX::setOpenness(int value)
 
 	p->openness = value;
 	p->updateBaseQuad();
+
+	shState->markDirty();
 }
 
 void WindowVX::initDynAttribs()